@@ -0,0 +1,267 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Headless benchmark mode with per-subsystem frame timings.
+//
+//      -benchmark <demo> plays back a demo like -timedemo, but without a
+//      window or audio device, and records how long each frame spent in
+//      the game simulation and the main rendering stages. At the end of
+//      the demo a report with per-frame times and percentiles is written
+//      to the file given by -benchmarkreport (JSON, or CSV if the name
+//      ends in .csv), so that builds can be compared unattended.
+//
+
+#include "SDL.h"
+
+#include "doomstat.h"
+#include "d_bench.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_misc2.h"
+#include "p_map.h"
+
+boolean benchmark;
+
+static const char *section_names[NUMBENCHSECTIONS] =
+{
+  "ticker", "bsp", "planes", "masked", "finishupdate"
+};
+
+// One frame: time spent in each section, and in total, in microseconds.
+typedef struct
+{
+  uint32_t section[NUMBENCHSECTIONS];
+  uint32_t total;
+} benchframe_t;
+
+static benchframe_t *frames;
+static int numframes, maxframes;
+
+static benchframe_t current;
+static uint64_t section_start[NUMBENCHSECTIONS];
+static uint64_t frame_start;
+
+static const char *reportname = "benchmark.json";
+
+void D_BenchInit(void)
+{
+  int p;
+
+  if (!(p = M_CheckParm("-benchmark")) || p >= myargc-1)
+    return;
+
+  benchmark = true;
+
+  if ((p = M_CheckParm("-benchmarkreport")) && p < myargc-1)
+    reportname = myargv[p+1];
+
+  // No window and no audio device, the dummy video driver still lets
+  // the whole software rendering path and texture upload run.
+  SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+  SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+}
+
+void D_BenchStart(benchsection_t section)
+{
+  if (benchmark)
+    section_start[section] = I_GetTimeUS();
+}
+
+void D_BenchStop(benchsection_t section)
+{
+  if (benchmark)
+    current.section[section] += (uint32_t)(I_GetTimeUS() - section_start[section]);
+}
+
+void D_BenchFrame(void)
+{
+  uint64_t now;
+
+  if (!benchmark)
+    return;
+
+  now = I_GetTimeUS();
+
+  // Only frames of the demo itself count, not the startup.
+  if (demoplayback && frame_start)
+    {
+      if (numframes == maxframes)
+        {
+          maxframes = maxframes ? maxframes * 2 : 4096;
+          frames = (realloc)(frames, maxframes * sizeof(*frames));
+          if (!frames)
+            I_Error("D_BenchFrame: out of memory");
+        }
+      current.total = (uint32_t)(now - frame_start);
+      frames[numframes++] = current;
+    }
+
+  memset(&current, 0, sizeof(current));
+  frame_start = now;
+}
+
+//
+// Statistics
+//
+
+typedef struct
+{
+  double mean;
+  uint32_t p50, p90, p95, p99, max;
+} benchstats_t;
+
+static int CompareTimes(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+  return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of a sorted array.
+static uint32_t Percentile(const uint32_t *sorted, int count, int percent)
+{
+  int rank = (count * percent + 99) / 100;
+  return sorted[BETWEEN(1, count, rank) - 1];
+}
+
+// section == NUMBENCHSECTIONS gives the frame totals.
+static void GetStats(int section, uint32_t *buf, benchstats_t *stats)
+{
+  double sum = 0;
+  int i;
+
+  memset(stats, 0, sizeof(*stats));
+
+  if (!numframes)
+    return;
+
+  for (i = 0; i < numframes; i++)
+    {
+      buf[i] = section < NUMBENCHSECTIONS ? frames[i].section[section] :
+                                            frames[i].total;
+      sum += buf[i];
+    }
+
+  qsort(buf, numframes, sizeof(*buf), CompareTimes);
+
+  stats->mean = sum / numframes;
+  stats->p50 = Percentile(buf, numframes, 50);
+  stats->p90 = Percentile(buf, numframes, 90);
+  stats->p95 = Percentile(buf, numframes, 95);
+  stats->p99 = Percentile(buf, numframes, 99);
+  stats->max = buf[numframes - 1];
+}
+
+static void WriteJSON(FILE *f, benchstats_t *stats, unsigned gametics,
+                      unsigned realtics)
+{
+  int i, j;
+
+  fprintf(f, "{\n");
+  fprintf(f, "  \"frames\": %d,\n", numframes);
+  fprintf(f, "  \"gametics\": %u,\n", gametics);
+  fprintf(f, "  \"realtics\": %u,\n", realtics);
+  fprintf(f, "  \"fps\": %.1f,\n",
+          realtics ? gametics * (double) TICRATE / realtics : 0.0);
+  fprintf(f, "  \"sight_checks\": %u,\n", sight_checks);
+  fprintf(f, "  \"sight_hits\": %u,\n", sight_hits);
+  fprintf(f, "  \"units\": \"us\",\n");
+  fprintf(f, "  \"stats\": {\n");
+  for (i = 0; i <= NUMBENCHSECTIONS; i++)
+    fprintf(f, "    \"%s\": { \"mean\": %.1f, \"p50\": %u, \"p90\": %u, "
+               "\"p95\": %u, \"p99\": %u, \"max\": %u }%s\n",
+            i < NUMBENCHSECTIONS ? section_names[i] : "total",
+            stats[i].mean, stats[i].p50, stats[i].p90, stats[i].p95,
+            stats[i].p99, stats[i].max, i < NUMBENCHSECTIONS ? "," : "");
+  fprintf(f, "  },\n");
+  fprintf(f, "  \"perframe\": [\n");
+  for (i = 0; i < numframes; i++)
+    {
+      fprintf(f, "    [");
+      for (j = 0; j < NUMBENCHSECTIONS; j++)
+        fprintf(f, "%u, ", frames[i].section[j]);
+      fprintf(f, "%u]%s\n", frames[i].total, i < numframes - 1 ? "," : "");
+    }
+  fprintf(f, "  ]\n");
+  fprintf(f, "}\n");
+}
+
+static void WriteCSV(FILE *f, benchstats_t *stats)
+{
+  static const char *statnames[] = {"mean", "p50", "p90", "p95", "p99", "max"};
+  int i, j;
+
+  fprintf(f, "frame");
+  for (j = 0; j < NUMBENCHSECTIONS; j++)
+    fprintf(f, ",%s", section_names[j]);
+  fprintf(f, ",total\n");
+
+  for (i = 0; i < numframes; i++)
+    {
+      fprintf(f, "%d", i);
+      for (j = 0; j < NUMBENCHSECTIONS; j++)
+        fprintf(f, ",%u", frames[i].section[j]);
+      fprintf(f, ",%u\n", frames[i].total);
+    }
+
+  // Statistics follow the frames, with the name in the first column.
+  for (i = 0; i < arrlen(statnames); i++)
+    {
+      fprintf(f, "%s", statnames[i]);
+      for (j = 0; j <= NUMBENCHSECTIONS; j++)
+        {
+          const benchstats_t *s = &stats[j];
+          const uint32_t values[] = {0, s->p50, s->p90, s->p95, s->p99, s->max};
+
+          if (i == 0)
+            fprintf(f, ",%.1f", s->mean);
+          else
+            fprintf(f, ",%u", values[i]);
+        }
+      fprintf(f, "\n");
+    }
+}
+
+void D_BenchReport(unsigned gametics, unsigned realtics)
+{
+  benchstats_t stats[NUMBENCHSECTIONS + 1];
+  uint32_t *buf;
+  FILE *f;
+  int i;
+
+  buf = (malloc)((numframes ? numframes : 1) * sizeof(*buf));
+  if (!buf)
+    I_Error("D_BenchReport: out of memory");
+
+  for (i = 0; i <= NUMBENCHSECTIONS; i++)
+    GetStats(i, buf, &stats[i]);
+
+  (free)(buf);
+
+  if (!(f = fopen(reportname, "w")))
+    I_Error("D_BenchReport: Could not write %s", reportname);
+
+  if (M_StringEndsWith(reportname, ".csv") || M_StringEndsWith(reportname, ".CSV"))
+    WriteCSV(f, stats);
+  else
+    WriteJSON(f, stats, gametics, realtics);
+
+  if (fclose(f))
+    I_Error("D_BenchReport: Could not write %s", reportname);
+
+  printf("Benchmark: %d frames, %.1f us mean, %u us p99, report written to %s\n",
+         numframes, stats[NUMBENCHSECTIONS].mean, stats[NUMBENCHSECTIONS].p99,
+         reportname);
+  printf("Benchmark: %u sight checks, %.1f%% answered from cache\n",
+         sight_checks, sight_checks ? 100.0 * sight_hits / sight_checks : 0.0);
+}
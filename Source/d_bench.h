@@ -0,0 +1,49 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Headless benchmark mode with per-subsystem frame timings.
+//
+
+#ifndef __D_BENCH__
+#define __D_BENCH__
+
+#include "doomtype.h"
+
+typedef enum
+{
+  bench_ticker,         // P_Ticker
+  bench_bsp,            // R_RenderBSPNode
+  bench_planes,         // R_DrawPlanes
+  bench_masked,         // R_DrawMasked
+  bench_finishupdate,   // I_FinishUpdate
+  NUMBENCHSECTIONS
+} benchsection_t;
+
+extern boolean benchmark;   // -benchmark given
+
+// Parse -benchmark and -benchmarkreport, before sound and video are set up.
+void D_BenchInit(void);
+
+// Time a section of the current frame. Sections may be entered
+// several times per frame, the times are summed up.
+void D_BenchStart(benchsection_t section);
+void D_BenchStop(benchsection_t section);
+
+// Called once per main loop iteration, closes the current frame.
+void D_BenchFrame(void);
+
+// Write the report at the end of the demo.
+void D_BenchReport(unsigned gametics, unsigned realtics);
+
+#endif
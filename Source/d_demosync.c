@@ -0,0 +1,634 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Demo sync verification with per-tic game state hashes.
+//
+//      -synchash <file> writes a hash of the game state (RNG, players
+//      and mobjs) for every tic of the demo being played back. Given
+//      -syncref <file> with the hashes of a reference run, playback stops
+//      at the first tic which differs, and the exit code tells whether
+//      the demo stayed in sync.
+//
+//      -demobatch <list> plays back every demo named in the list file,
+//      one per line, in child processes of this executable, -jobs of them
+//      at a time. All other parameters are passed on to the children.
+//      The hashes go to -syncdir (default "demosync"). If -refdir names
+//      the directory of a reference run, each demo is checked against
+//      its hashes there, and the first desyncing tic is reported.
+//
+
+#include <errno.h>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+extern char **environ;
+#endif
+
+#include "SDL.h"
+
+#include "doomstat.h"
+#include "d_demosync.h"
+#include "i_system.h"
+#include "i_thread.h"
+#include "m_argv.h"
+#include "m_misc2.h"
+#include "m_random.h"
+#include "p_tick.h"
+
+boolean demosync;
+
+typedef struct
+{
+  int tic;
+  unsigned int hash;
+} synctic_t;
+
+#define SYNC_DESYNC 2     // exit code of a run which went out of sync
+
+static FILE *hashfile;
+static const char *hashname;
+
+static synctic_t *reftics;
+static int numreftics;
+static int numtics;
+
+//
+// Hash files
+//
+
+// Read a hash file, returns the number of tics or -1 if it can't be read.
+
+static int ReadHashes(const char *name, synctic_t **tics)
+{
+  synctic_t *buf = NULL;
+  int num = 0, max = 0;
+  char line[80];
+  FILE *f;
+
+  if (!(f = fopen(name, "r")))
+    return -1;
+
+  while (fgets(line, sizeof(line), f))
+    {
+      synctic_t tic;
+
+      if (line[0] == '#' || sscanf(line, "%d %x", &tic.tic, &tic.hash) != 2)
+        continue;
+
+      if (num == max)
+        {
+          max = max ? max * 2 : 4096;
+          buf = (realloc)(buf, max * sizeof(*buf));
+          if (!buf)
+            I_Error("ReadHashes: out of memory");
+        }
+      buf[num++] = tic;
+    }
+
+  fclose(f);
+
+  *tics = buf;
+  return num;
+}
+
+// Index of the first tic which differs, -1 if both runs are the same.
+
+static int FirstDesync(const synctic_t *a, int numa, const synctic_t *b, int numb)
+{
+  int i;
+
+  for (i = 0; i < numa && i < numb; i++)
+    if (a[i].tic != b[i].tic || a[i].hash != b[i].hash)
+      return i;
+
+  return numa == numb ? -1 : i;
+}
+
+//
+// Hashing the game state
+//
+
+static unsigned int hash;
+
+#define HASHINT(x) { unsigned int v_ = (x); int b_; \
+    for (b_ = 0; b_ < 32; b_ += 8) { hash ^= (v_ >> b_) & 0xff; hash *= 0x01000193; } }
+
+static void HashPlayer(const player_t *p)
+{
+  int i;
+
+  HASHINT(p->playerstate);
+  HASHINT(p->health);
+  HASHINT(p->armorpoints);
+  HASHINT(p->armortype);
+  HASHINT(p->readyweapon);
+  HASHINT(p->pendingweapon);
+  for (i = 0; i < NUMPOWERS; i++)
+    HASHINT(p->powers[i]);
+  for (i = 0; i < NUMCARDS; i++)
+    HASHINT(p->cards[i]);
+  for (i = 0; i < NUMWEAPONS; i++)
+    HASHINT(p->weaponowned[i]);
+  for (i = 0; i < NUMAMMO; i++)
+    {
+      HASHINT(p->ammo[i]);
+      HASHINT(p->maxammo[i]);
+    }
+  for (i = 0; i < MAXPLAYERS; i++)
+    HASHINT(p->frags[i]);
+  HASHINT(p->killcount);
+  HASHINT(p->itemcount);
+  HASHINT(p->secretcount);
+  HASHINT(p->refire);
+  for (i = 0; i < NUMPSPRITES; i++)
+    {
+      HASHINT(p->psprites[i].state ? p->psprites[i].state - states : -1);
+      HASHINT(p->psprites[i].tics);
+      HASHINT(p->psprites[i].sx);
+      HASHINT(p->psprites[i].sy);
+    }
+}
+
+// Only what the simulation depends on goes in, no pointers and nothing
+// which only the renderer or the menus touch.
+
+static unsigned int GameStateHash(void)
+{
+  int i;
+
+  hash = 0x811c9dc5;    // FNV-1a
+
+  HASHINT(gametic);
+  HASHINT(gamestate);
+
+  // The RNG as P_ArchiveRNG() saves it.
+  for (i = 0; i < NUMPRCLASS; i++)
+    HASHINT(rng.seed[i]);
+  HASHINT(rng.rndindex);
+  HASHINT(rng.prndindex);
+
+  if (gamestate != GS_LEVEL)
+    return hash;
+
+  HASHINT(gameepisode);
+  HASHINT(gamemap);
+  HASHINT(leveltime);
+
+  for (i = 0; i < MAXPLAYERS; i++)
+    if (playeringame[i])
+      HashPlayer(&players[i]);
+
+  {
+    thinker_t *th;
+
+    for (th = thinkercap.next; th != &thinkercap; th = th->next)
+      if (th->function == P_MobjThinker)
+        {
+          const mobj_t *mo = (const mobj_t *) th;
+
+          HASHINT(mo->type);
+          HASHINT(mo->x);
+          HASHINT(mo->y);
+          HASHINT(mo->z);
+          HASHINT(mo->momx);
+          HASHINT(mo->momy);
+          HASHINT(mo->momz);
+          HASHINT(mo->angle);
+          HASHINT(mo->health);
+          HASHINT(mo->flags);
+          HASHINT(mo->flags2);
+          HASHINT(mo->state - states);
+          HASHINT(mo->tics);
+          HASHINT(mo->movedir);
+          HASHINT(mo->movecount);
+          HASHINT(mo->reactiontime);
+          HASHINT(mo->threshold);
+        }
+  }
+
+  return hash;
+}
+
+//
+// Single demo
+//
+
+static void CloseHashFile(void)
+{
+  if (hashfile)
+    {
+      fclose(hashfile);
+      hashfile = NULL;
+    }
+}
+
+void D_DemoSyncTic(void)
+{
+  synctic_t tic;
+
+  if (!demosync || !demoplayback)
+    return;
+
+  tic.tic = gametic;
+  tic.hash = GameStateHash();
+
+  fprintf(hashfile, "%d %08x\n", tic.tic, tic.hash);
+
+  if (reftics)
+    {
+      if (numtics >= numreftics)
+        {
+          printf("D_DemoSyncTic: desync at tic %d, reference ended at tic %d\n",
+                 tic.tic, numreftics ? reftics[numreftics - 1].tic : 0);
+          I_SafeExit(SYNC_DESYNC);
+        }
+      if (FirstDesync(&tic, 1, &reftics[numtics], 1) >= 0)
+        {
+          printf("D_DemoSyncTic: desync at tic %d (expected %08x, got %08x)\n",
+                 tic.tic, reftics[numtics].hash, tic.hash);
+          I_SafeExit(SYNC_DESYNC);
+        }
+    }
+
+  numtics++;
+}
+
+int D_DemoSyncFinish(void)
+{
+  if (!demosync)
+    return 0;
+
+  CloseHashFile();
+
+  if (reftics && numtics < numreftics)
+    {
+      printf("D_DemoSyncFinish: desync, demo ended at tic %d, reference at %d\n",
+             numtics ? reftics[numtics - 1].tic : 0, reftics[numreftics - 1].tic);
+      return SYNC_DESYNC;
+    }
+
+  printf("D_DemoSyncFinish: %d tics %s, hashes written to %s\n", numtics,
+         reftics ? "in sync" : "played", hashname);
+  return 0;
+}
+
+//
+// Batch mode
+//
+
+typedef struct
+{
+  const char *demo;
+  char *hashname;
+  char *refname;      // NULL without a reference
+  int status;         // exit code of the child
+} syncjob_t;
+
+static syncjob_t *jobs;
+static int numjobs, nextjob;
+static i_mutex_t *job_mutex;
+
+static const char **childargv;
+static int childargc;
+
+static int numok, numdesync, numfailed, numnew;
+
+#ifdef _WIN32
+// _spawnv() glues the arguments together without quoting them.
+static const char *QuoteArg(const char *arg)
+{
+  return strchr(arg, ' ') ? M_StringJoin("\"", arg, "\"", NULL) : arg;
+}
+#endif
+
+// Runs one demo in a child process and waits for it, returns its
+// exit code or -1 if it could not be started or crashed.
+
+static int RunChild(syncjob_t *job, const char *logname)
+{
+  const char **argv = (malloc)((childargc + 10) * sizeof(*argv));
+  int argc = childargc, status;
+
+  if (!argv)
+    I_Error("RunChild: out of memory");
+
+  memcpy(argv, childargv, childargc * sizeof(*argv));
+  argv[argc++] = "-fastdemo";
+  argv[argc++] = job->demo;
+  argv[argc++] = "-synchash";
+  argv[argc++] = job->hashname;
+  if (job->refname)
+    {
+      argv[argc++] = "-syncref";
+      argv[argc++] = job->refname;
+    }
+  argv[argc] = NULL;
+
+#ifdef _WIN32
+  {
+    int i;
+
+    for (i = 0; i < argc; i++)
+      argv[i] = QuoteArg(argv[i]);
+
+    // The children inherit the console, there are no logs to redirect.
+    status = _spawnv(_P_WAIT, myargv[0], argv);
+    (void) logname;
+  }
+#else
+  {
+    posix_spawn_file_actions_t actions;
+    pid_t pid;
+
+    // Keep the output of parallel children apart.
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 1, logname,
+                                     O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    posix_spawn_file_actions_adddup2(&actions, 1, 2);
+
+    if (posix_spawnp(&pid, myargv[0], &actions, NULL,
+                     (char *const *) argv, environ)
+        || waitpid(pid, &status, 0) != pid)
+      status = -1;
+    else
+      status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    posix_spawn_file_actions_destroy(&actions);
+  }
+#endif
+
+  (free)(argv);
+
+  return status;
+}
+
+static void ReportJob(syncjob_t *job)
+{
+  synctic_t *tics = NULL, *ref = NULL;
+  int num, numref = -1, desync;
+
+  num = ReadHashes(job->hashname, &tics);
+
+  if (job->refname)
+    numref = ReadHashes(job->refname, &ref);
+
+  if (num <= 0 || (job->status && job->status != SYNC_DESYNC))
+    {
+      printf("FAIL    %s: exit code %d after %d tics\n", job->demo,
+             job->status, MAX(num, 0));
+      numfailed++;
+    }
+  else if (numref < 0)
+    {
+      printf("NEW     %s: %d tics\n", job->demo, num);
+      numnew++;
+    }
+  else if ((desync = FirstDesync(tics, num, ref, numref)) < 0)
+    {
+      printf("OK      %s: %d tics\n", job->demo, num);
+      numok++;
+    }
+  else
+    {
+      if (desync < num && desync < numref)
+        printf("DESYNC  %s: first desync at tic %d (expected %08x, got %08x)\n",
+               job->demo, tics[desync].tic, ref[desync].hash, tics[desync].hash);
+      else
+        printf("DESYNC  %s: %d tics played, %d in the reference\n",
+               job->demo, num, numref);
+      numdesync++;
+    }
+
+  fflush(stdout);
+
+  (free)(tics);
+  (free)(ref);
+}
+
+static int BatchWorker(void *unused)
+{
+  for (;;)
+    {
+      syncjob_t *job;
+      char *logname;
+
+      I_LockMutex(job_mutex);
+      job = nextjob < numjobs ? &jobs[nextjob++] : NULL;
+      I_UnlockMutex(job_mutex);
+
+      if (!job)
+        break;
+
+      logname = M_StringJoin(job->hashname, ".log", NULL);
+      remove(job->hashname);
+      job->status = RunChild(job, logname);
+      (free)(logname);
+
+      I_LockMutex(job_mutex);
+      ReportJob(job);
+      I_UnlockMutex(job_mutex);
+    }
+
+  return 0;
+}
+
+// Whether a parameter is handled by the batch itself and not passed on,
+// returns the number of arguments it takes up.
+
+static int BatchParm(const char *arg)
+{
+  static const char *parms[] = {
+    "-demobatch", "-jobs", "-syncdir", "-refdir", "-synchash", "-syncref",
+    "-playdemo", "-timedemo", "-fastdemo", "-benchmark", "-record",
+  };
+  int i;
+
+  for (i = 0; i < arrlen(parms); i++)
+    if (!strcasecmp(arg, parms[i]))
+      return 2;
+
+  return 0;
+}
+
+static void ReadDemoList(const char *listname)
+{
+  char line[1024];
+  int max = 0;
+  FILE *f;
+
+  if (!(f = fopen(listname, "r")))
+    I_Error("D_DemoBatch: Could not read %s", listname);
+
+  while (fgets(line, sizeof(line), f))
+    {
+      char *s = line, *e = line + strlen(line);
+
+      while (*s == ' ' || *s == '\t')
+        s++;
+      while (e > s && (e[-1] == '\n' || e[-1] == '\r' || e[-1] == ' '))
+        *--e = '\0';
+
+      if (!*s || *s == '#')
+        continue;
+
+      if (numjobs == max)
+        {
+          max = max ? max * 2 : 64;
+          jobs = (realloc)(jobs, max * sizeof(*jobs));
+          if (!jobs)
+            I_Error("D_DemoBatch: out of memory");
+        }
+      memset(&jobs[numjobs], 0, sizeof(*jobs));
+      jobs[numjobs++].demo = M_StringDuplicate(s);
+    }
+
+  fclose(f);
+}
+
+static void D_DemoBatch(const char *listname)
+{
+  const char *syncdir = "demosync", *refdir = NULL;
+  const uint64_t start = I_GetTimeUS();
+  i_thread_t **threads;
+  int numthreads = I_GetNumCPUs();
+  int i, p;
+
+  if ((p = M_CheckParm("-jobs")) && p < myargc-1)
+    numthreads = MAX(1, atoi(myargv[p+1]));
+
+  if ((p = M_CheckParm("-syncdir")) && p < myargc-1)
+    syncdir = myargv[p+1];
+
+  if ((p = M_CheckParm("-refdir")) && p < myargc-1)
+    refdir = myargv[p+1];
+
+  ReadDemoList(listname);
+
+  if (!numjobs)
+    I_Error("D_DemoBatch: No demos in %s", listname);
+
+  M_MakeDirectory(syncdir);
+
+  for (i = 0; i < numjobs; i++)
+    {
+      char *base = M_StringJoin(M_BaseName(jobs[i].demo), ".hash", NULL);
+
+      jobs[i].hashname = M_StringJoin(syncdir, DIR_SEPARATOR_S, base, NULL);
+      if (refdir)
+        {
+          jobs[i].refname = M_StringJoin(refdir, DIR_SEPARATOR_S, base, NULL);
+          if (!M_FileExists(jobs[i].refname))
+            {
+              (free)(jobs[i].refname);
+              jobs[i].refname = NULL;
+            }
+        }
+      (free)(base);
+    }
+
+  // The children play back headless and never ask for anything.
+  childargv = (malloc)((myargc + 6) * sizeof(*childargv));
+  if (!childargv)
+    I_Error("D_DemoBatch: out of memory");
+
+  childargv[childargc++] = myargv[0];
+  for (i = 1; i < myargc; i++)
+    {
+      const int skip = BatchParm(myargv[i]);
+
+      if (skip)
+        i += skip - 1;
+      else
+        childargv[childargc++] = myargv[i];
+    }
+  childargv[childargc++] = "-nodraw";
+  childargv[childargc++] = "-noblit";
+  childargv[childargc++] = "-nosound";
+  childargv[childargc++] = "-nogui";
+
+  printf("D_DemoBatch: %d demos, %d jobs, hashes written to %s\n",
+         numjobs, MIN(numthreads, numjobs), syncdir);
+  fflush(stdout);
+
+  job_mutex = I_CreateMutex();
+
+  numthreads = MIN(numthreads, numjobs);
+  threads = (malloc)(numthreads * sizeof(*threads));
+  if (!threads)
+    I_Error("D_DemoBatch: out of memory");
+
+  // Each thread runs one child at a time, if it can't even be started
+  // the main thread takes over.
+  for (i = 0; i < numthreads; i++)
+    threads[i] = I_CreateThread(BatchWorker, "demobatch", NULL);
+
+  if (!threads[0])
+    BatchWorker(NULL);
+
+  for (i = 0; i < numthreads; i++)
+    if (threads[i])
+      I_WaitThread(threads[i]);
+
+  printf("D_DemoBatch: %d ok, %d desynced, %d failed, %d without reference "
+         "in %d s\n", numok, numdesync, numfailed, numnew,
+         (int) ((I_GetTimeUS() - start) / 1000000));
+
+  I_SafeExit(numdesync || numfailed ? 1 : 0);
+}
+
+//
+// Startup
+//
+
+void D_DemoSyncInit(void)
+{
+  int p;
+
+  if ((p = M_CheckParm("-demobatch")) && p < myargc-1)
+    D_DemoBatch(myargv[p+1]);
+
+  if (!(p = M_CheckParm("-synchash")) || p >= myargc-1)
+    return;
+
+  demosync = true;
+  hashname = myargv[p+1];
+
+  if (!(hashfile = fopen(hashname, "w")))
+    I_Error("D_DemoSyncInit: Could not write %s: %s", hashname, strerror(errno));
+
+  I_AtExit(CloseHashFile, true);
+
+  if ((p = M_CheckParm("-syncref")) && p < myargc-1)
+    {
+      numreftics = ReadHashes(myargv[p+1], &reftics);
+
+      if (numreftics < 0)
+        I_Error("D_DemoSyncInit: Could not read %s", myargv[p+1]);
+
+      // An empty reference still means the demo must not run at all.
+      if (!reftics)
+        reftics = (malloc)(sizeof(*reftics));
+    }
+
+  // Nothing is going to be shown anyway.
+  if (M_CheckParm("-nodraw"))
+    {
+      SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+      SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+    }
+}
@@ -0,0 +1,35 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Demo sync verification with per-tic game state hashes.
+//
+
+#ifndef __D_DEMOSYNC__
+#define __D_DEMOSYNC__
+
+#include "doomtype.h"
+
+extern boolean demosync;    // -synchash given
+
+// Parse -synchash and -syncref, before sound and video are set up.
+// With -demobatch, runs the whole batch and does not return.
+void D_DemoSyncInit(void);
+
+// Called at the end of each G_Ticker() during demo playback.
+void D_DemoSyncTic(void);
+
+// Called at the end of the demo, returns the exit code.
+int D_DemoSyncFinish(void);
+
+#endif
@@ -75,6 +75,7 @@ typedef enum
   ga_worlddone,
   ga_screenshot,
   ga_reloadlevel,
+  ga_rewind,
 } gameaction_t;
 
 
@@ -26,6 +26,7 @@
 
 #include "i_system.h"
 #include "i_video.h"
+#include "i_pacer.h"
 
 #include "m_argv.h"
 #include "m_fixed.h"
@@ -679,6 +680,30 @@ static void SinglePlayerClear(ticcmd_set_t *set)
 
 void RunTic(ticcmd_t *cmds, boolean *ingame);
 
+// Sleep until a tic may be available. Local tics are built on the tic
+// boundaries of the game clock, tics from other players come in over the
+// network at any time.
+
+static void WaitForTics(void)
+{
+    if (!net_client_connected)
+    {
+        I_SleepUntilNS(I_GetNextTicNS());
+    }
+    else
+    {
+        uint64_t now = I_GetTimeNS(), next = I_GetNextTicNS();
+        int timeout = next > now ? (next - now) / 1000000 : 0;
+
+        // The loopback module has no socket to wait on, and a server
+        // running in this process only gets to run in NetUpdate().
+        if (!NET_SDL_WaitForPacket(BETWEEN(1, 1000 / TICRATE, timeout)))
+        {
+            I_Sleep(1);
+        }
+    }
+}
+
 void TryRunTics (void)
 {
     int	i;
@@ -773,7 +798,7 @@ void TryRunTics (void)
                 return;
             }
 
-            I_Sleep(1);
+            WaitForTics();
         }
     }
 
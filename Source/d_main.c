@@ -51,6 +51,7 @@
 #include "m_misc.h"
 #include "m_misc2.h" // [FG] M_StringDuplicate()
 #include "m_menu.h"
+#include "i_mixer.h"
 #include "i_system.h"
 #include "i_sound.h"
 #include "i_video.h"
@@ -63,6 +64,8 @@
 #include "r_draw.h"
 #include "r_main.h"
 #include "d_main.h"
+#include "d_bench.h"
+#include "d_demosync.h"
 #include "d_iwad.h" // [FG] BuildIWADDirList()
 #include "d_deh.h"  // Ty 04/08/98 - Externalizations
 #include "statdump.h" // [FG] StatDump()
@@ -72,7 +75,10 @@
 
 #include "dsdhacked.h"
 
+#include "net_bench.h"
+#include "net_bot.h"
 #include "net_client.h"
+#include "net_dedicated.h"
 
 #ifdef _WIN32
 #include "../win32/win_fopen.h"
@@ -344,7 +350,9 @@ void D_Display (void)
   // normal update
   if (!wipe)
     {
+      D_BenchStart(bench_finishupdate);
       I_FinishUpdate ();              // page flip or blit buffer
+      D_BenchStop(bench_finishupdate);
       return;
     }
 
@@ -366,7 +374,9 @@ void D_Display (void)
       done = wipe_ScreenWipe(wipe_Melt,0,0,SCREENWIDTH,SCREENHEIGHT,tics);
       I_UpdateNoBlit();
       M_Drawer();                   // menu is drawn even on top of wipes
+      D_BenchStart(bench_finishupdate);
       I_FinishUpdate();             // page flip or blit buffer
+      D_BenchStop(bench_finishupdate);
     }
   while (!done);
 }
@@ -1763,6 +1773,16 @@ void D_DoomMain(void)
 
   FindResponseFile();         // Append response file arguments to command-line
 
+  // Dedicated servers and bots (-netbot) need no WAD.
+  if (M_CheckParm("-dedicated"))
+  {
+    printf("Dedicated server mode.\n");
+    NET_DedicatedServer();
+  }
+
+  if (M_CheckParm("-netbot"))
+    NET_BotClient();
+
   // killough 10/98: set default savename based on executable's name
   sprintf(savegamename = malloc(16), "%.4ssav", D_DoomExeName());
 
@@ -1952,8 +1972,8 @@ void D_DoomMain(void)
   {
     if ((p = M_CheckParm ("-fastdemo")) && p < myargc-1)   // killough
       fastdemo = true;             // run at fastest speed possible
-    else
-      p = M_CheckParm ("-timedemo");
+    else if (!(p = M_CheckParm ("-timedemo")) || p >= myargc-1)
+      p = M_CheckParm ("-benchmark");
   }
 
   if (p && p < myargc-1)
@@ -2027,9 +2047,12 @@ void D_DoomMain(void)
     demowarp = startmap;
   }
 
+  D_DemoSyncInit();
+  D_BenchInit();
+
   //jff 1/22/98 add command line parms to disable sound and music
   {
-    int nosound = M_CheckParm("-nosound");
+    int nosound = benchmark || M_CheckParm("-nosound");
     nomusicparm = nosound || M_CheckParm("-nomusic");
     nosfxparm   = nosound || M_CheckParm("-nosfx");
   }
@@ -2043,6 +2066,13 @@ void D_DoomMain(void)
   if ((p = M_CheckParm("-dumplumps")) && p < myargc-1)
     WritePredefinedLumpWad(myargv[p+1]);
 
+  // salvage a demo whose recording was cut short
+  if ((p = M_CheckParm("-recoverdemo")) && p < myargc-1)
+  {
+    G_RecoverDemo(myargv[p+1]);
+    I_SafeExit(0);
+  }
+
   puts("M_LoadDefaults: Load system defaults.");
   M_LoadDefaults();              // load before initing other systems
 
@@ -2151,6 +2181,18 @@ void D_DoomMain(void)
   printf("R_Init: Init DOOM refresh daemon - ");
   R_Init();
 
+  if (M_CheckParm("-drawbench"))
+  {
+    R_DrawBenchmark();
+    I_SafeExit(0);
+  }
+
+  if (M_CheckParm("-mixbench"))
+  {
+    I_MixerBenchmark();
+    I_SafeExit(0);
+  }
+
   puts("\nP_Init: Init Playloop state.");
   P_Init();
 
@@ -2160,6 +2202,12 @@ void D_DoomMain(void)
   puts("NET_Init: Init network subsystem.");
   NET_Init();
 
+  if (M_CheckParm("-netbench"))
+  {
+    NET_Benchmark();
+    I_SafeExit(0);
+  }
+
   // Initial netgame startup. Connect to server etc.
   D_ConnectNetGame();
 
@@ -2222,6 +2270,14 @@ void D_DoomMain(void)
 	G_DeferedPlayDemo(myargv[p]);
 	singledemo = true;            // quit after one demo
       }
+    else
+    if (benchmark && (p = M_CheckParm("-benchmark")) && ++p < myargc)
+      {
+	singletics = true;
+	timingdemo = true;            // write report after quit
+	G_DeferedPlayDemo(myargv[p]);
+	singledemo = true;            // quit after one demo
+      }
     else
       if ((p = M_CheckParm("-playdemo")) && ++p < myargc)
 	{
@@ -2287,6 +2343,8 @@ void D_DoomMain(void)
       // Update display, next frame, with current state.
       D_Display();
 
+      D_BenchFrame();
+
       // Sound mixing for the buffer is snychronous.
       I_UpdateSound();
 
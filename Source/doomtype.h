@@ -121,6 +121,17 @@ typedef int64_t Long64;
  #define PACKED_SUFFIX
 #endif
 
+// Per-thread storage, used for renderer state which is duplicated for
+// each worker thread of the split-screen renderer.
+
+#if defined(_MSC_VER)
+ #define THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+ #define THREAD_LOCAL __thread
+#else
+ #define THREAD_LOCAL _Thread_local
+#endif
+
 #endif
 
 //----------------------------------------------------------------------------
@@ -41,6 +41,8 @@
 #include "p_saveg.h"
 #include "p_tick.h"
 #include "d_main.h"
+#include "d_bench.h"
+#include "d_demosync.h"
 #include "wi_stuff.h"
 #include "hu_stuff.h"
 #include "st_stuff.h"
@@ -63,6 +65,12 @@
 #include "m_misc2.h"
 #include "u_mapinfo.h"
 #include "m_input.h"
+#include "g_rewind.h"
+#include "p_spec.h" // P_RemoveAllActivePlats()
+#include "p_preload.h"
+#include "i_thread.h"
+
+#include "../miniz/miniz.h"
 
 #define SAVEGAMESIZE  0x20000
 #define SAVESTRINGSIZE  24
@@ -559,6 +567,8 @@ static void G_DoLoadLevel(void)
 {
   int i;
 
+  G_ClearRewind();
+
   // Set the sky map.
   // First thing, we have a dummy sky texture name,
   //  a flat. The data is in the WAD only because
@@ -739,6 +749,18 @@ boolean G_Responder(event_t* ev)
       return true;
     }
 
+  // go back in time, also during demo playback
+  if (M_InputActivated(input_rewind) &&
+      gamestate == GS_LEVEL &&
+      gameaction == ga_nothing &&
+      !netgame &&
+      !demorecording &&
+      !menuactive)
+  {
+    gameaction = ga_rewind;
+    return true;
+  }
+
   if (M_InputActivated(input_menu_reloadlevel) &&
       gamestate == GS_LEVEL &&
       !demoplayback &&
@@ -880,6 +902,85 @@ boolean G_Responder(event_t* ev)
 
 #define DEMOMARKER    0x80
 
+// The demo is streamed to disk while it is recorded, so a crash loses
+// at most the last few seconds. demobuffer only stages what has been
+// recorded since the last flush, a thread of its own writes it out.
+
+#define DEMO_FLUSH_TICS (5*TICRATE)
+#define DEMO_FLUSH_SIZE 0x10000
+
+static FILE *demofile;
+static byte *demowrite;           // being written by the demo thread
+static size_t demowritesize, demowritemax;
+static i_thread_t *demothread;
+static int demowriteerror;        // errno, or -1 if unknown
+static int demoflushtic;
+
+static int G_DemoWriteThread(void *unused)
+{
+  errno = 0;
+
+  if (fwrite(demowrite, 1, demowritesize, demofile) != demowritesize ||
+      fflush(demofile))
+    demowriteerror = errno ? errno : -1;
+
+  return 0;
+}
+
+static void G_WaitDemoWrite(void)
+{
+  if (demothread)
+  {
+    I_WaitThread(demothread);
+    demothread = NULL;
+  }
+
+  if (demowriteerror)
+    I_Error("Error recording demo %s: %s", demoname,
+            demowriteerror > 0 ? strerror(demowriteerror) : "(Unknown Error)");
+}
+
+// Hands everything staged so far to the demo thread.
+
+static void G_FlushDemo(void)
+{
+  const size_t size = demo_p - demobuffer;
+
+  G_WaitDemoWrite();
+
+  demoflushtic = gametic;
+
+  if (!size)
+    return;
+
+  if (size > demowritemax)
+  {
+    demowritemax = size;
+    demowrite = (realloc)(demowrite, demowritemax);
+    if (!demowrite)
+      I_Error("G_FlushDemo: out of memory");
+  }
+
+  memcpy(demowrite, demobuffer, size);
+  demowritesize = size;
+  demo_p = demobuffer;
+
+  if (!(demothread = I_CreateThread(G_DemoWriteThread, "demowrite", NULL)))
+    G_DemoWriteThread(NULL);
+}
+
+static void G_CloseDemo(void)
+{
+  G_FlushDemo();
+  G_WaitDemoWrite();
+
+  errno = 0;
+  if (fclose(demofile))
+    I_Error("Error recording demo %s: %s", demoname,  // killough 11/98
+            errno ? strerror(errno) : "(Unknown Error)");
+  demofile = NULL;
+}
+
 static void G_ReadDemoTiccmd(ticcmd_t *cmd)
 {
   if (*demo_p == DEMOMARKER)
@@ -943,6 +1044,10 @@ static void G_WriteDemoTiccmd(ticcmd_t* cmd)
     }
 
   G_ReadDemoTiccmd (cmd);         // make SURE it is exactly the same
+
+  if (demo_p - demobuffer >= DEMO_FLUSH_SIZE ||
+      gametic - demoflushtic >= DEMO_FLUSH_TICS)
+    G_FlushDemo();
 }
 
 boolean secretexit;
@@ -1225,6 +1330,10 @@ frommapinfo:
     StatCopy(&wminfo);
   }
 
+  // load the next level while the tally screen is up
+  if (gamemode == commercial || gamemap != 8)
+    P_StartPreload(wminfo.nextep + 1, wminfo.next + 1);
+
   WI_Start (&wminfo);
 }
 
@@ -1606,6 +1715,251 @@ ULong64 G_Signature(void)
   return s;
 }
 
+//
+// Compressed savegames
+//
+// The game is archived into memory as it always was, but a thread of its
+// own compresses the buffer and writes it to disk, so the game goes on
+// while that happens. The description stays in front, uncompressed, for
+// the menu to read. It is followed by SAVEZ_MAGIC in place of the version
+// string, the uncompressed size of the rest, and the rest of the savegame
+// as a zlib stream. Uncompressed savegames still load as they are.
+//
+
+#define SAVEZ_MAGIC "Woof zsave 1"
+#define SAVEZ_CHUNK 0x10000
+
+int compress_savegames;
+
+static struct
+{
+  byte *buffer;           // the savegame as archived in memory
+  int length;
+  char *name, *tmpname;
+  boolean compress;
+  volatile boolean done;
+  int error;              // errno, or -1 if unknown
+} savefile;
+
+static i_thread_t *savethread;
+
+static boolean G_WriteCompressed(FILE *fp, const byte *data, int length)
+{
+  byte header[VERSIONSIZE + 4] = {0};
+  const int size = length - SAVESTRINGSIZE;
+  z_stream zstream;
+  byte *out;
+  int err;
+
+  memcpy(header, SAVEZ_MAGIC, sizeof(SAVEZ_MAGIC));
+  header[VERSIONSIZE + 0] = size & 0xff;
+  header[VERSIONSIZE + 1] = (size >> 8) & 0xff;
+  header[VERSIONSIZE + 2] = (size >> 16) & 0xff;
+  header[VERSIONSIZE + 3] = (size >> 24) & 0xff;
+
+  if (fwrite(data, 1, SAVESTRINGSIZE, fp) != SAVESTRINGSIZE ||
+      fwrite(header, 1, sizeof(header), fp) != sizeof(header))
+    return false;
+
+  if (!(out = (malloc)(SAVEZ_CHUNK)))
+    return false;
+
+  memset(&zstream, 0, sizeof(zstream));
+
+  if (deflateInit(&zstream, Z_BEST_SPEED) != Z_OK)
+  {
+    (free)(out);
+    return false;
+  }
+
+  zstream.next_in = (byte *) data + SAVESTRINGSIZE;
+  zstream.avail_in = size;
+
+  do
+  {
+    zstream.next_out = out;
+    zstream.avail_out = SAVEZ_CHUNK;
+    err = deflate(&zstream, Z_FINISH);
+
+    if (err != Z_OK && err != Z_STREAM_END)
+      break;
+
+    if (fwrite(out, 1, SAVEZ_CHUNK - zstream.avail_out, fp) !=
+        SAVEZ_CHUNK - zstream.avail_out)
+    {
+      err = Z_ERRNO;
+      break;
+    }
+  }
+  while (err != Z_STREAM_END);
+
+  deflateEnd(&zstream);
+  (free)(out);
+
+  return err == Z_STREAM_END;
+}
+
+// Runs on the save thread. Nothing in here may touch the zone.
+
+static int G_SaveGameThread(void *unused)
+{
+  boolean ok;
+  FILE *fp;
+
+  errno = 0;
+
+  if ((fp = fopen(savefile.tmpname, "wb")))
+  {
+    if (savefile.compress)
+      ok = G_WriteCompressed(fp, savefile.buffer, savefile.length);
+    else
+      ok = fwrite(savefile.buffer, 1, savefile.length, fp) == savefile.length;
+
+    ok = fclose(fp) == 0 && ok;
+
+    // Keep the previous savegame until the new one is complete.
+    if (ok)
+    {
+      remove(savefile.name);
+      ok = rename(savefile.tmpname, savefile.name) == 0;
+    }
+
+    if (!ok)
+      remove(savefile.tmpname);
+  }
+  else
+    ok = false;
+
+  savefile.error = ok ? 0 : errno ? errno : -1;
+  savefile.done = true;
+
+  return 0;
+}
+
+// Collects the save thread once it is done, or waits for it.
+
+static void G_FinishSaveGame(boolean wait)
+{
+  if (!savefile.buffer || (!wait && !savefile.done))
+    return;
+
+  if (savethread)
+  {
+    I_WaitThread(savethread);
+    savethread = NULL;
+  }
+
+  if (savefile.error)
+    dprintf("%s", savefile.error > 0 ? strerror(savefile.error) :
+                                       "Could not save game: Error unknown");
+  else
+    players[consoleplayer].message = s_GGSAVED;  // Ty 03/27/98 - externalized
+
+  free(savefile.buffer);  // killough
+  (free)(savefile.name);
+  (free)(savefile.tmpname);
+  savefile.buffer = NULL;
+}
+
+void G_WaitSaveGame(void)
+{
+  G_FinishSaveGame(true);
+}
+
+// Takes over the buffer and the name.
+
+static void G_WriteSaveGame(char *name, byte *buffer, int length)
+{
+  static boolean first = true;
+
+  G_FinishSaveGame(true);
+
+  savefile.buffer = buffer;
+  savefile.length = length;
+  savefile.name = name;
+  savefile.tmpname = M_StringJoin(name, ".tmp", NULL);
+  savefile.compress = compress_savegames;
+  savefile.done = false;
+
+  if (first)
+  {
+    I_AtExit(G_WaitSaveGame, true);
+    first = false;
+  }
+
+  if (!(savethread = I_CreateThread(G_SaveGameThread, "savegame", NULL)))
+  {
+    G_SaveGameThread(NULL);
+    G_FinishSaveGame(true);
+  }
+}
+
+// Reads a savegame, inflating it on the way if it is compressed.
+// Returns its uncompressed length.
+
+static int G_ReadSaveGame(const char *name, byte **buffer)
+{
+  byte header[SAVESTRINGSIZE + VERSIONSIZE + 4];
+  z_stream zstream;
+  byte *in;
+  int length, err;
+  FILE *fp;
+
+  if (!(fp = fopen(name, "rb")))
+    return M_ReadFile(name, buffer);
+
+  if (fread(header, 1, sizeof(header), fp) != sizeof(header) ||
+      memcmp(header + SAVESTRINGSIZE, SAVEZ_MAGIC, sizeof(SAVEZ_MAGIC)))
+  {
+    fclose(fp);
+    return M_ReadFile(name, buffer);
+  }
+
+  length = header[SAVESTRINGSIZE + VERSIONSIZE] |
+           header[SAVESTRINGSIZE + VERSIONSIZE + 1] << 8 |
+           header[SAVESTRINGSIZE + VERSIONSIZE + 2] << 16 |
+           header[SAVESTRINGSIZE + VERSIONSIZE + 3] << 24;
+
+  if (length <= 0 || !(in = (malloc)(SAVEZ_CHUNK)))
+    I_Error("Couldn't read file %s: Bad compressed savegame", name);
+
+  *buffer = Z_Malloc(SAVESTRINGSIZE + length, PU_STATIC, 0);
+  memcpy(*buffer, header, SAVESTRINGSIZE);
+
+  memset(&zstream, 0, sizeof(zstream));
+  zstream.next_out = *buffer + SAVESTRINGSIZE;
+  zstream.avail_out = length;
+
+  if (inflateInit(&zstream) != Z_OK)
+    I_Error("Couldn't read file %s: Decompression failed", name);
+
+  I_BeginRead(DISK_ICON_THRESHOLD);
+
+  do
+  {
+    if (!zstream.avail_in)
+    {
+      zstream.next_in = in;
+      zstream.avail_in = fread(in, 1, SAVEZ_CHUNK, fp);
+      if (!zstream.avail_in)
+        break;
+    }
+    err = inflate(&zstream, Z_NO_FLUSH);
+  }
+  while (err == Z_OK);
+
+  I_EndRead();
+
+  fclose(fp);
+  (free)(in);
+  inflateEnd(&zstream);
+
+  if (err != Z_STREAM_END || zstream.total_out != length)
+    I_Error("Couldn't read file %s: Bad compressed savegame", name);
+
+  return SAVESTRINGSIZE + length;
+}
+
 static void G_DoSaveGame(void)
 {
   char *name = NULL;
@@ -1709,18 +2063,119 @@ static void G_DoSaveGame(void)
 
   Z_CheckHeap();
 
-  if (!M_WriteFile(name, savebuffer, length))
-    dprintf("%s", errno ? strerror(errno) : "Could not save game: Error unknown");
-  else
-    players[consoleplayer].message = s_GGSAVED;  // Ty 03/27/98 - externalized
+  // Compressed and written to disk in the background.
+  G_WriteSaveGame(name, savebuffer, length);
 
-  free(savebuffer);  // killough
   savebuffer = save_p = NULL;
 
   gameaction = ga_nothing;
   savedescription[0] = 0;
+}
+
+//
+// Rewind snapshots
+//
+// The level is archived just like in a savegame, without the header and
+// plus the state a savegame does not need because it reloads the level.
+// Restoring a snapshot then only replaces the thinkers and world state.
+//
+
+static byte *snapshotbuffer;
+static size_t snapshotsize;
+
+size_t G_ArchiveSnapshot(byte **buffer)
+{
+  size_t gamesize = savegamesize;
+  size_t length;
+
+  if (!snapshotbuffer)
+    snapshotbuffer = malloc(snapshotsize = SAVEGAMESIZE);
+
+  // borrow the savegame buffer functions
+  savegamesize = snapshotsize;
+  save_p = savebuffer = snapshotbuffer;
+
+  CheckSaveGame(sizeof(int) * 6 + ITEMQUESIZE *
+                (sizeof(*itemrespawnque) + sizeof(*itemrespawntime)));
+  saveg_write32(leveltime);
+  saveg_write32(gametic - basetic);
+  saveg_write32(totalleveltimes);
+  saveg_write32(extrakills);
+  saveg_write32(demoplayback ? demo_p - demobuffer : 0);
+
+  // item respawn queue
+  saveg_write32(iquehead | iquetail << 16);
+  memcpy(save_p, itemrespawnque, ITEMQUESIZE * sizeof(*itemrespawnque));
+  save_p += ITEMQUESIZE * sizeof(*itemrespawnque);
+  memcpy(save_p, itemrespawntime, ITEMQUESIZE * sizeof(*itemrespawntime));
+  save_p += ITEMQUESIZE * sizeof(*itemrespawntime);
+
+  P_ArchivePlayers();
+  P_ArchiveWorld();
+  P_ArchiveThinkers();
+  P_ArchiveSpecials();
+  P_ArchiveRNG();
+  P_ArchiveMap();
+
+  length = save_p - savebuffer;
 
-  if (name) (free)(name);
+  snapshotbuffer = savebuffer;
+  snapshotsize = savegamesize;
+  savegamesize = gamesize;
+  savebuffer = save_p = NULL;
+
+  *buffer = snapshotbuffer;
+  return length;
+}
+
+void G_UnArchiveSnapshot(byte *buffer)
+{
+  thinker_t *th, *next;
+  int i;
+
+  save_p = buffer;
+  saveg_compat = saveg_current;
+
+  leveltime = saveg_read32();
+  basetic = gametic - saveg_read32();
+  totalleveltimes = saveg_read32();
+  extrakills = saveg_read32();
+  i = saveg_read32();
+  if (demoplayback)
+    demo_p = demobuffer + i;
+
+  // Get rid of the current thinkers. Unlike P_UnArchiveThinkers(), free
+  // the removed mobjs too, there is no level reload to free them later.
+  for (th = thinkercap.next; th != &thinkercap; th = th->next)
+    if (th->function == P_MobjThinker)
+      P_RemoveMobj((mobj_t *) th);
+  for (th = thinkercap.next; th != &thinkercap; th = next)
+    {
+      next = th->next;
+      Z_Free(th);
+    }
+  P_InitThinkers();
+  P_RemoveAllActiveCeilings();
+  P_RemoveAllActivePlats();
+  bodyqueslot = 0;
+
+  // after P_RemoveMobj() above, which adds to the queue
+  i = saveg_read32();
+  iquehead = i & 0xffff;
+  iquetail = i >> 16;
+  memcpy(itemrespawnque, save_p, ITEMQUESIZE * sizeof(*itemrespawnque));
+  save_p += ITEMQUESIZE * sizeof(*itemrespawnque);
+  memcpy(itemrespawntime, save_p, ITEMQUESIZE * sizeof(*itemrespawntime));
+  save_p += ITEMQUESIZE * sizeof(*itemrespawntime);
+
+  P_UnArchivePlayers();
+  P_UnArchiveWorld();
+  P_UnArchiveThinkers();
+  P_UnArchiveSpecials();
+  P_UnArchiveRNG();
+  P_UnArchiveMap();
+
+  save_p = NULL;
 }
 
 static void G_DoLoadGame(void)
@@ -1741,7 +2196,9 @@ static void G_DoLoadGame(void)
 
   gameaction = ga_nothing;
 
-  length = M_ReadFile(savename, &savebuffer);
+  G_WaitSaveGame();
+
+  length = G_ReadSaveGame(savename, &savebuffer);
   save_p = savebuffer + SAVESTRINGSIZE;
 
   // skip the description field
@@ -1920,6 +2377,8 @@ void G_Ticker(void)
 {
   int i;
 
+  G_FinishSaveGame(false);
+
   // do player reborns if needed
   for (i=0 ; i<MAXPLAYERS ; i++)
     if (playeringame[i] && players[i].playerstate == PST_REBORN)
@@ -1960,6 +2419,9 @@ void G_Ticker(void)
       case ga_reloadlevel:
 	G_ReloadLevel();
 	break;
+      case ga_rewind:
+	G_DoRewind();
+	break;
       default:  // killough 9/29/98
 	gameaction = ga_nothing;
 	break;
@@ -1974,6 +2436,9 @@ void G_Ticker(void)
       G_DoSaveGame();
     }
 
+  if (gamestate == GS_LEVEL)
+    G_RewindTicker();
+
   // killough 9/29/98: Skip some commands while pausing during demo
   // playback, or while menu is active.
   //
@@ -2074,6 +2539,8 @@ void G_Ticker(void)
       gamestate == GS_INTERMISSION ? WI_Ticker() :
 	gamestate == GS_FINALE ? F_Ticker() :
 	  gamestate == GS_DEMOSCREEN ? D_PageTicker() : (void) 0;
+
+  D_DemoSyncTic();
 }
 
 //
@@ -3204,6 +3671,10 @@ void G_BeginRecording(void)
 {
   int i;
 
+  if (!(demofile = fopen(demoname, "wb")))
+    I_Error("Error recording demo %s: %s", demoname,
+            errno ? strerror(errno) : "(Unknown Error)");
+
   demo_p = demobuffer;
 
   if (demo_version == 203 || mbf21)
@@ -3296,6 +3767,9 @@ void G_BeginRecording(void)
     for (i=0; i<4; i++)  // intentionally hard-coded 4 -- killough
       *demo_p++ = playeringame[i];
   }
+
+  // The header goes to disk right away.
+  G_FlushDemo();
 }
 
 //
@@ -3374,6 +3848,96 @@ static void G_AddDemoFooter(void)
   (free)(str);
 }
 
+//
+// G_RecoverDemo
+//
+// Salvages a demo whose recording was cut short, e.g. by a crash. It is
+// cut after the last complete tic and ended with a DEMOMARKER, written to
+// <name>-recovered.lmp. Only the formats G_BeginRecording() writes are
+// known.
+//
+
+void G_RecoverDemo(const char *name)
+{
+  int length, header, numslots, cmdsize, players = 0, tics = 0, i;
+  byte *buffer, *p, *end;
+  char *base, *dot, *outname;
+
+  length = M_ReadFile(name, &buffer);
+
+  if (length < 1)
+    I_Error("G_RecoverDemo: %s is empty", name);
+
+  // room for the marker
+  buffer = Z_Realloc(buffer, length + 1, PU_STATIC, 0);
+
+  switch (buffer[0])
+  {
+    case 109:
+    case 111:
+      header = 9;
+      numslots = 4;   // intentionally hard-coded 4 -- killough
+      cmdsize = buffer[0] == 111 ? 5 : 4;
+      break;
+    case 202:
+    case 203:
+      header = 13 + GAME_OPTION_SIZE;
+      numslots = MIN_MAXPLAYERS;
+      cmdsize = 4;
+      break;
+    case 221:
+      header = 12 + MBF21_GAME_OPTION_SIZE;
+      numslots = MIN_MAXPLAYERS;
+      cmdsize = 5;
+      break;
+    default:
+      I_Error("G_RecoverDemo: %s: Unknown demo format %d", name, buffer[0]);
+      return;
+  }
+
+  if (header + numslots > length)
+    I_Error("G_RecoverDemo: %s: Demo header is incomplete", name);
+
+  for (i = 0; i < MIN(numslots, MAXPLAYERS); i++)
+    players += buffer[header + i] != 0;
+
+  if (!players)
+    I_Error("G_RecoverDemo: %s: No players in demo", name);
+
+  p = buffer + header + numslots;
+  end = buffer + length;
+
+  // One command per player and tic, the marker takes the place of the
+  // first command after the last tic.
+  for (; p + players * cmdsize <= end && *p != DEMOMARKER; p += players * cmdsize)
+    tics++;
+
+  if (p < end && *p == DEMOMARKER)
+  {
+    printf("G_RecoverDemo: %s is complete, %d tics\n", name, tics);
+    Z_Free(buffer);
+    return;
+  }
+
+  base = M_StringDuplicate(name);
+  if ((dot = strrchr(base, '.')) && !strchr(dot, '/') && !strchr(dot, '\\'))
+    *dot = '\0';
+  outname = M_StringJoin(base, "-recovered.lmp", NULL);
+
+  *p++ = DEMOMARKER;   // overwrites the partial command, if any
+
+  if (!M_WriteFile(outname, buffer, p - buffer))
+    I_Error("G_RecoverDemo: Could not write %s: %s", outname,
+            errno ? strerror(errno) : "(Unknown Error)");
+
+  printf("G_RecoverDemo: %d tics (%d:%02d) salvaged from %s, written to %s\n",
+         tics, tics / TICRATE / 60, tics / TICRATE % 60, name, outname);
+
+  Z_Free(buffer);
+  (free)(base);
+  (free)(outname);
+}
+
 //===================
 //=
 //= G_CheckDemoStatus
@@ -3391,9 +3955,7 @@ boolean G_CheckDemoStatus(void)
 
       G_AddDemoFooter();
 
-      if (!M_WriteFile(demoname, demobuffer, demo_p - demobuffer))
-	I_Error("Error recording demo %s: %s", demoname,  // killough 11/98
-		errno ? strerror(errno) : "(Unknown Error)");
+      G_CloseDemo();
 
       free(demobuffer);
       demobuffer = NULL;  // killough
@@ -3411,6 +3973,13 @@ boolean G_CheckDemoStatus(void)
       int endtime = I_GetTime_RealTime();
       // killough -- added fps information and made it work for longer demos:
       unsigned realtics = endtime-starttime;
+      if (benchmark)
+        {
+          D_BenchReport(gametic, realtics);
+          I_SafeExit(0);
+        }
+      if (demosync)
+        I_SafeExit(D_DemoSyncFinish());
       I_Error ("Timed %u gametics in %u realtics = %-.1f frames per second",
                (unsigned) gametic,realtics,
                (unsigned) gametic * (double) TICRATE / realtics);
@@ -3419,7 +3988,7 @@ boolean G_CheckDemoStatus(void)
   if (demoplayback)
     {
       if (singledemo)
-        I_SafeExit(0);  // killough
+        I_SafeExit(D_DemoSyncFinish());  // killough
 
       // [FG] ignore empty demo lumps
       if (demobuffer)
@@ -50,6 +50,7 @@ void G_ForcedLoadGame(void);           // killough 5/15/98: forced loadgames
 void G_SaveGame(int slot, char *description); // Called by M_Responder.
 void G_RecordDemo(char *name);              // Only called by startup code.
 void G_BeginRecording(void);
+void G_RecoverDemo(const char *name);       // -recoverdemo
 void G_PlayDemo(char *name);
 void G_ExitLevel(void);
 void G_SecretExitLevel(void);
@@ -59,6 +60,7 @@ void G_ScreenShot(void);
 void G_ReloadDefaults(void);     // killough 3/1/98: loads game defaults
 char *G_SaveGameName(int); // killough 3/22/98: sets savegame filename
 char *G_MBFSaveGameName(int); // MBF savegame filename
+void G_WaitSaveGame(void);       // wait until a savegame is on disk
 void G_SetFastParms(int);        // killough 4/10/98: sets -fast parameters
 void G_DoNewGame(void);
 void G_DoReborn(int playernum);
@@ -71,7 +73,12 @@ ULong64 G_Signature(void);      // killough 12/98
 
 int G_ValidateMapName(const char *mapname, int *pEpi, int *pMap);
 
+// rewind snapshots, see g_rewind.c
+size_t G_ArchiveSnapshot(byte **buffer);
+void G_UnArchiveSnapshot(byte *buffer);
+
 extern int  default_complevel;
+extern int  compress_savegames;
 
 // killough 5/2/98: moved from m_misc.c:
 extern int  key_escape;
@@ -0,0 +1,297 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      In-memory rewind snapshots.
+//
+//      Every rewind_interval tics the level is archived with the
+//      savegame code (G_ArchiveSnapshot) into a list of snapshots. Only
+//      the newest snapshot is kept verbatim, each older one is stored as
+//      a delta against its successor. Taking a snapshot thus encodes
+//      just one delta, and the oldest snapshots can be dropped to stay
+//      within rewind_budget without touching the others.
+//
+
+#include "doomstat.h"
+#include "d_event.h"
+#include "g_game.h"
+#include "g_rewind.h"
+#include "i_system.h"
+
+int rewind_interval;
+int rewind_budget = 32;
+
+typedef struct
+{
+  byte *data;       // newest: the snapshot, others: delta to the next one
+  size_t size;      // size of data
+  size_t length;    // length of the snapshot
+  int leveltime;
+} snapshot_t;
+
+static snapshot_t *snapshots;     // oldest first
+static int numsnapshots, maxsnapshots;
+static size_t memory_used;
+
+// statistics
+static int num_taken;
+static uint64_t time_taken, max_time_taken;
+static size_t max_memory_used;
+
+//
+// Delta coding
+//
+// A delta is the XOR of a snapshot with its reference, where the bytes
+// beyond a shorter reference count as zero. It is stored as pairs of a
+// run of zero bytes, which are skipped, and a run of literal bytes, each
+// run preceded by its length in a 7-bit variable-length code. Zero runs
+// shorter than MIN_ZERO_RUN are not worth a new pair.
+//
+
+#define MIN_ZERO_RUN 8
+
+// upper bound of the size of a delta of a snapshot of length len
+#define MAX_DELTA_SIZE(len) ((len) + (len) / 64 + 32)
+
+#define REFBYTE(i) ((i) < reflen ? ref[i] : 0)
+
+static byte *WriteLength(byte *p, size_t n)
+{
+  while (n >= 0x80)
+    {
+      *p++ = (byte) n | 0x80;
+      n >>= 7;
+    }
+  *p++ = (byte) n;
+  return p;
+}
+
+static const byte *ReadLength(const byte *p, size_t *n)
+{
+  int shift = 0;
+
+  *n = 0;
+  do
+    {
+      *n |= (size_t)(*p & 0x7f) << shift;
+      shift += 7;
+    }
+  while (*p++ & 0x80);
+
+  return p;
+}
+
+static size_t EncodeDelta(byte *out, const byte *src, size_t len,
+                          const byte *ref, size_t reflen)
+{
+  byte *p = out;
+  size_t i = 0;
+
+  while (i < len)
+    {
+      size_t start, j;
+
+      for (start = i; i < len && src[i] == REFBYTE(i); i++)
+        ;
+
+      p = WriteLength(p, i - start);
+
+      // extend the literals up to the next long enough zero run
+      for (start = j = i; j < len; )
+        if (src[j] != REFBYTE(j))
+          i = ++j;
+        else
+          {
+            while (j < len && src[j] == REFBYTE(j))
+              j++;
+            if (j - i >= MIN_ZERO_RUN)
+              break;
+          }
+
+      p = WriteLength(p, i - start);
+
+      for (j = start; j < i; j++)
+        *p++ = src[j] ^ REFBYTE(j);
+    }
+
+  return p - out;
+}
+
+static void DecodeDelta(byte *dst, size_t len, const byte *delta,
+                        const byte *ref, size_t reflen)
+{
+  size_t i = 0;
+
+  while (i < len)
+    {
+      size_t zeros, literals;
+
+      delta = ReadLength(delta, &zeros);
+      delta = ReadLength(delta, &literals);
+
+      for (; zeros && i < reflen; zeros--, i++)
+        dst[i] = ref[i];
+      memset(dst + i, 0, zeros);
+      i += zeros;
+
+      for (; literals; literals--, i++)
+        dst[i] = *delta++ ^ REFBYTE(i);
+    }
+}
+
+//
+// Snapshot list
+//
+
+static void DropOldest(void)
+{
+  memory_used -= snapshots[0].size;
+  (free)(snapshots[0].data);
+  memmove(snapshots, snapshots + 1, --numsnapshots * sizeof(*snapshots));
+}
+
+// Drop the newest snapshot, restoring the one before it from its delta.
+
+static void DropNewest(void)
+{
+  snapshot_t *newest = &snapshots[numsnapshots - 1];
+  snapshot_t *prev = newest - 1;
+  byte *data = (malloc)(prev->length);
+
+  if (!data)
+    I_Error("DropNewest: out of memory");
+
+  DecodeDelta(data, prev->length, prev->data, newest->data, newest->length);
+
+  memory_used += prev->length - prev->size;
+  (free)(prev->data);
+  prev->data = data;
+  prev->size = prev->length;
+
+  memory_used -= newest->size;
+  (free)(newest->data);
+  numsnapshots--;
+}
+
+void G_ClearRewind(void)
+{
+  while (numsnapshots)
+    DropOldest();
+}
+
+static void PrintRewindStats(void)
+{
+  if (num_taken)
+    printf("G_RewindStats: %d snapshots, %.1f us average, %.1f us max, "
+           "%lu KiB max memory\n", num_taken,
+           (double) time_taken / num_taken, (double) max_time_taken,
+           (unsigned long) (max_memory_used >> 10));
+}
+
+static void TakeSnapshot(void)
+{
+  const uint64_t start = I_GetTimeUS();
+  uint64_t elapsed;
+  snapshot_t *newest;
+  byte *buffer;
+  size_t length = G_ArchiveSnapshot(&buffer);
+
+  if (numsnapshots)
+    {
+      // store the current newest snapshot as a delta against this one
+      byte *delta;
+      size_t size;
+
+      newest = &snapshots[numsnapshots - 1];
+      delta = (malloc)(MAX_DELTA_SIZE(newest->length));
+      if (!delta)
+        I_Error("TakeSnapshot: out of memory");
+
+      size = EncodeDelta(delta, newest->data, newest->length, buffer, length);
+      delta = (realloc)(delta, size ? size : 1);
+
+      memory_used += size - newest->size;
+      (free)(newest->data);
+      newest->data = delta;
+      newest->size = size;
+    }
+
+  if (numsnapshots == maxsnapshots)
+    {
+      maxsnapshots = maxsnapshots ? maxsnapshots * 2 : 64;
+      snapshots = (realloc)(snapshots, maxsnapshots * sizeof(*snapshots));
+      if (!snapshots)
+        I_Error("TakeSnapshot: out of memory");
+    }
+
+  newest = &snapshots[numsnapshots++];
+  newest->data = (malloc)(length);
+  if (!newest->data)
+    I_Error("TakeSnapshot: out of memory");
+  memcpy(newest->data, buffer, length);
+  newest->size = newest->length = length;
+  newest->leveltime = leveltime;
+  memory_used += length;
+
+  while (numsnapshots > 1 && memory_used > (size_t) rewind_budget << 20)
+    DropOldest();
+
+  elapsed = I_GetTimeUS() - start;
+
+  if (!num_taken++)
+    I_AtExit(PrintRewindStats, false);
+  time_taken += elapsed;
+  if (elapsed > max_time_taken)
+    max_time_taken = elapsed;
+  if (memory_used > max_memory_used)
+    max_memory_used = memory_used;
+}
+
+void G_RewindTicker(void)
+{
+  if (!rewind_interval || netgame || demorecording ||
+      leveltime % rewind_interval)
+    return;
+
+  // not again while paused or right after a rewind
+  if (numsnapshots && snapshots[numsnapshots - 1].leveltime == leveltime)
+    return;
+
+  TakeSnapshot();
+}
+
+void G_DoRewind(void)
+{
+  static char message[64];
+  player_t *player = &players[consoleplayer];
+
+  gameaction = ga_nothing;
+
+  if (!numsnapshots)
+    {
+      player->message = "No rewind snapshot";
+      return;
+    }
+
+  // Skip a snapshot taken only a moment ago,
+  // so that rewinding repeatedly goes further back.
+  if (numsnapshots > 1 &&
+      leveltime - snapshots[numsnapshots - 1].leveltime < TICRATE/2)
+    DropNewest();
+
+  G_UnArchiveSnapshot(snapshots[numsnapshots - 1].data);
+
+  sprintf(message, "Rewound to %d:%02d",
+          leveltime / TICRATE / 60, leveltime / TICRATE % 60);
+  player->message = message;
+}
@@ -0,0 +1,35 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      In-memory rewind snapshots.
+//
+
+#ifndef __G_REWIND__
+#define __G_REWIND__
+
+#include "doomtype.h"
+
+extern int rewind_interval;   // tics between snapshots, 0 = off
+extern int rewind_budget;     // snapshot memory limit, in MiB
+
+// Called by G_Ticker at the start of each level tic.
+void G_RewindTicker(void);
+
+// Restore the last snapshot (ga_rewind).
+void G_DoRewind(void);
+
+// Drop all snapshots, on level changes.
+void G_ClearRewind(void);
+
+#endif
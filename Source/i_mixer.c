@@ -0,0 +1,567 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Sound effect mixer.
+//
+//      Sound effects are kept as mono samples at the output rate and
+//      mixed straight into the stream of SDL_mixer from its post-mix
+//      hook, on top of the music. Each voice steps through its samples in
+//      32.32 fixed point, interpolating linearly when it plays at another
+//      pitch than it was resampled for, and scales them by its left and
+//      right volumes in the same pass. Volume changes, panning included,
+//      and stopped sounds are ramped over a few milliseconds so that they
+//      do not click.
+//
+//      Voices are mixed a block at a time into a float buffer, which is
+//      then added to the stream with saturation, by the fastest kernels
+//      the CPU supports, unless -nosimd is given. -mixbench times them.
+//
+
+#include "SDL.h"
+#include "SDL_mixer.h"
+#include <math.h>
+
+#include "doomdef.h"
+#include "i_mixer.h"
+#include "i_sound.h"
+#include "i_system.h"
+#include "m_argv.h"
+
+#define MIXBLOCK 256          // frames mixed into the float buffer at once
+#define RAMPRATE 200          // volume ramps take 1/RAMPRATE of a second
+
+enum { voice_free, voice_playing, voice_stopping };
+
+typedef struct
+{
+  int state;
+  const Sint16 *data;
+  Uint32 length;        // in samples, a guard sample follows
+  Uint64 pos, step;     // 32.32 fixed point
+  float gain[2];        // current left and right volumes
+  float target[2];      // volumes ramped to
+  int ramp;             // frames left until target is reached
+} voice_t;
+
+static voice_t voices[MIXER_VOICES];
+static SDL_mutex *mixer_lock;
+static int rampframes;
+
+// Voice frames mixed, for the benchmark.
+static uint64_t mixedframes;
+
+//
+// Kernels
+//
+// Both kernels step the voice and the volume ramps in exactly the same
+// float arithmetic, frame by frame, so that their output is identical.
+//
+
+// Add frames of a voice, starting at pos, to the stereo buffer acc.
+typedef void (*mixvoice_t)(float *acc, const Sint16 *data, Uint64 pos,
+                           Uint64 step, int frames, const float *gain,
+                           const float *delta);
+
+// Add samples of acc to the stream, with saturation.
+typedef void (*mixoutput_t)(Sint16 *stream, const float *acc, int samples);
+
+static inline float Sample(const Sint16 *data, Uint64 pos)
+{
+  const Sint16 *in = data + (pos >> 32);
+
+  return in[0] + (in[1] - in[0]) * ((Uint32) pos * (1.0f / 4294967296.0f));
+}
+
+// Frames i up to frames, the volumes ramp from frame 0.
+static inline void MixFrames(float *acc, const Sint16 *data, Uint64 pos,
+                             Uint64 step, int i, int frames,
+                             const float *gain, const float *delta)
+{
+  for (pos += step * i; i < frames; i++, pos += step)
+  {
+    const float s = Sample(data, pos);
+
+    acc[2*i]   += s * (gain[0] + i * delta[0]);
+    acc[2*i+1] += s * (gain[1] + i * delta[1]);
+  }
+}
+
+static void MixVoice_Scalar(float *acc, const Sint16 *data, Uint64 pos,
+                            Uint64 step, int frames, const float *gain,
+                            const float *delta)
+{
+  MixFrames(acc, data, pos, step, 0, frames, gain, delta);
+}
+
+static void MixOutput_Scalar(Sint16 *stream, const float *acc, int samples)
+{
+  int i;
+
+  for (i = 0; i < samples; i++)
+  {
+    const int x = stream[i] + (int) lrintf(acc[i]);
+    stream[i] = BETWEEN(-32768, 32767, x);
+  }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+#define HAVE_SSE2_MIX
+
+// Four frames at once. Sounds playing at the pitch they were resampled
+// for are loaded straight from memory, the others are interpolated one
+// sample at a time, as there is no gather before AVX2.
+
+__attribute__((target("sse2")))
+static void MixVoice_SSE2(float *acc, const Sint16 *data, Uint64 pos,
+                          Uint64 step, int frames, const float *gain,
+                          const float *delta)
+{
+  const __m128 ramp = _mm_setr_ps(0, 1, 2, 3);
+  const __m128 left = _mm_set1_ps(gain[0]), dleft = _mm_set1_ps(delta[0]);
+  const __m128 right = _mm_set1_ps(gain[1]), dright = _mm_set1_ps(delta[1]);
+  const boolean whole = step == (1ull << 32) && !(Uint32) pos;
+  int i;
+
+  for (i = 0; i + 4 <= frames; i += 4)
+  {
+    const __m128 idx = _mm_add_ps(_mm_set1_ps((float) i), ramp);
+    __m128 s, l, r;
+
+    if (whole)
+    {
+      const __m128i in = _mm_loadl_epi64((const __m128i *)
+                                         (data + (pos >> 32) + i));
+      s = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+    }
+    else
+    {
+      const Uint64 p = pos + step * i;
+      s = _mm_setr_ps(Sample(data, p), Sample(data, p + step),
+                      Sample(data, p + 2 * step), Sample(data, p + 3 * step));
+    }
+
+    l = _mm_mul_ps(s, _mm_add_ps(left, _mm_mul_ps(idx, dleft)));
+    r = _mm_mul_ps(s, _mm_add_ps(right, _mm_mul_ps(idx, dright)));
+
+    _mm_storeu_ps(acc + 2*i, _mm_add_ps(_mm_loadu_ps(acc + 2*i),
+                                        _mm_unpacklo_ps(l, r)));
+    _mm_storeu_ps(acc + 2*i + 4, _mm_add_ps(_mm_loadu_ps(acc + 2*i + 4),
+                                            _mm_unpackhi_ps(l, r)));
+  }
+
+  MixFrames(acc, data, pos, step, i, frames, gain, delta);
+}
+
+__attribute__((target("sse2")))
+static void MixOutput_SSE2(Sint16 *stream, const float *acc, int samples)
+{
+  int i;
+
+  for (i = 0; i + 8 <= samples; i += 8)
+  {
+    const __m128i in = _mm_loadu_si128((const __m128i *) (stream + i));
+    const __m128i lo = _mm_add_epi32(_mm_cvtps_epi32(_mm_loadu_ps(acc + i)),
+                         _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+    const __m128i hi = _mm_add_epi32(_mm_cvtps_epi32(_mm_loadu_ps(acc + i + 4)),
+                         _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+
+    _mm_storeu_si128((__m128i *) (stream + i), _mm_packs_epi32(lo, hi));
+  }
+
+  if (i < samples)
+    MixOutput_Scalar(stream + i, acc + i, samples - i);
+}
+#endif
+
+typedef struct
+{
+  const char *name;
+  mixvoice_t mixvoice;
+  mixoutput_t mixoutput;
+} mixkernels_t;
+
+static const mixkernels_t mixkernels[] =
+{
+  {"scalar", MixVoice_Scalar, MixOutput_Scalar},
+#ifdef HAVE_SSE2_MIX
+  {"SSE2",   MixVoice_SSE2,   MixOutput_SSE2},
+#endif
+};
+
+static const mixkernels_t *kernels = mixkernels;
+
+static boolean KernelsSupported(const mixkernels_t *k)
+{
+#ifdef HAVE_SSE2_MIX
+  if (!strcmp(k->name, "SSE2"))
+    return __builtin_cpu_supports("sse2");
+#endif
+  return true;
+}
+
+//
+// Mixing
+//
+
+static void MixVoice(voice_t *v, float *acc, int frames)
+{
+  const Uint64 end = (Uint64) v->length << 32;
+
+  while (frames > 0)
+  {
+    float delta[2] = {0, 0};
+    Uint64 left;
+    int n = frames;
+
+    if (v->pos >= end)
+    {
+      v->state = voice_free;
+      return;
+    }
+
+    left = (end - v->pos + v->step - 1) / v->step;
+    if (left < n)
+      n = left;
+
+    if (v->ramp > 0)
+    {
+      n = MIN(n, v->ramp);
+      delta[0] = (v->target[0] - v->gain[0]) / v->ramp;
+      delta[1] = (v->target[1] - v->gain[1]) / v->ramp;
+    }
+
+    kernels->mixvoice(acc, v->data, v->pos, v->step, n, v->gain, delta);
+    mixedframes += n;
+
+    v->pos += v->step * n;
+    acc += 2 * n;
+    frames -= n;
+
+    if (v->ramp > 0)
+    {
+      if ((v->ramp -= n) > 0)
+      {
+        v->gain[0] += delta[0] * n;
+        v->gain[1] += delta[1] * n;
+      }
+      else
+      {
+        v->gain[0] = v->target[0];
+        v->gain[1] = v->target[1];
+
+        if (v->state == voice_stopping)
+        {
+          v->state = voice_free;
+          return;
+        }
+      }
+    }
+  }
+}
+
+static void MixStream(voice_t *v, int numvoices, Sint16 *stream, int frames)
+{
+  static float acc[2 * MIXBLOCK];
+
+  while (frames > 0)
+  {
+    const int n = MIN(frames, MIXBLOCK);
+    boolean active = false;
+    int i;
+
+    memset(acc, 0, 2 * n * sizeof(*acc));
+
+    for (i = 0; i < numvoices; i++)
+    {
+      if (v[i].state != voice_free)
+      {
+        MixVoice(&v[i], acc, n);
+        active = true;
+      }
+    }
+
+    if (active)
+      kernels->mixoutput(stream, acc, 2 * n);
+
+    stream += 2 * n;
+    frames -= n;
+  }
+}
+
+// Runs on the audio thread, after SDL_mixer has mixed the music.
+static void MixCallback(void *udata, Uint8 *stream, int len)
+{
+  SDL_LockMutex(mixer_lock);
+  MixStream(voices, MIXER_VOICES, (Sint16 *) stream, len / 4);
+  SDL_UnlockMutex(mixer_lock);
+}
+
+//
+// Voices
+//
+
+static void StartVoice(voice_t *v, const Sint16 *data, Uint32 length,
+                       Uint64 step, int left, int right)
+{
+  v->state = voice_playing;
+  v->data = data;
+  v->length = length;
+  v->pos = 0;
+  v->step = step;
+  v->gain[0] = v->target[0] = left / 255.0f;
+  v->gain[1] = v->target[1] = right / 255.0f;
+  v->ramp = 0;
+}
+
+static void RampVoice(voice_t *v, int left, int right)
+{
+  v->target[0] = left / 255.0f;
+  v->target[1] = right / 255.0f;
+  v->ramp = rampframes;
+}
+
+void I_MixerStart(int voice, const short *data, unsigned int length,
+                  int step, int left, int right)
+{
+  SDL_LockMutex(mixer_lock);
+  StartVoice(&voices[voice], data, length, (Uint64) step << 16, left, right);
+  SDL_UnlockMutex(mixer_lock);
+}
+
+void I_MixerSetParams(int voice, int left, int right)
+{
+  SDL_LockMutex(mixer_lock);
+  if (voices[voice].state == voice_playing)
+    RampVoice(&voices[voice], left, right);
+  SDL_UnlockMutex(mixer_lock);
+}
+
+void I_MixerStop(int voice)
+{
+  SDL_LockMutex(mixer_lock);
+  if (voices[voice].state == voice_playing)
+  {
+    RampVoice(&voices[voice], 0, 0);
+    voices[voice].state = voice_stopping;
+  }
+  SDL_UnlockMutex(mixer_lock);
+}
+
+boolean I_MixerPlaying(int voice)
+{
+  boolean playing;
+
+  SDL_LockMutex(mixer_lock);
+  playing = voices[voice].state != voice_free;
+  SDL_UnlockMutex(mixer_lock);
+
+  return playing;
+}
+
+//
+// I_InitMixer
+// Selects the fastest kernels the CPU supports, unless -nosimd is given,
+// and starts mixing. Returns their name.
+//
+
+const char *I_InitMixer(void)
+{
+  int i;
+
+  kernels = mixkernels;
+
+  if (!M_CheckParm("-nosimd"))
+    for (i = arrlen(mixkernels); --i > 0; )
+      if (KernelsSupported(&mixkernels[i]))
+      {
+        kernels = &mixkernels[i];
+        break;
+      }
+
+  rampframes = MAX(snd_samplerate / RAMPRATE, 1);
+
+  if (!mixer_lock && !(mixer_lock = SDL_CreateMutex()))
+    I_Error("I_InitMixer: %s", SDL_GetError());
+
+  memset(voices, 0, sizeof(voices));
+  Mix_SetPostMix(MixCallback, NULL);
+
+  return kernels->name;
+}
+
+void I_ShutdownMixer(void)
+{
+  Mix_SetPostMix(NULL, NULL);
+}
+
+//
+// I_MixerBenchmark
+// Mixes ten seconds of BENCHVOICES voices, playing random noise at random
+// pitches, volumes and panning, which change every tic, with each of the
+// supported kernels. Checks that they all put out the very same samples
+// as the scalar kernels, and reports the time it takes to mix a second of
+// 1000 voices. Run by -mixbench.
+//
+
+#define BENCHVOICES 1000
+#define BENCHSOUNDS 16
+#define BENCHSECONDS 10
+#define BENCHSLICE 1024
+#define BENCHPASSES 3
+
+static unsigned benchseed;
+
+static unsigned BenchRandom(void)
+{
+  benchseed = benchseed * 1103515245 + 12345;
+  return benchseed >> 8;
+}
+
+static Sint16 *benchsounds[BENCHSOUNDS];
+static Uint32 benchlengths[BENCHSOUNDS];
+
+static void BenchVoice(voice_t *v)
+{
+  const int sound = BenchRandom() % BENCHSOUNDS;
+  Uint64 step = 1ull << 32;
+
+  // half of them play at a pitch of their own
+  if (BenchRandom() & 1)
+    step = (Uint64) ((0.84 + (BenchRandom() % 1000) * 0.00035) * step);
+
+  StartVoice(v, benchsounds[sound], benchlengths[sound], step,
+             BenchRandom() % 128, BenchRandom() % 128);
+}
+
+static void BenchTic(voice_t *v)
+{
+  int i;
+
+  for (i = 0; i < BENCHVOICES; i++)
+  {
+    if (v[i].state == voice_free)
+      BenchVoice(&v[i]);
+    else if (v[i].state == voice_playing)
+    {
+      const unsigned r = BenchRandom() % 64;
+
+      if (r < 8)
+        RampVoice(&v[i], BenchRandom() % 128, BenchRandom() % 128);
+      else if (r == 8)
+      {
+        RampVoice(&v[i], 0, 0);
+        v[i].state = voice_stopping;
+      }
+    }
+  }
+}
+
+void I_MixerBenchmark(void)
+{
+  const mixkernels_t *kernels_save = kernels;
+  const int samplerate = snd_samplerate;
+  const int frames = BENCHSECONDS * samplerate;
+  const size_t size = 2 * frames * sizeof(Sint16);
+  voice_t *v = (malloc)(BENCHVOICES * sizeof(*v));
+  Sint16 *stream = (malloc)(size);
+  Sint16 *reference = (malloc)(size);
+  int i, j;
+
+  if (!v || !stream || !reference)
+    I_Error("I_MixerBenchmark: out of memory");
+
+  rampframes = MAX(samplerate / RAMPRATE, 1);
+
+  // noise bursts of 0.1 to 1.6 seconds
+  benchseed = 1;
+  for (i = 0; i < BENCHSOUNDS; i++)
+  {
+    benchlengths[i] = samplerate / 10 + BenchRandom() % (samplerate * 3 / 2);
+    benchsounds[i] = (malloc)((benchlengths[i] + 1) * sizeof(Sint16));
+    if (!benchsounds[i])
+      I_Error("I_MixerBenchmark: out of memory");
+
+    for (j = 0; j < benchlengths[i]; j++)
+      benchsounds[i][j] = (Sint16) BenchRandom();
+    benchsounds[i][j] = 0;
+  }
+
+  for (j = 0; j < arrlen(mixkernels); j++)
+  {
+    uint64_t best = UINT64_MAX;
+    double voiceseconds = 0, ms;
+    int pass;
+
+    if (!KernelsSupported(&mixkernels[j]))
+      continue;
+
+    kernels = &mixkernels[j];
+
+    // best of several passes over the same voices
+    for (pass = 0; pass < BENCHPASSES; pass++)
+    {
+      const int ticframes = samplerate / TICRATE;
+      int done = 0, nexttic = 0;
+      uint64_t start;
+
+      benchseed = 2;
+      mixedframes = 0;
+      memset(v, 0, BENCHVOICES * sizeof(*v));
+      memset(stream, 0, size);
+      start = I_GetTimeUS();
+
+      while (done < frames)
+      {
+        const int n = MIN(BENCHSLICE, frames - done);
+
+        if (done >= nexttic)
+        {
+          BenchTic(v);
+          nexttic += ticframes;
+        }
+
+        MixStream(v, BENCHVOICES, stream + 2 * done, n);
+        done += n;
+      }
+
+      start = I_GetTimeUS() - start;
+      if (start < best)
+        best = start;
+
+      voiceseconds = (double) mixedframes / samplerate;
+    }
+
+    if (!j)
+      memcpy(reference, stream, size);
+
+    // ms to mix a second of 1000 voices
+    ms = best / voiceseconds;
+
+    printf("I_MixerBenchmark: %-8s %.0f voices on average, %6.2f ms per "
+           "second of 1000 voices (%.1f%% of real time)%s\n", kernels->name,
+           voiceseconds / BENCHSECONDS, ms, ms / 10,
+           j && memcmp(reference, stream, size) ? "  MISMATCH" : "");
+  }
+
+  kernels = kernels_save;
+
+  for (i = 0; i < BENCHSOUNDS; i++)
+    (free)(benchsounds[i]);
+
+  (free)(v);
+  (free)(stream);
+  (free)(reference);
+}
@@ -0,0 +1,48 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Sound effect mixer.
+//
+
+#ifndef __I_MIXER__
+#define __I_MIXER__
+
+#include "doomtype.h"
+
+#define MIXER_VOICES 256
+
+// Hook the mixer into the open audio device. Returns the name of the
+// mixing kernels in use.
+const char *I_InitMixer(void);
+void I_ShutdownMixer(void);
+
+// Play length mono samples at the output rate, followed by one guard
+// sample, on a voice. step is the 16.16 fixed point stepping through
+// them, left and right are the volumes, 0 to 255.
+void I_MixerStart(int voice, const short *data, unsigned int length,
+                  int step, int left, int right);
+
+// Change the volumes of a playing voice.
+void I_MixerSetParams(int voice, int left, int right);
+
+// Fade a voice out.
+void I_MixerStop(int voice);
+
+// Whether a voice is still playing or fading out.
+boolean I_MixerPlaying(int voice);
+
+// Time the mixing kernels and check them against the scalar one (-mixbench).
+void I_MixerBenchmark(void);
+
+#endif
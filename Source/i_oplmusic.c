@@ -337,9 +337,9 @@ static char (*percussion_names)[32];
 
 // Voices:
 
-static opl_voice_t voices[OPL_NUM_VOICES * 2];
-static opl_voice_t *voice_free_list[OPL_NUM_VOICES * 2];
-static opl_voice_t *voice_alloced_list[OPL_NUM_VOICES * 2];
+static opl_voice_t voices[OPL_NUM_VOICES * 2 * OPL_MAX_CHIPS];
+static opl_voice_t *voice_free_list[OPL_NUM_VOICES * 2 * OPL_MAX_CHIPS];
+static opl_voice_t *voice_alloced_list[OPL_NUM_VOICES * 2 * OPL_MAX_CHIPS];
 static int voice_free_num;
 static int voice_alloced_num;
 static int opl_opl3mode;
@@ -372,6 +372,10 @@ static unsigned int last_perc_count;
 char *snd_dmxoption = "-opl3"; // [crispy] default to OPL3 emulation
 int opl_io_port = 0x388;
 
+// Number of emulated OPL chips, for more polyphony.
+
+int num_opl_chips = 1;
+
 // If true, OPL sound channels are reversed to their correct arrangement
 // (as intended by the MIDI standard) rather than the backwards one
 // used by DMX due to a bug.
@@ -637,10 +641,18 @@ static void InitVoices(void)
 
     for (i = 0; i < num_opl_voices; ++i)
     {
+        int array = i / OPL_NUM_VOICES;
+
+        // Bit 8 selects the OPL3 register array, the bits above the chip
+        if (!opl_opl3mode)
+        {
+            array <<= 1;
+        }
+
         voices[i].index = i % OPL_NUM_VOICES;
         voices[i].op1 = voice_operators[0][i % OPL_NUM_VOICES];
         voices[i].op2 = voice_operators[1][i % OPL_NUM_VOICES];
-        voices[i].array = (i / OPL_NUM_VOICES) << 8;
+        voices[i].array = array << 8;
         voices[i].current_instr = NULL;
 
         // Add this voice to the freelist.
@@ -1245,9 +1257,9 @@ static void PitchBendEvent(opl_track_data_t *track, midi_event_t *event)
 {
     opl_channel_data_t *channel;
     int i;
-    opl_voice_t *voice_updated_list[OPL_NUM_VOICES * 2];
+    opl_voice_t *voice_updated_list[OPL_NUM_VOICES * 2 * OPL_MAX_CHIPS];
     unsigned int voice_updated_num = 0;
-    opl_voice_t *voice_not_updated_list[OPL_NUM_VOICES * 2];
+    opl_voice_t *voice_not_updated_list[OPL_NUM_VOICES * 2 * OPL_MAX_CHIPS];
     unsigned int voice_not_updated_num = 0;
 
     // Update the channel bend value.  Only the MSB of the pitch bend
@@ -1701,6 +1713,17 @@ static void I_OPL_ShutdownMusic(void)
 
         I_OPL_StopSong(NULL);
 
+        {
+            unsigned int count, frames;
+
+            OPL_GetUnderruns(&count, &frames);
+            if (count)
+            {
+                printf("I_OPL_ShutdownMusic: %u underruns, %u frames missed\n",
+                       count, frames);
+            }
+        }
+
         OPL_Shutdown();
 
         // Release GENMIDI lump
@@ -1746,13 +1769,16 @@ static boolean I_OPL_InitMusic(void)
         num_opl_voices = OPL_NUM_VOICES;
     }
 
+    num_opl_chips = BETWEEN(1, OPL_MAX_CHIPS, num_opl_chips);
+    num_opl_voices *= num_opl_chips;
+
     // Secret, undocumented DMXOPTION that reverses the stereo channels
     // into their correct orientation.
     opl_stereo_correct = strstr(dmxoption, "-reverse") != NULL;
 
     // Initialize all registers.
 
-    OPL_InitRegisters(opl_opl3mode);
+    OPL_InitRegisters(opl_opl3mode, num_opl_chips);
 
     // Load instruments from GENMIDI lump:
 
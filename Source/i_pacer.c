@@ -0,0 +1,189 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Frame pacing and frame time statistics.
+//
+//      SDL_Delay() only sleeps in whole milliseconds and usually wakes
+//      up late, so I_SleepUntilNS() sleeps for all but the last bit of
+//      the wait and spins for the rest. How much it leaves to spinning
+//      adapts to how late SDL_Delay() has been waking up.
+//
+//      -framestats <file> writes histograms of the frame times and of
+//      how late the sleeps have woken up to the file on exit.
+//
+
+#include "SDL.h"
+
+#include "doomstat.h"
+#include "i_pacer.h"
+#include "i_system.h"
+#include "i_video.h"
+#include "m_argv.h"
+
+int fpslimit;
+
+// Histograms with 250 us buckets up to 100 ms, the last bucket takes
+// everything beyond.
+
+#define BUCKET_NS 250000
+#define NUMBUCKETS 401
+
+typedef struct
+{
+  const char *name;
+  uint32_t count[NUMBUCKETS];
+  uint64_t total;     // sum of all samples, in ns
+  uint64_t max;
+  uint32_t samples;
+} histogram_t;
+
+static histogram_t frametimes = { "frametime" };
+static histogram_t wakeups = { "wakeup_late" };
+static boolean framestats;
+static const char *statsname;
+
+static void AddSample(histogram_t *h, uint64_t ns)
+{
+  if (!framestats)
+    return;
+
+  h->count[MIN(ns / BUCKET_NS, NUMBUCKETS - 1)]++;
+  h->total += ns;
+  h->max = MAX(h->max, ns);
+  h->samples++;
+}
+
+// Upper bound of the bucket holding the given percentile, in us.
+static int Percentile(const histogram_t *h, int percent)
+{
+  uint64_t rank = ((uint64_t) h->samples * percent + 99) / 100;
+  uint64_t sum = 0;
+  int i;
+
+  for (i = 0; i < NUMBUCKETS - 1; i++)
+    if ((sum += h->count[i]) >= rank)
+      break;
+
+  return i < NUMBUCKETS - 1 ? (i + 1) * BUCKET_NS / 1000 : (int) (h->max / 1000);
+}
+
+static void WriteHistogram(FILE *f, const histogram_t *h)
+{
+  int i;
+
+  fprintf(f, "# %s: %u samples, mean %.1f us, p50 %d us, p99 %d us, max %d us\n",
+          h->name, h->samples, h->samples ? h->total / 1000.0 / h->samples : 0.0,
+          Percentile(h, 50), Percentile(h, 99), (int) (h->max / 1000));
+
+  for (i = 0; i < NUMBUCKETS; i++)
+    if (h->count[i])
+      fprintf(f, "%s,%d,%u\n", h->name, i * BUCKET_NS / 1000, h->count[i]);
+}
+
+static void I_WriteFrameStats(void)
+{
+  FILE *f;
+
+  if (!(f = fopen(statsname, "w")))
+    return;
+
+  fprintf(f, "histogram,bucket_us,count\n");
+  WriteHistogram(f, &frametimes);
+  WriteHistogram(f, &wakeups);
+  fclose(f);
+
+  printf("I_WriteFrameStats: %u frames, p99 %d us, written to %s\n",
+         frametimes.samples, Percentile(&frametimes, 99), statsname);
+}
+
+void I_InitPacer(void)
+{
+  int p;
+
+  if ((p = M_CheckParm("-framestats")) && p < myargc-1)
+  {
+    framestats = true;
+    statsname = myargv[p+1];
+    I_AtExit(I_WriteFrameStats, true);
+  }
+}
+
+//
+// Sleeping
+//
+
+// How late SDL_Delay() wakes up, a running estimate.
+static int64_t sleep_slack = 1000000;
+
+void I_SleepUntilNS(uint64_t deadline)
+{
+  uint64_t now = I_GetTimeNS();
+
+  while (now + sleep_slack + 1000000 <= deadline)
+  {
+    const int ms = (deadline - now - sleep_slack) / 1000000;
+    const uint64_t start = now;
+    int64_t late;
+
+    SDL_Delay(ms);
+    now = I_GetTimeNS();
+
+    late = (int64_t) (now - start) - ms * 1000000ll;
+    sleep_slack += (BETWEEN(0, 4000000, late) - sleep_slack) / 8;
+  }
+
+  while (now < deadline)
+    now = I_GetTimeNS();
+
+  AddSample(&wakeups, now - deadline);
+}
+
+//
+// Frame pacing
+//
+
+void I_PaceFrame(void)
+{
+  static uint64_t deadline;
+  uint64_t period, now;
+
+  // Demos timed or fast-forwarded run as fast as they can.
+  if (!uncapped || fpslimit < TICRATE || timingdemo)
+  {
+    deadline = 0;
+    return;
+  }
+
+  period = 1000000000ull / fpslimit;
+  now = I_GetTimeNS();
+
+  // Start over after a hitch rather than catching up.
+  if (!deadline || now > deadline + period)
+    deadline = now;
+  else if (now < deadline)
+    I_SleepUntilNS(deadline);
+
+  deadline += period;
+}
+
+void I_FrameDone(void)
+{
+  static uint64_t last;
+  const uint64_t now = I_GetTimeNS();
+
+  if (last)
+    AddSample(&frametimes, now - last);
+
+  last = now;
+}
@@ -0,0 +1,37 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Frame pacing and frame time statistics.
+//
+
+#ifndef __I_PACER__
+#define __I_PACER__
+
+#include "doomtype.h"
+
+extern int fpslimit;    // config: frame rate limit when uncapped, 0 = none
+
+// Parse -framestats.
+void I_InitPacer(void);
+
+// Sleep until the I_GetTimeNS() clock reaches deadline.
+void I_SleepUntilNS(uint64_t deadline);
+
+// Called right before a frame is presented, holds it back to fpslimit.
+void I_PaceFrame(void);
+
+// Called right after a frame has been presented.
+void I_FrameDone(void);
+
+#endif
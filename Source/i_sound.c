@@ -33,21 +33,22 @@
 #include <math.h>
 
 #include "doomstat.h"
+#include "i_mixer.h"
 #include "i_sound.h"
+#include "i_system.h"
 #include "w_wad.h"
 #include "d_main.h"
 
 // haleyjd
-#define MAX_CHANNELS 32
+// Room for stopped sounds still fading out next to snd_channels playing ones.
+#define MAX_CHANNELS MIXER_VOICES
 
 #ifndef M_PI
-#define M_PI 3.14
+#define M_PI 3.14159265358979323846
 #endif
 
 // [FG] precache all sound effects
 boolean precache_sounds;
-// [FG] optional low-pass filter
-boolean lowpass_filter;
 // [FG] music backend
 midi_player_t midi_player;
 
@@ -71,350 +72,646 @@ typedef struct {
   // SFX id of the playing sound effect.
   // Used to catch duplicates (like chainsaw).
   sfxinfo_t *id;
-  // The channel data pointer.
-  unsigned char* data;
-  // [FG] let SDL_Mixer do the actual sound mixing
-  Mix_Chunk chunk;
+  // The channel data pointer, until the voice has fallen silent.
+  Sint16 *data;
+  Uint32 length;
+  // Stepping through data, 16.16 fixed point.
+  int step;
   // haleyjd 06/16/08: unique id number
   int idnum;
+  // pitch-shifted variant played on this channel, if any
+  struct pitchcache_s *pitched;
 } channel_info_t;
 
 channel_info_t channelinfo[MAX_CHANNELS];
 
-// Pitch to stepping lookup, unused.
+// Pitch to stepping lookup.
 int steptable[256];
 
 //
-// stopchan
+// SFX cache
 //
-// cph 
-// Stops a sound, unlocks the data 
+// All sound effects are decoded and resampled to the output rate on a
+// background thread, either all of them at startup (precache_sounds) or
+// each one on first use. Pitch-shifted variants are resampled on the
+// same thread into a small cache of buffers. Until a variant is ready,
+// the mixer steps through the unshifted sound at the requested pitch,
+// with linear interpolation. The game thread never resamples.
 //
-static void stopchan(int handle)
+
+enum { sfx_empty, sfx_queued, sfx_ready, sfx_failed };
+
+typedef struct
 {
-   int cnum;
+  SDL_atomic_t state;
+  byte *lump;           // cached lump, until released by the game thread
+  size_t lumplen;
+  Sint16 *source;       // decoded mono samples at the original rate
+  Uint32 sourcelen;
+  Uint32 samplerate;
+  Sint16 *data;         // mono samples at the output rate
+  Uint32 length;        // in samples, a guard sample of silence follows
+} sfxcache_t;
+
+#define PITCH_CACHE_SIZE 64
+
+typedef struct pitchcache_s
+{
+  SDL_atomic_t state;
+  int sfxnum;
+  int pitch;
+  Sint16 *data;
+  Uint32 length;
+  int users;            // channels playing this variant
+  unsigned int lastused;
+} pitchcache_t;
+
+static sfxcache_t *sfxcache;
+static int num_sfxcache;
+static pitchcache_t pitchcache[PITCH_CACHE_SIZE];
+static unsigned int pitchcache_time;
+
+// Job queue of the worker thread. Nonnegative jobs are sound numbers to
+// decode, negative ones are -1-i for pitch cache entry i. Each sound is
+// queued at most twice (in order and once more in front when it is
+// waited for), so the ring never overflows.
+
+static int *jobs;
+static int jobs_size, jobs_head, jobs_count;
+static boolean job_running;
+
+static SDL_Thread *sfx_thread;
+static SDL_mutex *sfx_mutex;
+static SDL_cond *sfx_wake, *sfx_done;
+static boolean sfx_quit;
+static boolean lumps_cached;  // game thread: lumps to be released
 
-#ifdef RANGECHECK
-   // haleyjd 02/18/05: bounds checking
-    if(handle < 0 || handle >= MAX_CHANNELS)
-       return;
-#endif
+//
+// Band-limited resampler
+//
+// Polyphase windowed sinc: the kernel is tabulated for RESAMPLE_PHASES
+// fractional positions and linearly interpolated between them. The
+// cutoff is just below the Nyquist frequency of the lower of both rates.
+//
 
-   if(channelinfo[handle].data)
+#define RESAMPLE_PHASES 256
+#define RESAMPLE_ZEROS 8      // zero crossings on either side
+#define RESAMPLE_BETA 8.0     // Kaiser window shape
+
+static double BesselI0(double x)
+{
+   double sum = 1.0, term = 1.0;
+   int k;
+
+   for (k = 1; k < 32; k++)
    {
-      Mix_HaltChannel(handle);
-      // [FG] immediately free samples not connected to a sound SFX
-      if (channelinfo[handle].id == NULL)
-      {
-         Z_Free(channelinfo[handle].data);
-      }
-      channelinfo[handle].data = NULL;
+      term *= (x / (2 * k)) * (x / (2 * k));
+      sum += term;
+   }
+
+   return sum;
+}
+
+static Sint16 *Resample(const Sint16 *src, Uint32 srclen, Uint32 inrate,
+                        Uint32 *length)
+{
+   const Uint32 outrate = snd_samplerate;
+   const double cutoff = 0.9 * (outrate < inrate ? (double) outrate / inrate : 1.0);
+   const int half = (int) ceil(RESAMPLE_ZEROS / cutoff);
+   const int taps = 2 * half;
+   Uint32 dstlen = (Uint32)(((ULong64)srclen * outrate) / inrate);
+   Uint64 pos = 0, step = ((Uint64)inrate << 32) / outrate;
+   float *table;
+   Sint16 *padded, *dest;
+   Uint32 i;
+   int p, k;
+
+   table = (malloc)((RESAMPLE_PHASES + 1) * taps * sizeof(*table));
+   padded = (calloc)(srclen + taps + 1, sizeof(*padded));
+   dest = (malloc)((dstlen + 1) * sizeof(*dest));
+
+   if (!table || !padded || !dest)
+      I_Error("Resample: out of memory");
+
+   // table[p][k] is the kernel at distance p/PHASES + half - 1 - k,
+   // normalized for unity gain at each phase
+   for (p = 0; p <= RESAMPLE_PHASES; p++)
+   {
+      float *row = table + p * taps;
+      double sum = 0;
 
-      if(channelinfo[handle].id)
+      for (k = 0; k < taps; k++)
       {
-         // haleyjd 06/03/06: see if we can free the sound
-         for(cnum = 0; cnum < MAX_CHANNELS; ++cnum)
-         {
-            if(cnum == handle)
-               continue;
-            if(channelinfo[cnum].id &&
-               channelinfo[cnum].id->data == channelinfo[handle].id->data)
-               return; // still being used by some channel
-         }
-         
-         // set sample to PU_CACHE level
-         if (!precache_sounds)
+         double t = (double) p / RESAMPLE_PHASES + half - 1 - k;
+         double x = t / half, h;
+
+         if (fabs(x) >= 1.0)
+            h = 0;
+         else
          {
-         Z_ChangeTag(channelinfo[handle].id->data, PU_CACHE);
+            h = cutoff;
+            if (t != 0)
+               h = sin(M_PI * cutoff * t) / (M_PI * t);
+            h *= BesselI0(RESAMPLE_BETA * sqrt(1 - x * x)) /
+                 BesselI0(RESAMPLE_BETA);
          }
+
+         row[k] = (float) h;
+         sum += h;
       }
+
+      for (k = 0; k < taps; k++)
+         row[k] = (float)(row[k] / sum);
    }
 
-   channelinfo[handle].id = NULL;
-}
+   // half - 1 samples of silence before, half after
+   memcpy(padded + half - 1, src, srclen * sizeof(*src));
 
-static int SOUNDHDRSIZE = 8;
+   for (i = 0; i < dstlen; i++, pos += step)
+   {
+      const Sint16 *in = padded + (pos >> 32);
+      const Uint32 frac = (Uint32) pos;
+      const float *t0 = table + (frac >> 24) * taps;
+      const float *t1 = t0 + taps;
+      const float f = (frac & 0xffffff) * (1.0f / 0x1000000);
+      float acc = 0;
+      int sample;
+
+      for (k = 0; k < taps; k++)
+         acc += in[k] * (t0[k] + f * (t1[k] - t0[k]));
+
+      sample = (int) lrintf(acc);
+      sample = BETWEEN(-32768, 32767, sample);
+      dest[i] = sample;
+   }
+
+   // guard sample for the interpolation of the mixer
+   dest[dstlen] = 0;
+
+   (free)(table);
+   (free)(padded);
+
+   *length = dstlen;
+   return dest;
+}
 
 //
-// addsfx
-//
-// This function adds a sound to the
-//  list of currently active sounds,
-//  which is maintained as a given number
-//  (eight, usually) of internal channels.
-// Returns a handle.
-//
-// haleyjd: needs to take a sfxinfo_t ptr, not a sound id num
-// haleyjd 06/03/06: changed to return boolean for failure or success
+// Decode a sound lump into mono 16-bit samples.
+// Runs on the worker thread.
 //
-static boolean addsfx(sfxinfo_t *sfx, int channel, int pitch)
+
+static boolean DecodeSfx(sfxcache_t *cache)
 {
-   size_t lumplen;
-   int lump;
-   // [FG] do not connect pitch-shifted samples to a sound SFX
-   unsigned int sfx_alen;
-   unsigned int bits;
-   void *sfx_data;
+   const byte *data = cache->lump;
+   const size_t lumplen = cache->lumplen;
+   Uint8 *wav_buffer = NULL;
+   Uint32 samplerate, samplelen, samplecount, i;
+   unsigned int bits, headersize;
+
+   // [crispy] Check if this is a valid RIFF wav file
+   if (lumplen > 44 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVEfmt ", 8) == 0)
+   {
+      SDL_RWops *RWops;
+      SDL_AudioSpec wav_spec;
 
-#ifdef RANGECHECK
-   if(channel < 0 || channel >= MAX_CHANNELS)
-      I_Error("addsfx: channel out of range!\n");
-#endif
+      RWops = SDL_RWFromConstMem(data, lumplen);
 
-   // haleyjd 02/18/05: null ptr check
-   if(!snd_init || !sfx)
+      if (SDL_LoadWAV_RW(RWops, 1, &wav_spec, &wav_buffer, &samplelen) == NULL)
+      {
+         fprintf(stderr, "Could not open wav file: %s\n", SDL_GetError());
+         return false;
+      }
+
+      bits = SDL_AUDIO_BITSIZE(wav_spec.format);
+
+      if (wav_spec.channels != 1 || !SDL_AUDIO_ISINT(wav_spec.format) ||
+          (bits != 8 && bits != 16))
+      {
+         SDL_FreeWAV(wav_buffer);
+         return false;
+      }
+
+      samplerate = wav_spec.freq;
+      data = wav_buffer;
+      headersize = 0;
+   }
+   // Check the header, and ensure this is a valid sound
+   else if (data[0] == 0x03 && data[1] == 0x00)
+   {
+      samplerate = (data[3] << 8) | data[2];
+      samplelen  = (data[7] << 24) | (data[6] << 16) | (data[5] << 8) | data[4];
+
+      // All Doom sounds are 8-bit
+      bits = 8;
+
+      headersize = 8;
+
+      // don't play sounds that think they're longer than they really are
+      if (samplelen > lumplen - headersize)
+         return false;
+   }
+   else
       return false;
 
-   stopchan(channel);
-   
-   // We will handle the new SFX.
-   // Set pointer to raw data.
+   samplecount = samplelen / (bits / 8);
 
-   // haleyjd: Eternity sfxinfo_t does not have a lumpnum field
-   lump = I_GetSfxLumpNum(sfx);
-   
-   // replace missing sounds with a reasonable default
-   if(lump == -1)
-      lump = W_GetNumForName("DSPISTOL");
-   
-   lumplen = W_LumpLength(lump);
-   
-   // haleyjd 10/08/04: do not play zero-length sound lumps
-   if(lumplen <= SOUNDHDRSIZE)
+   if (!samplerate || samplecount < 2)
+   {
+      if (wav_buffer)
+         SDL_FreeWAV(wav_buffer);
       return false;
+   }
 
-   // haleyjd 06/03/06: rewrote again to make sound data properly freeable
-   if(sfx->data == NULL || pitch != NORM_PITCH)
-   {   
-      byte *data;
-      Uint32 samplerate, samplelen, samplecount;
-      Uint8 *wav_buffer = NULL;
+   cache->source = (malloc)(samplecount * sizeof(*cache->source));
+   if (!cache->source)
+      I_Error("DecodeSfx: out of memory");
 
-      // haleyjd: this should always be called (if lump is already loaded,
-      // W_CacheLumpNum handles that for us).
-      data = (byte *)W_CacheLumpNum(lump, PU_STATIC);
+   data += headersize;
 
-      // [crispy] Check if this is a valid RIFF wav file
-      if (lumplen > 44 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVEfmt ", 8) == 0)
-      {
-        SDL_RWops *RWops;
-        SDL_AudioSpec wav_spec;
+   for (i = 0; i < samplecount; i++)
+   {
+      if (bits == 16)
+         cache->source[i] = (Sint16)(data[2*i] | (data[2*i+1] << 8));
+      else
+         // [FG] convert 8-bit unsigned to 16-bit signed
+         cache->source[i] = (data[i] << 8) - (1<<15);
+   }
 
-        RWops = SDL_RWFromMem(data, lumplen);
+   cache->sourcelen = samplecount;
+   cache->samplerate = samplerate;
 
-        Z_ChangeTag(data, PU_CACHE);
+   if (wav_buffer)
+      SDL_FreeWAV(wav_buffer);
 
-        if (SDL_LoadWAV_RW(RWops, 1, &wav_spec, &wav_buffer, &samplelen) == NULL)
-        {
-            fprintf(stderr, "Could not open wav file: %s\n", SDL_GetError());
-            return false;
-        }
-        else
-        {
-          if (wav_spec.channels != 1)
-          {
-            SDL_FreeWAV(wav_buffer);
-            return false;
-          }
-
-          if (SDL_AUDIO_ISINT(wav_spec.format))
-          {
-            bits = SDL_AUDIO_BITSIZE(wav_spec.format);
-            if (bits != 8 && bits != 16)
-            {
-              SDL_FreeWAV(wav_buffer);
-              return false;
-            }
-          }
-          else
-          {
-            SDL_FreeWAV(wav_buffer);
-            return false;
-          }
-
-          samplerate = wav_spec.freq;
-          data = wav_buffer;
-          SOUNDHDRSIZE = 0;
-        }
-      }
-      // Check the header, and ensure this is a valid sound
-      else if(data[0] == 0x03 && data[1] == 0x00)
-      {
-         samplerate = (data[3] << 8) | data[2];
-         samplelen  = (data[7] << 24) | (data[6] << 16) | (data[5] << 8) | data[4];
+   return true;
+}
+
+static void CacheSfxJob(sfxcache_t *cache)
+{
+   boolean ok;
 
-         // All Doom sounds are 8-bit
-         bits = 8;
+   if (SDL_AtomicGet(&cache->state) != sfx_queued)
+      return;   // done already, was queued twice
 
-         SOUNDHDRSIZE = 8;
-      }
+   ok = DecodeSfx(cache);
+
+   if (ok)
+      cache->data = Resample(cache->source, cache->sourcelen,
+                             cache->samplerate, &cache->length);
+
+   SDL_AtomicSet(&cache->state, ok ? sfx_ready : sfx_failed);
+}
+
+static void CachePitchJob(pitchcache_t *entry)
+{
+   const sfxcache_t *cache = &sfxcache[entry->sfxnum];
+
+   // [FG] spoof sound samplerate if using randomly pitched sounds
+   Uint32 samplerate = (Uint32)(((ULong64)cache->samplerate * steptable[entry->pitch]) >> 16);
+
+   entry->data = Resample(cache->source, cache->sourcelen, samplerate, &entry->length);
+
+   SDL_AtomicSet(&entry->state, sfx_ready);
+}
+
+static int SfxThread(void *unused)
+{
+   SDL_LockMutex(sfx_mutex);
+
+   for (;;)
+   {
+      int job;
+
+      while (!jobs_count && !sfx_quit)
+         SDL_CondWait(sfx_wake, sfx_mutex);
+
+      if (sfx_quit)
+         break;
+
+      job = jobs[jobs_head];
+      jobs_head = (jobs_head + 1) % jobs_size;
+      jobs_count--;
+      job_running = true;
+      SDL_UnlockMutex(sfx_mutex);
+
+      if (job >= 0)
+         CacheSfxJob(&sfxcache[job]);
       else
-      {
-         Z_ChangeTag(data, PU_CACHE);
-         return false;
-      }
+         CachePitchJob(&pitchcache[-1 - job]);
 
-      // don't play sounds that think they're longer than they really are
-      if(samplelen > lumplen - SOUNDHDRSIZE)
+      SDL_LockMutex(sfx_mutex);
+      job_running = false;
+      SDL_CondBroadcast(sfx_done);
+   }
+
+   SDL_UnlockMutex(sfx_mutex);
+   return 0;
+}
+
+// Called with sfx_mutex locked.
+static void PushJob(int job, boolean urgent)
+{
+   if (urgent)
+   {
+      jobs_head = (jobs_head + jobs_size - 1) % jobs_size;
+      jobs[jobs_head] = job;
+   }
+   else
+      jobs[(jobs_head + jobs_count) % jobs_size] = job;
+
+   jobs_count++;
+   SDL_CondSignal(sfx_wake);
+}
+
+// Queue a sound for decoding, unless it has been already.
+static void QueueSfx(int sfxnum, boolean urgent)
+{
+   sfxcache_t *cache = &sfxcache[sfxnum];
+   int lump;
+
+   if (SDL_AtomicGet(&cache->state) != sfx_empty)
+   {
+      if (urgent && SDL_AtomicGet(&cache->state) == sfx_queued)
       {
-         Z_ChangeTag(data, PU_CACHE);
-         return false;
+         SDL_LockMutex(sfx_mutex);
+         PushJob(sfxnum, true);
+         SDL_UnlockMutex(sfx_mutex);
       }
+      return;
+   }
+
+   // haleyjd: Eternity sfxinfo_t does not have a lumpnum field
+   lump = I_GetSfxLumpNum(&S_sfx[sfxnum]);
+
+   // replace missing sounds with a reasonable default
+   if (lump == -1)
+      lump = W_GetNumForName("DSPISTOL");
+
+   cache->lumplen = W_LumpLength(lump);
+
+   // haleyjd 10/08/04: do not play zero-length sound lumps
+   if (cache->lumplen <= 8)
+   {
+      SDL_AtomicSet(&cache->state, sfx_failed);
+      return;
+   }
+
+   // The zone is not thread-safe, so the lump is cached here and
+   // released again once the worker is idle
+   cache->lump = W_CacheLumpNum(lump, PU_STATIC);
+   lumps_cached = true;
+
+   SDL_LockMutex(sfx_mutex);
+   SDL_AtomicSet(&cache->state, sfx_queued);
+   PushJob(sfxnum, urgent);
+   SDL_UnlockMutex(sfx_mutex);
+}
+
+// Return the cached sound, waiting for the worker if necessary.
+static sfxcache_t *GetSfx(sfxinfo_t *sfx)
+{
+   int sfxnum = sfx - S_sfx;
+   sfxcache_t *cache;
+
+   if (sfxnum < 0 || sfxnum >= num_sfxcache)
+      return NULL;
+
+   cache = &sfxcache[sfxnum];
+
+   if (SDL_AtomicGet(&cache->state) < sfx_ready)
+   {
+      QueueSfx(sfxnum, true);
 
-      samplecount = samplelen / (bits / 8);
+      SDL_LockMutex(sfx_mutex);
+      while (SDL_AtomicGet(&cache->state) == sfx_queued)
+         SDL_CondWait(sfx_done, sfx_mutex);
+      SDL_UnlockMutex(sfx_mutex);
+   }
+
+   return SDL_AtomicGet(&cache->state) == sfx_ready ? cache : NULL;
+}
+
+// Return the variant at the requested pitch if it is ready. Queue it
+// for resampling if it is not cached yet.
+static pitchcache_t *GetPitched(int sfxnum, int pitch)
+{
+   pitchcache_t *victim = NULL;
+   int i;
+
+   for (i = 0; i < PITCH_CACHE_SIZE; i++)
+   {
+      pitchcache_t *entry = &pitchcache[i];
+      int state = SDL_AtomicGet(&entry->state);
 
-      // [FG] do not connect pitch-shifted samples to a sound SFX
-      if (pitch == NORM_PITCH)
+      if (state != sfx_empty && entry->sfxnum == sfxnum &&
+          entry->pitch == pitch)
       {
-         sfx_alen = (Uint32)(((ULong64)samplecount * snd_samplerate) / samplerate);
-         // [FG] double up twice: 8 -> 16 bit and mono -> stereo
-         sfx->alen = 4 * sfx_alen;
-         sfx->data = precache_sounds ? (malloc)(sfx->alen) : Z_Malloc(sfx->alen, PU_STATIC, &sfx->data);
-         sfx_data = sfx->data;
+         entry->lastused = ++pitchcache_time;
+         return state == sfx_ready ? entry : NULL;
       }
-      else
+
+      // least recently used entry which is neither queued nor playing
+      if (state != sfx_queued && !entry->users &&
+          (!victim || entry->lastused < victim->lastused))
+         victim = entry;
+   }
+
+   if (victim)
+   {
+      (free)(victim->data);
+      victim->data = NULL;
+      victim->sfxnum = sfxnum;
+      victim->pitch = pitch;
+      victim->lastused = ++pitchcache_time;
+
+      SDL_LockMutex(sfx_mutex);
+      SDL_AtomicSet(&victim->state, sfx_queued);
+      PushJob(-1 - (victim - pitchcache), false);
+      SDL_UnlockMutex(sfx_mutex);
+   }
+
+   return NULL;
+}
+
+// Release the lumps of decoded sounds while the worker is idle.
+static void ReleaseSfxLumps(void)
+{
+   boolean idle;
+   int i;
+
+   SDL_LockMutex(sfx_mutex);
+   idle = !jobs_count && !job_running;
+   SDL_UnlockMutex(sfx_mutex);
+
+   if (!idle)
+      return;
+
+   for (i = 0; i < num_sfxcache; i++)
+   {
+      if (sfxcache[i].lump)
       {
-         // [FG] spoof sound samplerate if using randomly pitched sounds
-         samplerate = (Uint32)(((ULong64)samplerate * steptable[pitch]) >> 16);
-         sfx_alen = (Uint32)(((ULong64)samplecount * snd_samplerate) / samplerate);
-         // [FG] double up twice: 8 -> 16 bit and mono -> stereo
-         channelinfo[channel].data = Z_Malloc(4 * sfx_alen, PU_STATIC, (void **)&channelinfo[channel].data);
-         sfx_data = channelinfo[channel].data;
+         Z_ChangeTag(sfxcache[i].lump, PU_CACHE);
+         sfxcache[i].lump = NULL;
       }
+   }
 
-      // haleyjd 04/23/08: Convert sound to target samplerate
-      {  
-         unsigned int i;
-         Sint16 sample = 0;
-         Sint16 *dest = (Sint16 *)sfx_data;
-         byte *src  = data + SOUNDHDRSIZE;
-         
-         unsigned int step = (samplerate << 16) / snd_samplerate;
-         unsigned int stepremainder = 0, j = 0;
-
-         // do linear filtering operation
-         for(i = 0; i < sfx_alen && j < samplelen - 1; ++i)
-         {
-            int d;
+   lumps_cached = false;
+}
 
-            if (bits == 16)
-            {
-               d = ((Sint16)(src[j  ] | (src[j+1] << 8)) * (0x10000 - stepremainder) +
-                    (Sint16)(src[j+2] | (src[j+3] << 8)) * stepremainder) >> 16;
+static void I_ShutdownSfxCache(void)
+{
+   SDL_LockMutex(sfx_mutex);
+   sfx_quit = true;
+   SDL_CondSignal(sfx_wake);
+   SDL_UnlockMutex(sfx_mutex);
 
-               sample = d;
-            }
-            else
-            {
-               d = (((unsigned int)src[j  ] * (0x10000 - stepremainder)) +
-                    ((unsigned int)src[j+1] * stepremainder)) >> 8;
+   SDL_WaitThread(sfx_thread, NULL);
+   sfx_thread = NULL;
+}
 
-               // [FG] interpolate sfx in a 16-bit int domain, convert to signed
-               sample = d - (1<<15);
-            }
+static void I_InitSfxCache(void)
+{
+   int i;
 
-            dest[2*i] = dest[2*i+1] = sample;
+   num_sfxcache = num_sfx;
+   sfxcache = (calloc)(num_sfxcache, sizeof(*sfxcache));
+   jobs_size = 2 * num_sfxcache + PITCH_CACHE_SIZE;
+   jobs = (malloc)(jobs_size * sizeof(*jobs));
 
-            stepremainder += step;
-            if (bits == 16)
-               j += (stepremainder >> 16) * 2;
-            else
-               j += (stepremainder >> 16);
+   if (!sfxcache || !jobs)
+      I_Error("I_InitSfxCache: out of memory");
 
-            stepremainder &= 0xffff;
-         }
-         // fill remainder (if any) with final sample byte
-         for(; i < sfx_alen; ++i)
-            dest[2*i] = dest[2*i+1] = sample;
+   for (i = 0; i < PITCH_CACHE_SIZE; i++)
+      pitchcache[i].sfxnum = -1;
 
-        // Perform a low-pass filter on the upscaled sound to filter
-        // out high-frequency noise from the conversion process.
+   sfx_mutex = SDL_CreateMutex();
+   sfx_wake = SDL_CreateCond();
+   sfx_done = SDL_CreateCond();
+   sfx_thread = SDL_CreateThread(SfxThread, "sfxcache", NULL);
 
-        if (lowpass_filter)
-        {
-            float rc, dt, alpha;
+   if (!sfx_mutex || !sfx_wake || !sfx_done || !sfx_thread)
+      I_Error("I_InitSfxCache: %s", SDL_GetError());
 
-            // Low-pass filter for cutoff frequency f:
-            //
-            // For sampling rate r, dt = 1 / r
-            // rc = 1 / 2*pi*f
-            // alpha = dt / (rc + dt)
+   I_AtExit(I_ShutdownSfxCache, true);
 
-            // Filter to the half sample rate of the original sound effect
-            // (maximum frequency, by nyquist)
+   // [FG] precache all sound effects
+   if (precache_sounds)
+   {
+      printf("Precaching all sound effects in the background.\n");
+      for (i = 1; i < num_sfx; i++)
+      {
+         // DEHEXTRA has turned S_sfx into a sparse array
+         if (!S_sfx[i].name)
+           continue;
 
-            dt = 1.0f / snd_samplerate;
-            rc = 1.0f / (M_PI * samplerate);
-            alpha = dt / (rc + dt);
+         QueueSfx(i, false);
+      }
+   }
+}
 
-            // Both channels are processed in parallel, hence [i-2]:
+//
+// stopchan
+//
+// cph 
+// Stops a sound. It fades out and the channel is released by
+// I_UpdateSound() once it has fallen silent.
+//
+static void stopchan(int handle)
+{
+#ifdef RANGECHECK
+   // haleyjd 02/18/05: bounds checking
+    if(handle < 0 || handle >= MAX_CHANNELS)
+       return;
+#endif
 
-            for (i = 2; i < sfx_alen * 2; ++i)
-            {
-                dest[i] = (Sint16) (alpha * dest[i]
-                                      + (1.0f - alpha) * dest[i-2]);
-            }
-        }
-      }
-      // [FG] double up twice: 8 -> 16 bit and mono -> stereo
-      sfx_alen *= 4;
+   if(channelinfo[handle].data)
+      I_MixerStop(handle);
 
-      if (wav_buffer)
-        SDL_FreeWAV(wav_buffer);
-      else
-      // haleyjd 06/03/06: don't need original lump data any more
-      Z_ChangeTag(data, PU_CACHE);
-   }
-   else
-   if (!precache_sounds)
-      Z_ChangeTag(sfx->data, PU_STATIC); // reset to static cache level
+   channelinfo[handle].id = NULL;
+}
 
-   // [FG] let SDL_Mixer do the actual sound mixing
-   channelinfo[channel].chunk.allocated = 1;
-   channelinfo[channel].chunk.volume = MIX_MAX_VOLUME;
+//
+// releasechan
+//
+// Releases a silent channel and its pitch-shifted variant.
+//
+static void releasechan(int handle)
+{
+   channelinfo[handle].data = NULL;
+   channelinfo[handle].id = NULL;
 
-   // [FG] do not connect pitch-shifted samples to a sound SFX
-   if (pitch == NORM_PITCH)
+   if (channelinfo[handle].pitched)
    {
-      channelinfo[channel].data = sfx->data;
+      channelinfo[handle].pitched->users--;
+      channelinfo[handle].pitched = NULL;
+   }
+}
 
-      channelinfo[channel].chunk.abuf = sfx->data;
-      channelinfo[channel].chunk.alen = sfx->alen;
+//
+// addsfx
+//
+// This function adds a sound to the
+//  list of currently active sounds,
+//  which is maintained as a given number
+//  (eight, usually) of internal channels.
+// Returns a handle.
+//
+// haleyjd: needs to take a sfxinfo_t ptr, not a sound id num
+// haleyjd 06/03/06: changed to return boolean for failure or success
+//
+static boolean addsfx(sfxinfo_t *sfx, int channel, int pitch)
+{
+   sfxcache_t *cache;
+   pitchcache_t *pitched = NULL;
 
-      // Preserve sound SFX id
-      channelinfo[channel].id = sfx;
+#ifdef RANGECHECK
+   if(channel < 0 || channel >= MAX_CHANNELS)
+      I_Error("addsfx: channel out of range!\n");
+#endif
+
+   // haleyjd 02/18/05: null ptr check
+   if(!snd_init || !sfx || !sfxcache)
+      return false;
+
+   stopchan(channel);
+
+   if (!(cache = GetSfx(sfx)))
+      return false;
+
+   if (pitch != NORM_PITCH)
+      pitched = GetPitched(sfx - S_sfx, pitch);
+
+   if (pitched)
+   {
+      pitched->users++;
+      channelinfo[channel].data = pitched->data;
+      channelinfo[channel].length = pitched->length;
+      channelinfo[channel].step = steptable[NORM_PITCH];
    }
    else
    {
-      channelinfo[channel].chunk.abuf = sfx_data;
-      channelinfo[channel].chunk.alen = sfx_alen;
-
-      channelinfo[channel].id = NULL;
+      channelinfo[channel].data = cache->data;
+      channelinfo[channel].length = cache->length;
+      channelinfo[channel].step = steptable[pitch];
    }
 
+   channelinfo[channel].pitched = pitched;
+   channelinfo[channel].id = sfx;
+
    return true;
 }
 
 int forceFlipPan;
 
 //
-// updateSoundParams
+// stereoVolumes
 //
-// Changes sound parameters in response to stereo panning and relative location
-// change.
+// Splits the volume of a sound between the left and right speaker.
 //
-static void updateSoundParams(int handle, int volume, int separation, int pitch)
+static void stereoVolumes(int volume, int separation, int *left, int *right)
 {
    int rightvol;
    int leftvol;
-   
-   if(!snd_init)
-      return;
-
-#ifdef RANGECHECK
-   if(handle < 0 || handle >= MAX_CHANNELS)
-      I_Error("I_UpdateSoundParams: handle out of range");
-#endif
 
    // SoM 7/1/02: forceFlipPan accounted for here
    if(forceFlipPan)
@@ -429,7 +726,31 @@ static void updateSoundParams(int handle, int volume, int separation, int pitch)
    if (rightvol < 0) rightvol = 0;
    else if (rightvol > 255) rightvol = 255;
 
-   Mix_SetPanning(handle, leftvol, rightvol);
+   *left = leftvol;
+   *right = rightvol;
+}
+
+//
+// updateSoundParams
+//
+// Changes sound parameters in response to stereo panning and relative location
+// change.
+//
+static void updateSoundParams(int handle, int volume, int separation, int pitch)
+{
+   int rightvol;
+   int leftvol;
+   
+   if(!snd_init)
+      return;
+
+#ifdef RANGECHECK
+   if(handle < 0 || handle >= MAX_CHANNELS)
+      I_Error("I_UpdateSoundParams: handle out of range");
+#endif
+
+   stereoVolumes(volume, separation, &leftvol, &rightvol);
+   I_MixerSetParams(handle, leftvol, rightvol);
 }
 
 //
@@ -550,9 +871,13 @@ int I_StartSound(sfxinfo_t *sound, int cnum, int vol, int sep, int pitch, int pr
 
    if(addsfx(sound, handle, pitch))
    {
+      int leftvol, rightvol;
+
       channelinfo[handle].idnum = id++; // give the sound a unique id
-      Mix_PlayChannel(handle, &channelinfo[handle].chunk, 0);
-      updateSoundParams(handle, vol, sep, pitch);
+      stereoVolumes(vol, sep, &leftvol, &rightvol);
+      I_MixerStart(handle, channelinfo[handle].data,
+                   channelinfo[handle].length, channelinfo[handle].step,
+                   leftvol, rightvol);
    }
    else
       handle = -1;
@@ -594,7 +919,7 @@ int I_SoundIsPlaying(int handle)
       I_Error("I_SoundIsPlaying: handle out of range");
 #endif
  
-   return Mix_Playing(handle);
+   return I_MixerPlaying(handle);
 }
 
 //
@@ -634,16 +959,19 @@ void I_UpdateSound(void)
 {
     int i;
 
+    if (lumps_cached)
+        ReleaseSfxLumps();
+
     // Check all channels to see if a sound has finished
 
     for (i=0; i<MAX_CHANNELS; ++i)
     {
         if (channelinfo[i].data && !I_SoundIsPlaying(i))
         {
-            // Sound has finished playing on this channel,
+            // Sound has finished playing or fading out on this channel,
             // but sound data has not been released to cache
 
-            stopchan(i);
+            releasechan(i);
         }
     }
 }
@@ -669,6 +997,7 @@ void I_ShutdownSound(void)
 {
    if(snd_init)
    {
+      I_ShutdownMixer();
       Mix_CloseAudio();
       snd_init = 0;
    }
@@ -733,31 +1062,17 @@ void I_InitSound(void)
       // [FG] feed actual sample frequency back into config variable
       Mix_QuerySpec(&snd_samplerate, NULL, NULL);
 
-      // [FG] let SDL_Mixer do the actual sound mixing
-      Mix_AllocateChannels(MAX_CHANNELS);
-      printf("Configured audio device with %d samples/slice.\n", audio_buffers);
+      // Sound effects are mixed by i_mixer.c, SDL_Mixer only plays music
+      Mix_AllocateChannels(0);
+      printf("Configured audio device with %d samples/slice, %s mixer.\n",
+             audio_buffers, I_InitMixer());
 
       I_AtExit(I_ShutdownSound, true);
 
       snd_init = true;
 
-      // [FG] precache all sound effects
-      if (!nosfxparm && precache_sounds)
-      {
-         int i;
-
-         printf("Precaching all sound effects...");
-         for (i = 1; i < num_sfx; i++)
-         {
-            // DEHEXTRA has turned S_sfx into a sparse array
-            if (!S_sfx[i].name)
-              continue;
-
-            addsfx(&S_sfx[i], 0, NORM_PITCH);
-         }
-         stopchan(0);
-         printf("done.\n");
-      }
+      if (!nosfxparm)
+         I_InitSfxCache();
 
       // haleyjd 04/11/03: don't use music if sfx aren't init'd
       // (may be dependent, docs are unclear)
@@ -46,8 +46,6 @@ extern int snd_samplerate;
 
 // [FG] precache all sound SFX
 extern boolean precache_sounds;
-// [FG] optional low-pass filter
-extern boolean lowpass_filter;
 
 // Init at program start...
 void I_InitSound(void);
@@ -121,6 +119,8 @@ typedef enum
 
 extern midi_player_t midi_player;
 
+extern int num_opl_chips;
+
 boolean I_InitMusic(void);
 void I_ShutdownMusic(void);
 
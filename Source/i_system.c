@@ -47,6 +47,7 @@
 #include "v_video.h"
 #include "m_argv.h"
 #include "i_endoom.h"
+#include "i_pacer.h"
 
 ticcmd_t *I_BaseTiccmd(void)
 {
@@ -67,13 +68,39 @@ void I_Sleep(int ms)
     SDL_Delay(ms);
 }
 
+// Monotonic high resolution clock, in nanoseconds. All the game clocks
+// below are derived from it, SDL_GetTicks() only counts milliseconds.
+
+#define NSPERSEC 1000000000ull
+
+uint64_t I_GetTimeNS(void)
+{
+  static uint64_t freq;
+  uint64_t counter;
+
+  if (!freq)
+    freq = SDL_GetPerformanceFrequency();
+
+  counter = SDL_GetPerformanceCounter();
+
+  // split up to avoid overflow
+  return counter / freq * NSPERSEC + counter % freq * NSPERSEC / freq;
+}
+
+// High resolution timer for profiling, in microseconds
+
+uint64_t I_GetTimeUS(void)
+{
+  return I_GetTimeNS() / 1000;
+}
+
 // Same as I_GetTime, but returns time in milliseconds
 
-static Uint32 basetime = 0;
+static uint64_t basetime = 0;
 
 int I_GetTimeMS(void)
 {
-  return SDL_GetTicks() - basetime;
+  return (I_GetTimeNS() - basetime) / 1000000;
 }
 
 // Most of the following has been rewritten by Lee Killough
@@ -83,7 +110,7 @@ int I_GetTimeMS(void)
 
 int I_GetTime_RealTime(void)
 {
-  return (int64_t)I_GetTimeMS() * TICRATE / 1000;
+  return (I_GetTimeNS() - basetime) * TICRATE / NSPERSEC;
 }
 
 // killough 4/13/98: Make clock rate adjustable by scale factor
@@ -92,7 +119,7 @@ int clock_rate;
 
 static int I_GetTime_Scaled(void)
 {
-  return (int64_t)I_GetTimeMS() * clock_rate * TICRATE / 100000;
+  return (I_GetTimeNS() - basetime) * clock_rate * TICRATE / (100 * NSPERSEC);
 }
 
 static int I_GetTime_FastDemo(void)
@@ -117,16 +144,38 @@ static int I_GetFracTimeFastDemo(void)
 
 static int I_GetFracRealTime(void)
 {
-  return (int64_t)I_GetTimeMS() * TICRATE % 1000 * FRACUNIT / 1000;
+  return (I_GetTimeNS() - basetime) * TICRATE % NSPERSEC * FRACUNIT / NSPERSEC;
 }
 
 static int I_GetFracScaledTime(void)
 {
-  return (int64_t)I_GetTimeMS() * clock_rate * TICRATE / 100 % 1000 * FRACUNIT / 1000;
+  return (I_GetTimeNS() - basetime) * clock_rate * TICRATE / 100 % NSPERSEC *
+         FRACUNIT / NSPERSEC;
 }
 
 int (*I_GetFracTime)(void) = I_GetFracRealTime;
 
+// When I_GetTime() is going to return the next tic, on the I_GetTimeNS()
+// clock. Right away if tics do not depend on the clock.
+
+uint64_t I_GetNextTicNS(void)
+{
+  const uint64_t now = I_GetTimeNS();
+  uint64_t rate, tic;
+
+  if (I_GetTime == I_GetTime_Scaled)
+    rate = clock_rate;
+  else if (I_GetTime == I_GetTime_RealTime)
+    rate = 100;
+  else
+    return now;
+
+  tic = (now - basetime) * rate * TICRATE / (100 * NSPERSEC) + 1;
+
+  // round up, the tic must have begun by then
+  return basetime + (tic * 100 * NSPERSEC + rate * TICRATE - 1) / (rate * TICRATE);
+}
+
 int leds_always_off;         // Tells it not to update LEDs
 
 // pointer to current joystick device information
@@ -232,7 +281,7 @@ void I_Init(void)
       clock_rate = p;
    
    // init timer
-   basetime = SDL_GetTicks();
+   basetime = I_GetTimeNS();
 
    // killough 4/14/98: Adjustable speedup based on realtic_clock_rate
    if(fastdemo)
@@ -252,6 +301,8 @@ void I_Init(void)
          I_GetFracTime = I_GetFracRealTime;
       }
 
+   I_InitPacer();
+
    I_InitJoystick();
 
   // killough 3/6/98: save keyboard state, initialize shift state and LEDs:
@@ -51,6 +51,12 @@ extern int (*I_GetFracTime)(void);
 
 // [FG] Same as I_GetTime, but returns time in milliseconds
 int I_GetTimeMS();
+// High resolution timer, in microseconds
+uint64_t I_GetTimeUS(void);
+// Monotonic clock, in nanoseconds
+uint64_t I_GetTimeNS(void);
+// Time at which I_GetTime() advances to the next tic
+uint64_t I_GetNextTicNS(void);
 // [FG] toggle demo warp mode
 extern void I_EnableWarp (boolean warp);
 
@@ -0,0 +1,195 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Worker thread pool and locking primitives.
+//
+
+#include "SDL.h"
+
+#include "i_system.h"
+#include "i_thread.h"
+
+// The pool only ever grows. Workers sleep on pool_wake between jobs and
+// pick up indices of the current job from job_next until it runs dry.
+
+static SDL_mutex *pool_mutex;
+static SDL_cond *pool_wake, *pool_done;
+static int num_workers;
+static int generation;
+static int job_active;    // workers which have not finished the current job
+
+static parallel_func_t job_func;
+static void *job_data;
+static int job_count;
+static SDL_atomic_t job_next;
+static SDL_atomic_t pool_busy;
+
+static THREAD_LOCAL boolean in_job;
+
+int I_GetNumCPUs(void)
+{
+  int cpus = SDL_GetCPUCount();
+  return BETWEEN(1, MAX_THREADS, cpus);
+}
+
+boolean I_InParallel(void)
+{
+  return in_job;
+}
+
+static void RunJobs(void)
+{
+  int i;
+
+  in_job = true;
+  while ((i = SDL_AtomicAdd(&job_next, 1)) < job_count)
+    job_func(job_data, i);
+  in_job = false;
+}
+
+// A worker starts out having seen the generation of the time it was
+// created, which is never that of the job it was created for.
+
+static int WorkerThread(void *data)
+{
+  int seen = (int) (intptr_t) data;
+
+  SDL_LockMutex(pool_mutex);
+  for (;;)
+  {
+    while (generation == seen)
+      SDL_CondWait(pool_wake, pool_mutex);
+    seen = generation;
+    SDL_UnlockMutex(pool_mutex);
+
+    RunJobs();
+
+    SDL_LockMutex(pool_mutex);
+    if (--job_active == 0)
+      SDL_CondSignal(pool_done);
+  }
+  return 0;
+}
+
+static void GrowPool(int count)
+{
+  if (!pool_mutex)
+  {
+    pool_mutex = SDL_CreateMutex();
+    pool_wake = SDL_CreateCond();
+    pool_done = SDL_CreateCond();
+    if (!pool_mutex || !pool_wake || !pool_done)
+      I_Error("GrowPool: %s", SDL_GetError());
+  }
+
+  while (num_workers < count && num_workers < MAX_THREADS - 1)
+  {
+    SDL_Thread *thread = SDL_CreateThread(WorkerThread, "worker",
+                                          (void *) (intptr_t) generation);
+
+    if (!thread)
+      break;      // run with what we have
+
+    SDL_DetachThread(thread);
+    num_workers++;
+  }
+}
+
+void I_RunParallel(parallel_func_t func, void *data, int count)
+{
+  int i;
+
+  if (count <= 0)
+    return;
+
+  // Only one job may own the pool; anybody else runs serially.
+  if (count == 1 || in_job || !SDL_AtomicCAS(&pool_busy, 0, 1))
+  {
+    for (i = 0; i < count; i++)
+      func(data, i);
+    return;
+  }
+
+  GrowPool(count - 1);
+
+  if (!num_workers)
+  {
+    for (i = 0; i < count; i++)
+      func(data, i);
+    SDL_AtomicSet(&pool_busy, 0);
+    return;
+  }
+
+  SDL_LockMutex(pool_mutex);
+  job_func = func;
+  job_data = data;
+  job_count = count;
+  SDL_AtomicSet(&job_next, 0);
+  job_active = num_workers;
+  generation++;
+  SDL_CondBroadcast(pool_wake);
+  SDL_UnlockMutex(pool_mutex);
+
+  RunJobs();
+
+  SDL_LockMutex(pool_mutex);
+  while (job_active)
+    SDL_CondWait(pool_done, pool_mutex);
+  SDL_UnlockMutex(pool_mutex);
+
+  SDL_AtomicSet(&pool_busy, 0);
+}
+
+i_thread_t *I_CreateThread(thread_func_t func, const char *name, void *data)
+{
+  return (i_thread_t *) SDL_CreateThread(func, name, data);
+}
+
+int I_WaitThread(i_thread_t *thread)
+{
+  int status = 0;
+
+  SDL_WaitThread((SDL_Thread *) thread, &status);
+  return status;
+}
+
+i_mutex_t *I_CreateMutex(void)
+{
+  SDL_mutex *mutex = SDL_CreateMutex();
+
+  if (!mutex)
+    I_Error("I_CreateMutex: %s", SDL_GetError());
+
+  return (i_mutex_t *) mutex;
+}
+
+void I_LockMutex(i_mutex_t *mutex)
+{
+  SDL_LockMutex((SDL_mutex *) mutex);
+}
+
+void I_UnlockMutex(i_mutex_t *mutex)
+{
+  SDL_UnlockMutex((SDL_mutex *) mutex);
+}
+
+void I_ReleaseBarrier(void)
+{
+  SDL_MemoryBarrierRelease();
+}
+
+void I_AcquireBarrier(void)
+{
+  SDL_MemoryBarrierAcquire();
+}
@@ -0,0 +1,57 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Worker thread pool and locking primitives.
+//
+
+#ifndef __I_THREAD__
+#define __I_THREAD__
+
+#include "doomtype.h"
+
+#define MAX_THREADS 16
+
+typedef struct i_mutex_s i_mutex_t;
+
+typedef struct i_thread_s i_thread_t;
+
+typedef void (*parallel_func_t)(void *data, int index);
+typedef int (*thread_func_t)(void *data);
+
+// Number of logical CPUs available, at least 1.
+int I_GetNumCPUs(void);
+
+// Calls func(data, i) for every 0 <= i < count, spread across the worker
+// pool; the calling thread takes part and returns once all calls are done.
+// Nested calls from inside a job are run serially on the calling thread.
+void I_RunParallel(parallel_func_t func, void *data, int count);
+
+// True while the calling thread is executing a job of I_RunParallel().
+boolean I_InParallel(void);
+
+// Runs func(data) on a thread of its own. Returns NULL on failure.
+i_thread_t *I_CreateThread(thread_func_t func, const char *name, void *data);
+// Waits for the thread to finish and returns the result of its function.
+int I_WaitThread(i_thread_t *thread);
+
+i_mutex_t *I_CreateMutex(void);
+void I_LockMutex(i_mutex_t *mutex);
+void I_UnlockMutex(i_mutex_t *mutex);
+
+// Make all preceding stores visible before any following store.
+void I_ReleaseBarrier(void);
+// Make all following loads observe stores published by I_ReleaseBarrier().
+void I_AcquireBarrier(void);
+
+#endif
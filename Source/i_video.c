@@ -45,6 +45,7 @@
 #include "wi_stuff.h"
 #include "i_video.h"
 #include "m_misc2.h"
+#include "i_pacer.h"
 
 // [FG] set the application icon
 
@@ -60,14 +61,23 @@ int WIDESCREENDELTA; // [crispy] horizontal widescreen offset
 
 static SDL_Surface *sdlscreen;
 
-// [FG] rendering window, renderer, intermediate ARGB frame buffer and texture
+// [FG] rendering window, renderer and texture
 
 static SDL_Window *screen;
 static SDL_Renderer *renderer;
-static SDL_Surface *argbbuffer;
 static SDL_Texture *texture;
 static SDL_Rect blit_rect = {0};
 
+// The paletted screen is expanded by a lookup table straight into the
+// locked streaming texture. Only the band of rows which differs from the
+// previous frame is converted and uploaded, which in menus and on
+// intermission screens is usually a small part of the screen.
+
+static SDL_PixelFormat *texture_format;
+static uint32_t palette_lut[256];
+static byte *last_frame;            // paletted copy of the uploaded frame
+static boolean full_update;         // upload everything on the next frame
+
 int window_width, window_height;
 static int window_x, window_y;
 char *window_position;
@@ -894,6 +904,129 @@ int integer_scaling; // [FG] force integer scales
 int fps; // [FG] FPS counter widget
 int widescreen; // widescreen mode
 
+//
+// Palette conversion
+//
+
+typedef void (*convertline_t)(const byte *src, uint32_t *dst, int width);
+
+static void ConvertLine_Scalar(const byte *src, uint32_t *dst, int width)
+{
+   const uint32_t *const lut = palette_lut;
+   int x = 0;
+
+   for (; x <= width - 4; x += 4)
+   {
+      dst[x    ] = lut[src[x    ]];
+      dst[x + 1] = lut[src[x + 1]];
+      dst[x + 2] = lut[src[x + 2]];
+      dst[x + 3] = lut[src[x + 3]];
+   }
+   for (; x < width; x++)
+      dst[x] = lut[src[x]];
+}
+
+// SSE2 has no gather, so for x86 only an AVX2 kernel is worth having.
+// It is compiled for AVX2 regardless of the build flags and selected at
+// runtime if the CPU supports it.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+#define HAVE_AVX2_CONVERT
+
+__attribute__((target("avx2")))
+static void ConvertLine_AVX2(const byte *src, uint32_t *dst, int width)
+{
+   const int *const lut = (const int *) palette_lut;
+   int x = 0;
+
+   for (; x <= width - 16; x += 16)
+   {
+      __m128i idx = _mm_loadu_si128((const __m128i *)(src + x));
+      __m256i lo = _mm256_cvtepu8_epi32(idx);
+      __m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(idx, 8));
+
+      _mm256_storeu_si256((__m256i *)(dst + x),
+                          _mm256_i32gather_epi32(lut, lo, 4));
+      _mm256_storeu_si256((__m256i *)(dst + x + 8),
+                          _mm256_i32gather_epi32(lut, hi, 4));
+   }
+
+   ConvertLine_Scalar(src + x, dst + x, width - x);
+}
+#endif
+
+static convertline_t ConvertLine = ConvertLine_Scalar;
+
+static void I_InitConvertLine(void)
+{
+#ifdef HAVE_AVX2_CONVERT
+   if (!M_CheckParm("-nosimd") && __builtin_cpu_supports("avx2"))
+      ConvertLine = ConvertLine_AVX2;
+#endif
+}
+
+// Find the band of rows which changed since the last frame.
+// Returns false if the frame is unchanged.
+
+static boolean I_GetDirtyRows(const byte *src, int *y1, int *y2)
+{
+   const int w = blit_rect.w, h = blit_rect.h;
+   int top = 0, bottom = h - 1;
+
+   if (full_update)
+   {
+      *y1 = 0;
+      *y2 = h - 1;
+      return true;
+   }
+
+   while (top < h && !memcmp(src + top * w, last_frame + top * w, w))
+      top++;
+
+   if (top == h)
+      return false;
+
+   while (bottom > top && !memcmp(src + bottom * w, last_frame + bottom * w, w))
+      bottom--;
+
+   *y1 = top;
+   *y2 = bottom;
+   return true;
+}
+
+static void I_UpdateTexture(void)
+{
+   const byte *src = sdlscreen->pixels;
+   const int w = blit_rect.w;
+   SDL_Rect rect;
+   void *pixels;
+   int pitch, y1, y2, y;
+
+   if (!I_GetDirtyRows(src, &y1, &y2))
+      return;
+
+   rect.x = 0;
+   rect.y = y1;
+   rect.w = w;
+   rect.h = y2 - y1 + 1;
+
+   if (SDL_LockTexture(texture, &rect, &pixels, &pitch) < 0)
+      return;
+
+   for (y = y1; y <= y2; y++)
+   {
+      ConvertLine(src + y * w, pixels, w);
+      pixels = (byte *) pixels + pitch;
+   }
+
+   SDL_UnlockTexture(texture);
+
+   memcpy(last_frame + y1 * w, src + y1 * w, rect.h * w);
+   full_update = false;
+}
+
 void I_FinishUpdate(void)
 {
    if (noblit || !in_graphics_mode)
@@ -960,13 +1093,14 @@ void I_FinishUpdate(void)
 
    I_DrawDiskIcon();
 
-   SDL_LowerBlit(sdlscreen, &blit_rect, argbbuffer, &blit_rect);
-
-   SDL_UpdateTexture(texture, NULL, argbbuffer->pixels, argbbuffer->pitch);
+   I_UpdateTexture();
 
    SDL_RenderClear(renderer);
    SDL_RenderCopy(renderer, texture, NULL, NULL);
+
+   I_PaceFrame();
    SDL_RenderPresent(renderer);
+   I_FrameDone();
 
    // [AM] Figure out how far into the current tic we're in as a fixed_t.
    if (uncapped)
@@ -1078,9 +1212,14 @@ void I_SetPalette(byte *palette)
       colors[i].r = gammatable[usegamma][*palette++];
       colors[i].g = gammatable[usegamma][*palette++];
       colors[i].b = gammatable[usegamma][*palette++];
+
+      palette_lut[i] = SDL_MapRGB(texture_format,
+                                  colors[i].r, colors[i].g, colors[i].b);
    }
    
    SDL_SetPaletteColors(sdlscreen->format->palette, colors, 0, 256);
+
+   full_update = true;
 }
 
 void I_ShutdownGraphics(void)
@@ -1487,6 +1626,12 @@ static void I_InitGraphicsMode(void)
 
    pixel_format = SDL_GetWindowPixelFormat(screen);
 
+   // The palette conversion writes 32-bit pixels only
+   if (SDL_BYTESPERPIXEL(pixel_format) != 4)
+   {
+      pixel_format = SDL_PIXELFORMAT_ARGB8888;
+   }
+
    // [FG] renderer flags
    flags = 0;
 
@@ -1569,27 +1714,25 @@ static void I_InitGraphicsMode(void)
       memset(screens[0], 0, v_w * v_h * sizeof(*screens[0]));
    }
 
-   // [FG] create intermediate ARGB frame buffer
+   // paletted copy of the last uploaded frame
 
-   if (argbbuffer != NULL)
+   last_frame = (realloc)(last_frame, v_w * v_h);
+   if (last_frame == NULL)
    {
-      SDL_FreeSurface(argbbuffer);
-      argbbuffer = NULL;
+      I_Error("I_InitGraphicsMode: Failed to allocate frame buffer copy");
    }
 
-   if (argbbuffer == NULL)
+   if (texture_format == NULL || texture_format->format != pixel_format)
    {
-      unsigned int rmask, gmask, bmask, amask;
-      int bpp;
-
-      SDL_PixelFormatEnumToMasks(pixel_format, &bpp,
-                                 &rmask, &gmask, &bmask, &amask);
-      argbbuffer = SDL_CreateRGBSurface(0,
-                                        v_w, v_h, bpp,
-                                        rmask, gmask, bmask, amask);
-      SDL_FillRect(argbbuffer, NULL, 0);
+      if (texture_format != NULL)
+      {
+         SDL_FreeFormat(texture_format);
+      }
+      texture_format = SDL_AllocFormat(pixel_format);
    }
 
+   I_InitConvertLine();
+
    // [FG] create texture
 
    if (texture != NULL)
@@ -1604,6 +1747,8 @@ static void I_InitGraphicsMode(void)
                                SDL_TEXTUREACCESS_STREAMING,
                                v_w, v_h);
 
+   full_update = true;
+
    // Workaround for SDL 2.0.14 (and 2.0.16) alt-tab bug (taken from Doom Retro)
 #if defined(_WIN32)
    {
@@ -798,6 +798,8 @@ static void M_DrawDelVerify(void);
 static void M_DeleteGame(int i)
 {
   char *name = G_SaveGameName(i);
+
+  G_WaitSaveGame();
   remove(name);
 
   if (i == quickSaveSlot)
@@ -2813,6 +2815,7 @@ setup_menu_t keys_settings3[] =
   {"RELOAD LEVEL",S_INPUT,m_scrn,KB_X,KB_Y+12*8,{0},input_menu_reloadlevel},
   {"NEXT LEVEL"  ,S_INPUT,m_scrn,KB_X,KB_Y+13*8,{0},input_menu_nextlevel},
   {"FINISH DEMO" ,S_INPUT,m_scrn,KB_X,KB_Y+14*8,{0},input_demo_quit},
+  {"REWIND"      ,S_INPUT,m_scrn,KB_X,KB_Y+15*8,{0},input_rewind},
 
   {"<- PREV", S_SKIP|S_PREV,m_null,KB_PREV,KB_Y+20*8, {keys_settings2}},
   {"NEXT ->", S_SKIP|S_NEXT,m_null,KB_NEXT,KB_Y+20*8, {keys_settings4}},
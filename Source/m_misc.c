@@ -50,6 +50,14 @@
 #include "d_main.h"
 #include "r_draw.h" // [FG] fuzzcolumn_mode
 #include "r_sky.h" // [FG] stretchsky
+#include "r_main.h" // r_threads
+#include "i_thread.h" // MAX_THREADS
+#include "g_rewind.h"
+#include "../opl/opl.h" // OPL_MAX_CHIPS
+#include "p_preload.h"
+#include "p_reject.h"
+#include "d_demosync.h"
+#include "i_pacer.h"
 
 #include "d_io.h"
 #include <errno.h>
@@ -697,6 +705,34 @@ default_t defaults[] = {
     "1 to enable INTERCEPTS overflow emulation"
   },
 
+  {
+    "build_reject",
+    (config_t *) &build_reject, NULL,
+    {0}, {0,1}, number, ss_none, wad_no,
+    "1 to build REJECT tables for maps with an empty REJECT lump"
+  },
+
+  {
+    "compress_savegames",
+    (config_t *) &compress_savegames, NULL,
+    {1}, {0,1}, number, ss_none, wad_no,
+    "1 to compress savegames"
+  },
+
+  {
+    "preload_level",
+    (config_t *) &preload_level, NULL,
+    {1}, {0,1}, number, ss_none, wad_no,
+    "1 to load the next level in the background during the intermission"
+  },
+
+  {
+    "composite_cache",
+    (config_t *) &composite_cache, NULL,
+    {0}, {0,1}, number, ss_none, wad_no,
+    "1 to keep composed textures in a cache on disk"
+  },
+
   // For key bindings, the values stored in the key_* variables       // phares
   // are the internal Doom Codes. The values stored in the default.cfg
   // file are the keyboard codes. I_ScanCode2DoomCode converts from
@@ -845,6 +881,14 @@ default_t defaults[] = {
     input_demo_quit, { {0, 0} }
   },
 
+  {
+    "input_rewind",
+    NULL, NULL,
+    {0}, {UL,UL}, input, ss_keys, wad_no,
+    "key to rewind to the last snapshot",
+    input_rewind, { {0, 0} }
+  },
+
   {
     "input_strafeleft",
     NULL, NULL,
@@ -2068,14 +2112,6 @@ default_t defaults[] = {
     "1 to precache all sound effects"
   },
 
-  // [FG] optional low-pass filter
-  {
-    "lowpass_filter",
-    (config_t *) &lowpass_filter, NULL,
-    {0}, {0, 1}, number, ss_none, wad_no,
-    "1 to apply low-pass filtering to all sounds effects"
-  },
-
   // [FG] play sounds in full length
   {
     "full_sounds",
@@ -2092,6 +2128,13 @@ default_t defaults[] = {
     "0 for SDL2_Mixer (default), 1 for OPL Emulation"
   },
 
+  {
+    "num_opl_chips",
+    (config_t *) &num_opl_chips, NULL,
+    {1}, {1, OPL_MAX_CHIPS}, number, ss_none, wad_no,
+    "Number of emulated OPL chips (1-6)"
+  },
+
 #if defined(HAVE_FLUIDSYNTH)
   {
     "soundfont_path",
@@ -2128,6 +2171,13 @@ default_t defaults[] = {
     "1 to enable uncapped rendering frame rate"
   },
 
+  {
+    "fpslimit",
+    (config_t *) &fpslimit, NULL,
+    {0}, {0, 1000}, number, ss_none, wad_no,
+    "Frame rate limit with uncapped rendering (0 = none, 35-1000)"
+  },
+
   // [FG] force integer scales
   {
     "integer_scaling",
@@ -2208,6 +2258,29 @@ default_t defaults[] = {
     "0 original, 1 blocky (hires)"
   },
 
+  // rewind
+  {
+    "rewind_interval",
+    (config_t *) &rewind_interval, NULL,
+    {0}, {0,UL}, number, ss_none, wad_no,
+    "tics between rewind snapshots (0 = off)"
+  },
+
+  {
+    "rewind_budget",
+    (config_t *) &rewind_budget, NULL,
+    {32}, {1,1024}, number, ss_none, wad_no,
+    "memory budget for rewind snapshots, in MiB"
+  },
+
+  // split-screen rendering
+  {
+    "r_threads",
+    (config_t *) &r_threads, NULL,
+    {1}, {0,MAX_THREADS}, number, ss_none, wad_no,
+    "number of render threads (0 = one per CPU, 1 = single-threaded)"
+  },
+
   {NULL}         // last entry
 };
 
@@ -2267,6 +2340,10 @@ void M_SaveDefaults (void)
   if (!defaults_loaded || !defaultfile)
     return;
 
+  // Children of -demobatch would write over each other's temp file.
+  if (demosync)
+    return;
+
   // get maximum config key string length
   for (dp = defaults; ; dp++)
   {
@@ -0,0 +1,244 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Loopback netgame benchmark.
+//
+//      -netbench [tics] plays a netgame between the server and a single
+//      client over the loopback module, once with each protocol, with
+//      made-up ticcmds at the normal tic rate. It reports the traffic per
+//      tic and how long the tics of the client took to get through to the
+//      server, which is where -netlatency, -netjitter and -netloss show.
+//
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "i_system.h"
+#include "i_video.h" // I_Sleep
+#include "m_argv.h"
+#include "net_bench.h"
+#include "net_bot.h"
+#include "net_client.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_loop.h"
+#include "net_server.h"
+#include "net_structrw.h"
+
+static int CompareInts(const void *a, const void *b)
+{
+    return *(const int *) a - *(const int *) b;
+}
+
+static uint64_t *sendtime;
+static int *delay;
+static unsigned int numtics, arrived;
+
+// Run both ends of the connection, and note when tics come in.
+
+static void RunNetwork(void)
+{
+    unsigned int now;
+
+    NET_CL_Run();
+    NET_SV_Run();
+
+    now = NET_SV_PlayerTics(0);
+
+    for (; arrived < now && arrived < numtics; ++arrived)
+    {
+        delay[arrived] = (int) (I_GetTimeUS() - sendtime[arrived]);
+    }
+}
+
+static boolean Launched(void)
+{
+    return !net_waiting_for_launch;
+}
+
+static boolean Started(void)
+{
+    net_gamesettings_t settings;
+
+    return NET_CL_GetSettings(&settings);
+}
+
+static void RunUntil(boolean (*condition)(void), const char *what)
+{
+    const int start = I_GetTimeMS();
+
+    do
+    {
+        if (I_GetTimeMS() - start > 10000)
+        {
+            I_Error("NET_Benchmark: Timed out waiting for %s", what);
+        }
+
+        RunNetwork();
+        I_Sleep(1);
+    } while (!condition());
+}
+
+static void RunPass(net_protocol_t protocol, int tics)
+{
+    net_connect_data_t data;
+    net_gamesettings_t settings;
+    net_addr_t *addr;
+    ticcmd_t cmd;
+    uint64_t start;
+    int late = 0, i;
+    double late_total = 0;
+
+    net_max_protocol = protocol;
+    memset(&net_loop_to_server, 0, sizeof(net_loop_to_server));
+    memset(&net_loop_to_client, 0, sizeof(net_loop_to_client));
+    numtics = 0;
+    arrived = 0;
+
+    // Both protocols code the very same ticcmds.
+
+    NET_BotSeed(1);
+
+    sendtime = (calloc)(tics, sizeof(*sendtime));
+    delay = (malloc)(tics * sizeof(*delay));
+
+    for (i = 0; i < tics; ++i)
+    {
+        delay[i] = INT_MAX;
+    }
+
+    NET_SV_Init();
+    NET_SV_AddModule(&net_loop_server_module);
+    addr = net_loop_client_module.ResolveAddress(NULL);
+
+    memset(&data, 0, sizeof(data));
+    data.max_players = NET_MAXPLAYERS;
+
+    if (!NET_CL_Connect(addr, &data))
+    {
+        I_Error("NET_Benchmark: Failed to connect: %s",
+                net_client_reject_reason);
+    }
+
+    NET_CL_LaunchGame();
+    RunUntil(Launched, "the launch");
+
+    memset(&settings, 0, sizeof(settings));
+    settings.ticdup = 1;
+    settings.extratics = 1;
+    settings.new_sync = 1;
+    NET_CL_StartGame(&settings);
+    RunUntil(Started, "the game to start");
+
+    // The server only starts over on the tic numbers now.
+
+    numtics = tics;
+
+    memset(&net_loop_to_server, 0, sizeof(net_loop_to_server));
+    memset(&net_loop_to_client, 0, sizeof(net_loop_to_client));
+    memset(&cmd, 0, sizeof(cmd));
+    start = I_GetTimeUS();
+
+    for (i = 0; i < tics; ++i)
+    {
+        const uint64_t deadline = start + (uint64_t) i * 1000000 / TICRATE;
+
+        while (I_GetTimeUS() < deadline)
+        {
+            RunNetwork();
+            I_Sleep(1);
+        }
+
+        NET_BotTiccmd(&cmd);
+        sendtime[i] = I_GetTimeUS();
+        NET_CL_SendTiccmd(&cmd, i);
+    }
+
+    // Give the last tics a chance to get through.
+
+    start = I_GetTimeUS();
+
+    while (arrived < tics && I_GetTimeUS() - start < 2000000)
+    {
+        RunNetwork();
+        I_Sleep(1);
+    }
+
+    NET_CL_Disconnect();
+    NET_SV_Shutdown();
+
+    // Packets still held back must not turn up in the next pass.
+
+    NET_DropDelayedPackets();
+
+    // Tics more than half a tic later than the simulated latency had to
+    // be recovered.
+
+    for (i = 0; i < arrived; ++i)
+    {
+        if (delay[i] > (net_sim_latency + net_sim_jitter) * 1000
+                       + 500000 / TICRATE)
+        {
+            late++;
+            late_total += delay[i];
+        }
+    }
+
+    qsort(delay, tics, sizeof(*delay), CompareInts);
+
+    printf("NET_Benchmark: %s, %d+-%d ms, %d%% loss: up %.1f bytes in "
+           "%.2f packets, down %.1f bytes in %.2f packets per tic\n",
+           protocol == NET_PROTOCOL_WOOF_1 ? "WOOF_1" : "CHOCOLATE_DOOM_0",
+           net_sim_latency, net_sim_jitter, net_sim_loss,
+           (double) net_loop_to_server.bytes / tics,
+           (double) net_loop_to_server.packets / tics,
+           (double) net_loop_to_client.bytes / tics,
+           (double) net_loop_to_client.packets / tics);
+
+    if (arrived > 0)
+    {
+        printf("NET_Benchmark:   tic delay p50 %.1f ms, p99 %.1f ms, "
+               "max %.1f ms; %d late, recovered in %.1f ms on average; "
+               "%d lost\n",
+               delay[arrived / 2] / 1000.0,
+               delay[(arrived * 99) / 100] / 1000.0,
+               delay[arrived - 1] / 1000.0, late,
+               late ? late_total / late / 1000.0 : 0.0, tics - arrived);
+    }
+
+    (free)(sendtime);
+    (free)(delay);
+}
+
+void NET_Benchmark(void)
+{
+    const net_protocol_t max_protocol = net_max_protocol;
+    int tics = 20 * TICRATE;
+    int p;
+
+    p = M_CheckParmWithArgs("-netbench", 1);
+
+    if (p > 0)
+    {
+        tics = BETWEEN(TICRATE, 3600 * TICRATE, atoi(myargv[p + 1]));
+    }
+
+    RunPass(NET_PROTOCOL_WOOF_1, tics);
+    RunPass(NET_PROTOCOL_CHOCOLATE_DOOM_0, tics);
+
+    net_max_protocol = max_protocol;
+}
@@ -0,0 +1,24 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Loopback netgame benchmark.
+//
+
+#ifndef NET_BENCH_H
+#define NET_BENCH_H
+
+// -netbench [tics]
+void NET_Benchmark(void);
+
+#endif /* #ifndef NET_BENCH_H */
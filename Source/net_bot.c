@@ -0,0 +1,275 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Scripted netgame clients for load testing.
+//
+//      -netbot <address> joins the server at <address> as a bot, without
+//      a WAD or a window, and plays made-up ticcmds at the normal tic
+//      rate. Start a -dedicated server with -netstats and as many bots as
+//      wanted, each in a process of its own, on this machine or others:
+//
+//        woof -dedicated -netstats 10 &
+//        for i in 1 2 3 4 5 6 7 8; do woof -netbot localhost -botplayers 8 & done
+//
+//      The first bot to join launches the game once -botplayers <n>
+//      players (2 by default) are in. Every bot plays for -bottime
+//      <seconds> (60 by default) and then prints its input latency: how
+//      long it took from sending a ticcmd until the server had sent back
+//      the complete tic. -netlatency, -netjitter and -netloss (net_io.c)
+//      make the network worse, on either end.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "d_event.h"
+#include "doomdef.h"
+#include "i_system.h"
+#include "i_video.h" // I_Sleep
+#include "m_argv.h"
+#include "net_bot.h"
+#include "net_client.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_sdl.h"
+
+static unsigned int seed = 1;
+
+static int Random(void)
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 16;
+}
+
+void NET_BotSeed(unsigned int s)
+{
+    seed = s;
+}
+
+// A player running around and turning with the mouse.
+
+void NET_BotTiccmd(ticcmd_t *cmd)
+{
+    if (Random() % 15 == 0)
+        cmd->forwardmove = (Random() % 3 - 1) * 50;
+    if (Random() % 25 == 0)
+        cmd->sidemove = (Random() % 3 - 1) * 40;
+
+    if (Random() % 10 < 7)
+        cmd->angleturn += Random() % 81 - 40;
+    else if (Random() % 3 == 0)
+        cmd->angleturn = 0;
+
+    if (Random() % 40 == 0)
+        cmd->buttons ^= BT_ATTACK;
+
+    if (cmd->forwardmove || cmd->sidemove)
+        cmd->consistancy = Random() & 0xff;
+}
+
+// Input latencies in 1 ms buckets up to a second, the last bucket takes
+// everything beyond.
+
+#define NUMBUCKETS 1001
+
+static unsigned int latency[NUMBUCKETS];
+static unsigned int samples;
+static uint64_t max_latency;
+
+static void AddLatency(uint64_t us)
+{
+    latency[MIN(us / 1000, NUMBUCKETS - 1)]++;
+    max_latency = MAX(max_latency, us);
+    samples++;
+}
+
+// Upper bound of the bucket holding the given percentile, in ms.
+
+static int Percentile(int percent)
+{
+    const unsigned int rank = (samples * percent + 99) / 100;
+    unsigned int sum = 0;
+    int i;
+
+    for (i = 0; i < NUMBUCKETS - 1; i++)
+        if ((sum += latency[i]) >= rank)
+            break;
+
+    return i < NUMBUCKETS - 1 ? i + 1 : (int) (max_latency / 1000);
+}
+
+static void RunUntilStart(int players)
+{
+    net_gamesettings_t settings;
+    boolean launched = false;
+    int p;
+
+    // The controller, the first to join, launches the game once enough
+    // players are in.
+
+    do
+    {
+        NET_CL_Run();
+
+        if (!net_client_connected)
+        {
+            I_Error("NET_BotClient: Lost connection to server");
+        }
+
+        if (!launched && net_client_received_wait_data
+         && net_client_wait_data.is_controller
+         && net_client_wait_data.num_players >= players)
+        {
+            NET_CL_LaunchGame();
+            launched = true;
+        }
+
+        I_Sleep(10);
+    } while (net_waiting_for_launch);
+
+    // Only the settings of the controller count.
+
+    memset(&settings, 0, sizeof(settings));
+    settings.ticdup = 1;
+    settings.new_sync = 1;
+    settings.skill = sk_medium;
+    settings.episode = 1;
+    settings.map = 1;
+
+    p = M_CheckParmWithArgs("-extratics", 1);
+    settings.extratics = p > 0 ? atoi(myargv[p + 1]) : 1;
+
+    NET_CL_StartGame(&settings);
+
+    while (!NET_CL_GetSettings(&settings))
+    {
+        NET_CL_Run();
+
+        if (!net_client_connected)
+        {
+            I_Error("NET_BotClient: Lost connection to server");
+        }
+
+        I_Sleep(10);
+    }
+}
+
+void NET_BotClient(void)
+{
+    net_connect_data_t data;
+    net_addr_t *addr;
+    ticcmd_t cmd;
+    uint64_t sendtime[BACKUPTICS];
+    uint64_t start, duration = 60;
+    unsigned int maketic = 0, recvtic = 0;
+    int players = 2;
+    int p;
+
+    p = M_CheckParmWithArgs("-netbot", 1);
+
+    if (p <= 0)
+    {
+        I_Error("NET_BotClient: No server address given");
+    }
+
+    NET_Init();
+    net_sdl_module.InitClient();
+    addr = net_sdl_module.ResolveAddress(myargv[p + 1]);
+
+    if (addr == NULL)
+    {
+        I_Error("NET_BotClient: Unable to resolve '%s'", myargv[p + 1]);
+    }
+
+    NET_ReferenceAddress(addr);
+
+    p = M_CheckParmWithArgs("-botplayers", 1);
+
+    if (p > 0)
+    {
+        players = BETWEEN(1, NET_MAXPLAYERS, atoi(myargv[p + 1]));
+    }
+
+    p = M_CheckParmWithArgs("-bottime", 1);
+
+    if (p > 0)
+    {
+        duration = MAX(atoi(myargv[p + 1]), 1);
+    }
+
+    memset(&data, 0, sizeof(data));
+    data.gamemode = commercial;
+    data.gamemission = doom2;
+    data.max_players = NET_MAXPLAYERS;
+
+    if (!NET_CL_Connect(addr, &data))
+    {
+        I_Error("NET_BotClient: Failed to connect to %s: %s",
+                NET_AddrToString(addr), net_client_reject_reason);
+    }
+
+    printf("NET_BotClient: Connected to %s\n", NET_AddrToString(addr));
+    NET_ReleaseAddress(addr);
+
+    RunUntilStart(players);
+
+    // Give each bot its own moves.
+
+    NET_BotSeed((unsigned int) I_GetTimeNS());
+    memset(&cmd, 0, sizeof(cmd));
+    start = I_GetTimeUS();
+    duration *= 1000000;
+
+    while (net_client_connected && I_GetTimeUS() - start < duration)
+    {
+        const unsigned int tic = (I_GetTimeUS() - start) * TICRATE / 1000000;
+        unsigned int received;
+
+        // Like a real player, never get more than ~200ms ahead.
+
+        while (maketic <= tic && maketic - recvtic <= 8)
+        {
+            NET_BotTiccmd(&cmd);
+            sendtime[maketic % BACKUPTICS] = I_GetTimeUS();
+            NET_CL_SendTiccmd(&cmd, maketic);
+            ++maketic;
+        }
+
+        NET_CL_Run();
+
+        received = MIN(NET_CL_ReceivedTics(), maketic);
+
+        for (; recvtic < received; ++recvtic)
+        {
+            AddLatency(I_GetTimeUS() - sendtime[recvtic % BACKUPTICS]);
+        }
+
+        if (!NET_SDL_WaitForPacket(1))
+        {
+            I_Sleep(1);
+        }
+    }
+
+    if (samples > 0)
+    {
+        printf("NET_BotClient: %u tics, input latency p50 %d ms, p90 %d ms, "
+               "p99 %d ms, max %d ms; %u tics resent\n",
+               samples, Percentile(50), Percentile(90), Percentile(99),
+               (int) (max_latency / 1000), NET_CL_ResentTics());
+    }
+
+    NET_CL_Disconnect();
+    I_SafeExit(0);
+}
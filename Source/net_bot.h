@@ -0,0 +1,32 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Scripted netgame clients for load testing.
+//
+
+#ifndef NET_BOT_H
+#define NET_BOT_H
+
+#include "d_ticcmd.h"
+
+// Start over on the ticcmds made up by NET_BotTiccmd().
+void NET_BotSeed(unsigned int s);
+
+// Make up the next ticcmd of a player running around.
+void NET_BotTiccmd(ticcmd_t *cmd);
+
+// -netbot <address>: play as a bot, does not return.
+void NET_BotClient(void);
+
+#endif /* #ifndef NET_BOT_H */
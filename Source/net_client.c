@@ -152,6 +152,17 @@ static net_server_recv_t recvwindow[BACKUPTICS];
 static boolean need_to_acknowledge;
 static unsigned int gamedata_recv_time;
 
+// NET_PROTOCOL_WOOF_1: which of our tics the server has, the last tic we
+// generated and when we last sent game data.
+
+static net_sack_t send_sack;
+static unsigned int send_latest;
+static unsigned int gamedata_send_time;
+
+// Tics sent again on request of the server.
+
+static unsigned int resent_tics;
+
 // The latency (time between when we sent our command and we got all
 // the other players' commands from the server) for the last tic we
 // received. We include this latency in tics we send to the server so
@@ -169,6 +180,11 @@ unsigned int net_local_is_freedoom;
 
 #define NET_CL_ExpandTicNum(b) NET_ExpandTicNum(recvwindow_start, (b))
 
+static boolean CompactGameData(void)
+{
+    return client_connection.protocol == NET_PROTOCOL_WOOF_1;
+}
+
 // Called when we become disconnected from the server
 
 static void NET_CL_Disconnected(void)
@@ -319,10 +335,120 @@ void NET_CL_StartGame(net_gamesettings_t *settings)
     NET_WriteSettings(packet, settings);
 }
 
+// Send the tics in mask, counted from start, along with what we have
+// received from the server so far. NET_PROTOCOL_WOOF_1 only.
+
+static void NET_CL_SendCompactTics(unsigned int start, unsigned int mask)
+{
+    net_compact_header_t header;
+    net_ticdiff_t *diffs[NET_SACK_TICS];
+    net_packet_t *packet;
+    int i, num_diffs;
+
+    header.ack = recvwindow_start & 0xff;
+    header.sack = 0;
+
+    for (i = 0; i < NET_SACK_TICS; ++i)
+    {
+        if (recvwindow[i].active)
+        {
+            header.sack |= 1u << i;
+        }
+    }
+
+    header.start = start & 0xff;
+    header.tics = 0;
+    header.latency = last_latency;
+    num_diffs = 0;
+
+    for (i = 0; i < NET_SACK_TICS; ++i)
+    {
+        net_server_send_t *sendobj;
+
+        sendobj = &send_queue[(start + i) % BACKUPTICS];
+
+        if ((mask & (1u << i)) && sendobj->active && sendobj->seq == start + i)
+        {
+            header.tics |= 1u << i;
+            diffs[num_diffs++] = &sendobj->cmd;
+            NET_SackSent(&send_sack, start + i);
+        }
+    }
+
+    packet = NET_NewPacket(64);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_COMPACT_GAMEDATA);
+    NET_WriteCompactTicDiffs(packet, &header, diffs, settings.lowres_turn);
+    NET_Conn_SendPacket(&client_connection, packet);
+    NET_FreePacket(packet);
+
+    need_to_acknowledge = false;
+    gamedata_send_time = I_GetTimeMS();
+}
+
+// Send everything the server is still missing and acknowledge what we
+// have received. Apart from when there are new tics to send, this is
+// done at most once a tic.
+
+static void NET_CL_SendCompactGameData(boolean newtics)
+{
+    unsigned int start, mask;
+    unsigned int i, first;
+    boolean urgent = newtics;
+
+    if (!newtics && I_GetTimeMS() - gamedata_send_time < 1000 / TICRATE)
+    {
+        return;
+    }
+
+    start = send_latest + 1;
+    mask = 0;
+
+    // Stop NET_SACK_TICS past the first wanted tic, which is all that
+    // fits in one packet. Nothing older than the send queue can be
+    // wanted either, its slots have been reused.
+
+    first = send_latest + 1 >= BACKUPTICS ? send_latest + 1 - BACKUPTICS : 0;
+
+    for (i = MAX(send_sack.acked, first);
+         i <= send_latest && !drone && (!mask || i - start < NET_SACK_TICS);
+         ++i)
+    {
+        if (send_queue[i % BACKUPTICS].active
+         && send_queue[i % BACKUPTICS].seq == i
+         && NET_SackWanted(&send_sack, i))
+        {
+            urgent |= !NET_SackRedundant(&send_sack, i);
+
+            if (!mask)
+            {
+                start = i;
+            }
+
+            mask |= 1u << (i - start);
+        }
+    }
+
+    // Redundant copies and acknowledgements go along with the next new
+    // tic, unless it takes too long.
+
+    if ((mask && urgent)
+     || ((mask || need_to_acknowledge)
+      && I_GetTimeMS() - gamedata_send_time >= 2 * 1000 / TICRATE))
+    {
+        NET_CL_SendCompactTics(start, mask);
+    }
+}
+
 static void NET_CL_SendGameDataACK(void)
 {
     net_packet_t *packet;
 
+    if (CompactGameData())
+    {
+        NET_CL_SendCompactTics(0, 0);
+        return;
+    }
+
     packet = NET_NewPacket(10);
 
     NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA_ACK);
@@ -349,6 +475,12 @@ static void NET_CL_SendTics(int start, int end)
 
     if (start < 0)
         start = 0;
+
+    if (CompactGameData())
+    {
+        NET_CL_SendCompactTics(start, NET_TicRangeMask(start, end));
+        return;
+    }
     
     // Build a new packet to send to the server
 
@@ -412,6 +544,13 @@ void NET_CL_SendTiccmd(ticcmd_t *ticcmd, int maketic)
 
     // Send to server.
 
+    if (CompactGameData())
+    {
+        send_latest = maketic;
+        NET_CL_SendCompactGameData(true);
+        return;
+    }
+
     starttic = maketic - settings.extratics;
     endtic = maketic;
 
@@ -604,6 +743,10 @@ static void NET_CL_ParseGameStart(net_packet_t *packet)
     // Clear the send queue
 
     memset(&send_queue, 0x00, sizeof(send_queue));
+    NET_SackInit(&send_sack, settings.extratics);
+    send_latest = 0;
+    gamedata_send_time = I_GetTimeMS();
+    resent_tics = 0;
 }
 
 static void NET_CL_SendResendRequest(int start, int end)
@@ -850,6 +993,79 @@ static void NET_CL_ParseGameData(net_packet_t *packet)
     }
 }
 
+// Parsing of NET_PACKET_TYPE_COMPACT_GAMEDATA packets: the tics and which
+// of ours have been received by the server. Lost tics are sent again on
+// their own, without any resend requests.
+
+static void NET_CL_ParseCompactGameData(net_packet_t *packet)
+{
+    net_compact_header_t header;
+    net_full_ticcmd_t cmds[NET_SACK_TICS], *cmd;
+    unsigned int seq, nowtime;
+    int i, num_cmds, index;
+
+    NET_Log("client: processing compact game data packet");
+
+    if (client_state != CLIENT_STATE_IN_GAME)
+    {
+        return;
+    }
+
+    if (!NET_ReadCompactFullTiccmds(packet, &header, cmds,
+                                    settings.lowres_turn))
+    {
+        NET_Log("client: error: failed to read compact game data");
+        return;
+    }
+
+    NET_SackUpdate(&send_sack, NET_ExpandTicNum(send_sack.acked, header.ack),
+                   header.sack);
+
+    if (!header.tics)
+    {
+        return;
+    }
+
+    nowtime = I_GetTimeMS();
+
+    if (!need_to_acknowledge)
+    {
+        need_to_acknowledge = true;
+        gamedata_recv_time = nowtime;
+    }
+
+    seq = NET_CL_ExpandTicNum(header.start);
+    NET_Log("client: got compact game data, seq=%d, tics=0x%x",
+            seq, header.tics);
+
+    for (i = num_cmds = 0; i < NET_SACK_TICS; ++i)
+    {
+        if (!(header.tics & (1u << i)))
+        {
+            continue;
+        }
+
+        index = seq + i - recvwindow_start;
+        cmd = &cmds[num_cmds++];
+
+        if (index < 0 || index >= BACKUPTICS)
+        {
+            continue;
+        }
+
+        recvwindow[index].active = true;
+        recvwindow[index].cmd = *cmd;
+
+        // As with NET_CL_ParseGameData(), only the newest tic in the
+        // packet is good for the clock sync.
+
+        if ((header.tics >> i) == 1)
+        {
+            UpdateClockSync(seq + i, cmd->latency);
+        }
+    }
+}
+
 // Parse a resend request from the server due to a dropped packet
 
 static void NET_CL_ParseResendRequest(net_packet_t *packet)
@@ -901,6 +1117,7 @@ static void NET_CL_ParseResendRequest(net_packet_t *packet)
     {
         NET_Log("client: resending %d-%d", start, end);
         NET_CL_SendTics(start, end);
+        resent_tics += end - start + 1;
     }
     else
     {
@@ -971,6 +1188,10 @@ static void NET_CL_ParsePacket(net_packet_t *packet)
                 NET_CL_ParseGameData(packet);
                 break;
 
+            case NET_PACKET_TYPE_COMPACT_GAMEDATA:
+                NET_CL_ParseCompactGameData(packet);
+                break;
+
             case NET_PACKET_TYPE_GAMEDATA_RESEND:
                 NET_CL_ParseResendRequest(packet);
                 break;
@@ -1036,6 +1257,13 @@ void NET_CL_Run(void)
         // Check if our resend requests have timed out
 
         NET_CL_CheckResends();
+
+        // Send again what the server is missing
+
+        if (CompactGameData())
+        {
+            NET_CL_SendCompactGameData(false);
+        }
     }
 }
 
@@ -1162,6 +1390,16 @@ boolean NET_CL_GetSettings(net_gamesettings_t *_settings)
     return true;
 }
 
+unsigned int NET_CL_ReceivedTics(void)
+{
+    return recvwindow_start;
+}
+
+unsigned int NET_CL_ResentTics(void)
+{
+    return resent_tics + send_sack.resends;
+}
+
 // disconnect from the server
 
 void NET_CL_Disconnect(void)
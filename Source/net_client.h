@@ -29,6 +29,12 @@ void NET_CL_LaunchGame(void);
 void NET_CL_StartGame(net_gamesettings_t *settings);
 void NET_CL_SendTiccmd(ticcmd_t *ticcmd, int maketic);
 boolean NET_CL_GetSettings(net_gamesettings_t *_settings);
+
+// Complete tics received from the server so far, and tics sent to it
+// again, for -netbot.
+unsigned int NET_CL_ReceivedTics(void);
+unsigned int NET_CL_ResentTics(void);
+
 void NET_Init(void);
 
 void NET_BindVariables(void);
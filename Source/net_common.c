@@ -425,6 +425,158 @@ unsigned int NET_ExpandTicNum(unsigned int relative, unsigned int b)
     return result;
 }
 
+//
+// Selective acknowledgement of tics
+//
+
+void NET_SackInit(net_sack_t *sack, int redundancy)
+{
+    int i;
+
+    memset(sack, 0, sizeof(*sack));
+
+    for (i = 0; i < BACKUPTICS; ++i)
+    {
+        sack->tic[i] = UINT_MAX;
+    }
+
+    sack->redundancy = redundancy;
+    sack->rtt = 100;
+}
+
+boolean NET_SackReceived(net_sack_t *sack, unsigned int tic)
+{
+    const unsigned int offset = tic - sack->acked;
+
+    return tic < sack->acked
+        || (offset < NET_SACK_TICS && (sack->bits & (1u << offset)));
+}
+
+// Takes in an acknowledgement from the other end. The round trip time is
+// measured on the newest tic acknowledged for the first time, provided it
+// was sent only once so that it is known which copy got through.
+
+void NET_SackUpdate(net_sack_t *sack, unsigned int acked, unsigned int bits)
+{
+    unsigned int tic, newest = UINT_MAX;
+    int i;
+
+    if (acked < sack->acked)
+    {
+        // Older than what we know already.
+
+        return;
+    }
+
+    for (i = NET_SACK_TICS - 1; i >= -1 && newest == UINT_MAX; --i)
+    {
+        tic = acked + i;
+
+        if (i >= 0 && !(bits & (1u << i)))
+        {
+            continue;
+        }
+
+        if (!NET_SackReceived(sack, tic)
+         && sack->tic[tic % BACKUPTICS] == tic
+         && sack->sends[tic % BACKUPTICS] == 1)
+        {
+            newest = tic;
+        }
+    }
+
+    if (acked - sack->acked < NET_SACK_TICS)
+    {
+        bits |= sack->bits >> (acked - sack->acked);
+    }
+
+    sack->acked = acked;
+    sack->bits = bits;
+
+    if (newest != UINT_MAX)
+    {
+        const int sample = I_GetTimeMS() - sack->send_time[newest % BACKUPTICS];
+
+        sack->rtt += (sample - sack->rtt) / 8;
+    }
+}
+
+// Whether a tic should go into the next packet: it is new, should be sent
+// once more because of redundancy, or seems to be lost. A tic is taken as
+// lost a round trip after it was sent if a later one has made it, or two
+// round trips after otherwise.
+
+boolean NET_SackWanted(net_sack_t *sack, unsigned int tic)
+{
+    const int slot = tic % BACKUPTICS;
+    unsigned int timeout;
+
+    if (NET_SackReceived(sack, tic))
+    {
+        return false;
+    }
+
+    if (sack->tic[slot] != tic || sack->sends[slot] <= sack->redundancy)
+    {
+        return true;
+    }
+
+    timeout = sack->rtt + 1000 / TICRATE;
+
+    if (tic - sack->acked + 1 >= NET_SACK_TICS
+     || (sack->bits >> (tic - sack->acked + 1)) == 0)
+    {
+        timeout *= 2;
+    }
+
+    return I_GetTimeMS() - sack->send_time[slot] >= timeout;
+}
+
+// Whether a wanted tic is only wanted as a redundant copy, which can wait
+// for the next packet with new tics.
+
+boolean NET_SackRedundant(net_sack_t *sack, unsigned int tic)
+{
+    const int slot = tic % BACKUPTICS;
+
+    return sack->tic[slot] == tic && sack->sends[slot] <= sack->redundancy;
+}
+
+void NET_SackSent(net_sack_t *sack, unsigned int tic)
+{
+    const int slot = tic % BACKUPTICS;
+
+    if (sack->tic[slot] != tic)
+    {
+        sack->tic[slot] = tic;
+        sack->sends[slot] = 0;
+    }
+    else if (sack->sends[slot] > sack->redundancy)
+    {
+        ++sack->resends;
+    }
+
+    ++sack->sends[slot];
+    sack->send_time[slot] = I_GetTimeMS();
+}
+
+// Bitmap of the tics from start to end, as far as they fit.
+
+unsigned int NET_TicRangeMask(unsigned int start, unsigned int end)
+{
+    if (end < start)
+    {
+        return 0;
+    }
+
+    if (end - start >= NET_SACK_TICS - 1)
+    {
+        return ~0u;
+    }
+
+    return (1u << (end - start + 1)) - 1;
+}
+
 // Check that game settings are valid
 
 boolean NET_ValidGameSettings(GameMode_t mode, GameMission_t mission,
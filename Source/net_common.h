@@ -93,6 +93,30 @@ void NET_Conn_Disconnect(net_connection_t *conn);
 void NET_Conn_Run(net_connection_t *conn);
 net_packet_t *NET_Conn_NewReliable(net_connection_t *conn, int packet_type);
 
+// Selective acknowledgement of tics (NET_PROTOCOL_WOOF_1). The sender
+// keeps track of which of its tics the other end has and when it last
+// sent each one, to send again only what is missing.
+
+typedef struct
+{
+    unsigned int acked;                 // all tics before this were received
+    unsigned int bits;                  // bit i: tic acked + i was received
+    unsigned int tic[BACKUPTICS];       // tic number in each slot
+    unsigned int send_time[BACKUPTICS]; // when it was last sent
+    int sends[BACKUPTICS];              // how often it was sent
+    int redundancy;                     // copies sent without waiting
+    int rtt;                            // smoothed round trip time in ms
+    int resends;                        // tics sent again after a loss
+} net_sack_t;
+
+void NET_SackInit(net_sack_t *sack, int redundancy);
+void NET_SackUpdate(net_sack_t *sack, unsigned int acked, unsigned int bits);
+boolean NET_SackReceived(net_sack_t *sack, unsigned int tic);
+boolean NET_SackWanted(net_sack_t *sack, unsigned int tic);
+boolean NET_SackRedundant(net_sack_t *sack, unsigned int tic);
+void NET_SackSent(net_sack_t *sack, unsigned int tic);
+unsigned int NET_TicRangeMask(unsigned int start, unsigned int end);
+
 // Other miscellaneous common functions
 unsigned int NET_ExpandTicNum(unsigned int relative, unsigned int b);
 boolean NET_ValidGameSettings(GameMode_t mode, GameMission_t mission,
@@ -17,6 +17,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "doomtype.h"
 
@@ -61,18 +63,63 @@ static void CheckForClientOptions(void)
     }
 }
 
+//
+// -netstats <seconds> prints the load of the server every so often: the
+// CPU time it takes per tic, the tics that had to be sent again and how
+// deep the queues are, on average over all clients and at worst.
+//
+
+static void PrintStats(clock_t cpu)
+{
+    const net_server_stats_t *stats = &net_sv_stats;
+    const double samples = MAX(stats->samples, 1);
+
+    printf("SV: %u tics, %.3f ms CPU per tic; tics resent %u, requested %u, "
+           "duplicate %u; send queue %.1f avg %u max, receive window "
+           "%.1f avg %u max\n",
+           stats->tics,
+           stats->tics ? cpu * 1000.0 / CLOCKS_PER_SEC / stats->tics : 0.0,
+           stats->resent, stats->requested, stats->duplicates,
+           stats->sendqueue_total / samples, stats->sendqueue_max,
+           stats->recvwindow_total / samples, stats->recvwindow_max);
+}
+
 void NET_DedicatedServer(void)
 {
+    int p, interval = 0, last_time;
+    clock_t last_clock;
+
     CheckForClientOptions();
 
+    p = M_CheckParmWithArgs("-netstats", 1);
+
+    if (p > 0)
+    {
+        interval = MAX(atoi(myargv[p + 1]), 1) * 1000;
+    }
+
     NET_OpenLog();
     NET_SV_Init();
     NET_SV_AddModule(&net_sdl_module);
     NET_SV_RegisterWithMaster();
 
+    last_time = I_GetTimeMS();
+    last_clock = clock();
+
     while (true)
     {
         NET_SV_Run();
+
+        if (interval && I_GetTimeMS() - last_time >= interval)
+        {
+            const clock_t now = clock();
+
+            PrintStats(now - last_clock);
+            memset(&net_sv_stats, 0, sizeof(net_sv_stats));
+            last_time += interval;
+            last_clock = now;
+        }
+
         // TODO: Block on socket instead of polling.
         I_Sleep(1);
     }
@@ -124,6 +124,10 @@ typedef enum
     // number in this enum.
     NET_PROTOCOL_CHOCOLATE_DOOM_0,
 
+    // Woof! protocol: game data is range coded and selectively
+    // acknowledged, see NET_PACKET_TYPE_COMPACT_GAMEDATA.
+    NET_PROTOCOL_WOOF_1,
+
     // Add your own protocol here; be sure to add a name for it to the list
     // in net_common.c too.
 
@@ -152,6 +156,7 @@ typedef enum
     NET_PACKET_TYPE_QUERY_RESPONSE,
     NET_PACKET_TYPE_LAUNCH,
     NET_PACKET_TYPE_NAT_HOLE_PUNCH,
+    NET_PACKET_TYPE_COMPACT_GAMEDATA,
 } net_packet_type_t;
 
 typedef enum
@@ -250,6 +255,21 @@ typedef struct
     net_ticdiff_t cmds[NET_MAXPLAYERS];
 } net_full_ticcmd_t;
 
+// Header of a NET_PACKET_TYPE_COMPACT_GAMEDATA packet. Besides the tics
+// it carries, it tells the other end which of its tics have been
+// received: all of them before ack, and those after it marked in sack.
+
+#define NET_SACK_TICS 32
+
+typedef struct
+{
+    unsigned int ack;       // low byte of the first tic not received
+    unsigned int sack;      // bit i: tic ack + i received anyway
+    unsigned int start;     // low byte of the first tic in the packet
+    unsigned int tics;      // bit i: tic start + i is in the packet
+    signed int latency;     // from clients only
+} net_compact_header_t;
+
 // Data sent in response to server queries
 
 typedef struct
@@ -17,10 +17,13 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "i_system.h"
+#include "m_argv.h"
 #include "net_defs.h"
 #include "net_io.h"
+#include "net_packet.h"
 #include "z_zone.h"
 
 #define MAX_MODULES 16
@@ -33,10 +36,122 @@ struct _net_context_s
 
 net_addr_t net_broadcast_addr;
 
+// Simulated network conditions, to try out the network code: packets
+// are held back for -netlatency ms, give or take -netjitter ms, and
+// -netloss percent of them never arrive. Jitter can reorder packets,
+// like on a real network.
+
+int net_sim_latency, net_sim_jitter, net_sim_loss;
+
+typedef struct delayed_packet_s
+{
+    net_addr_t *addr;
+    net_packet_t *packet;
+    uint64_t due;
+    struct delayed_packet_s *next;
+} delayed_packet_t;
+
+static delayed_packet_t *delayed_packets;  // sorted by due time
+static unsigned int sim_seed;
+
+static int SimParm(const char *name, int max)
+{
+    int p;
+
+    p = M_CheckParmWithArgs(name, 1);
+
+    return p > 0 ? BETWEEN(0, max, atoi(myargv[p + 1])) : 0;
+}
+
+static void InitSimulation(void)
+{
+    static boolean initialized;
+
+    if (initialized)
+    {
+        return;
+    }
+
+    initialized = true;
+
+    net_sim_latency = SimParm("-netlatency", 10000);
+    net_sim_jitter = SimParm("-netjitter", net_sim_latency);
+    net_sim_loss = SimParm("-netloss", 100);
+
+    // Several processes on the same machine should not all lose the
+    // same packets.
+
+    sim_seed = (unsigned int) I_GetTimeNS();
+}
+
+static unsigned int SimRandom(void)
+{
+    sim_seed = sim_seed * 1664525 + 1013904223;
+    return sim_seed >> 16;
+}
+
+static void SendDelayedPackets(void)
+{
+    const uint64_t now = I_GetTimeUS();
+
+    while (delayed_packets != NULL && delayed_packets->due <= now)
+    {
+        delayed_packet_t *delayed = delayed_packets;
+
+        delayed_packets = delayed->next;
+
+        delayed->addr->module->SendPacket(delayed->addr, delayed->packet);
+        NET_FreePacket(delayed->packet);
+        NET_ReleaseAddress(delayed->addr);
+        (free)(delayed);
+    }
+}
+
+static void DelayPacket(net_addr_t *addr, net_packet_t *packet)
+{
+    delayed_packet_t *delayed, **prev;
+    int delay = net_sim_latency;
+
+    if (net_sim_jitter > 0)
+    {
+        delay += (int) (SimRandom() % (2 * net_sim_jitter + 1))
+                 - net_sim_jitter;
+    }
+
+    delayed = (malloc)(sizeof(*delayed));
+    delayed->addr = addr;
+    delayed->packet = NET_PacketDup(packet);
+    delayed->due = I_GetTimeUS() + (uint64_t) MAX(delay, 0) * 1000;
+
+    NET_ReferenceAddress(addr);
+
+    for (prev = &delayed_packets; *prev != NULL && (*prev)->due <= delayed->due;
+         prev = &(*prev)->next);
+
+    delayed->next = *prev;
+    *prev = delayed;
+}
+
+void NET_DropDelayedPackets(void)
+{
+    while (delayed_packets != NULL)
+    {
+        delayed_packet_t *delayed = delayed_packets;
+
+        delayed_packets = delayed->next;
+
+        NET_FreePacket(delayed->packet);
+        NET_ReleaseAddress(delayed->addr);
+        (free)(delayed);
+    }
+}
+
 net_context_t *NET_NewContext(void)
 {
     net_context_t *context;
 
+    InitSimulation();
+
     context = Z_Malloc(sizeof(net_context_t), PU_STATIC, 0);
     context->num_modules = 0;
 
@@ -75,6 +190,18 @@ net_addr_t *NET_ResolveAddress(net_context_t *context, const char *addr)
 
 void NET_SendPacket(net_addr_t *addr, net_packet_t *packet)
 {
+    if (net_sim_loss > 0 && SimRandom() % 100 < net_sim_loss)
+    {
+        return;
+    }
+
+    if (net_sim_latency > 0)
+    {
+        DelayPacket(addr, packet);
+        SendDelayedPackets();
+        return;
+    }
+
     addr->module->SendPacket(addr, packet);
 }
 
@@ -93,7 +220,9 @@ boolean NET_RecvPacket(net_context_t *context,
                        net_packet_t **packet)
 {
     int i;
-    
+
+    SendDelayedPackets();
+
     // check all modules for new packets
     
     for (i=0; i<context->num_modules; ++i)
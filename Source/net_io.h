@@ -22,6 +22,13 @@
 
 extern net_addr_t net_broadcast_addr;
 
+// Simulated network conditions: -netlatency <ms>, -netjitter <ms> and
+// -netloss <percent>.
+extern int net_sim_latency, net_sim_jitter, net_sim_loss;
+
+// Throw away the packets still held back by -netlatency.
+void NET_DropDelayedPackets(void);
+
 // Create a new network context.
 net_context_t *NET_NewContext(void);
 
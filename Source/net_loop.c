@@ -38,6 +38,10 @@ static packet_queue_t server_queue;
 static net_addr_t client_addr;
 static net_addr_t server_addr;
 
+// Traffic so far, for -netbench.
+
+net_loop_traffic_t net_loop_to_server, net_loop_to_client;
+
 static void QueueInit(packet_queue_t *queue)
 {
     queue->head = queue->tail = 0;
@@ -60,6 +64,15 @@ static void QueuePush(packet_queue_t *queue, net_packet_t *packet)
     queue->tail = new_tail;
 }
 
+static void SendLoop(packet_queue_t *queue, net_loop_traffic_t *traffic,
+                     net_packet_t *packet)
+{
+    ++traffic->packets;
+    traffic->bytes += packet->len;
+
+    QueuePush(queue, NET_PacketDup(packet));
+}
+
 static net_packet_t *QueuePop(packet_queue_t *queue)
 {
     net_packet_t *packet;
@@ -98,7 +111,7 @@ static boolean NET_CL_InitServer(void)
 
 static void NET_CL_SendPacket(net_addr_t *addr, net_packet_t *packet)
 {
-    QueuePush(&server_queue, NET_PacketDup(packet));
+    SendLoop(&server_queue, &net_loop_to_server, packet);
 }
 
 static boolean NET_CL_RecvPacket(net_addr_t **addr, net_packet_t **packet)
@@ -174,7 +187,7 @@ static boolean NET_SV_InitServer(void)
 
 static void NET_SV_SendPacket(net_addr_t *addr, net_packet_t *packet)
 {
-    QueuePush(&client_queue, NET_PacketDup(packet));
+    SendLoop(&client_queue, &net_loop_to_client, packet);
 }
 
 static boolean NET_SV_RecvPacket(net_addr_t **addr, net_packet_t **packet)
@@ -23,5 +23,13 @@
 extern net_module_t net_loop_client_module;
 extern net_module_t net_loop_server_module;
 
+typedef struct
+{
+    unsigned int packets;
+    unsigned int bytes;
+} net_loop_traffic_t;
+
+extern net_loop_traffic_t net_loop_to_server, net_loop_to_client;
+
 #endif /* #ifndef NET_LOOP_H */
 
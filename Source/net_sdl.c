@@ -222,6 +222,32 @@ static boolean NET_SDL_InitServer(void)
     return true;
 }
 
+boolean NET_SDL_WaitForPacket(int timeout)
+{
+    static SDLNet_SocketSet socketset;
+
+    if (udpsocket == NULL)
+    {
+        return false;
+    }
+
+    if (socketset == NULL)
+    {
+        socketset = SDLNet_AllocSocketSet(1);
+
+        if (socketset == NULL)
+        {
+            return false;
+        }
+
+        SDLNet_UDP_AddSocket(socketset, udpsocket);
+    }
+
+    SDLNet_CheckSockets(socketset, timeout);
+
+    return true;
+}
+
 static void NET_SDL_SendPacket(net_addr_t *addr, net_packet_t *packet)
 {
     UDPpacket sdl_packet;
@@ -22,5 +22,8 @@
 
 extern net_module_t net_sdl_module;
 
+// Wait up to timeout ms for a packet to arrive, false without a socket.
+boolean NET_SDL_WaitForPacket(int timeout);
+
 #endif /* #ifndef NET_SDL_H */
 
@@ -99,6 +99,14 @@ typedef struct
 
     unsigned int acknowledged;
 
+    // NET_PROTOCOL_WOOF_1: which tics of the send queue the client has,
+    // whether we owe it an acknowledgement of its own and when we last
+    // sent it game data.
+
+    net_sack_t sack;
+    boolean need_to_acknowledge;
+    unsigned int gamedata_send_time;
+
     // Value of max_players specified by the client on connect.
 
     int max_players;
@@ -165,6 +173,13 @@ static net_client_recv_t recvwindow[BACKUPTICS][NET_MAXPLAYERS];
 
 #define NET_SV_ExpandTicNum(b) NET_ExpandTicNum(recvwindow_start, (b))
 
+net_server_stats_t net_sv_stats;
+
+static boolean CompactGameData(net_client_t *client)
+{
+    return client->connection.protocol == NET_PROTOCOL_WOOF_1;
+}
+
 static void NET_SV_DisconnectClient(net_client_t *client)
 {
     if (client->active)
@@ -463,6 +478,39 @@ static unsigned int NET_SV_LatestAcknowledged(void)
 }
 
 
+// Note how far each client is behind on acknowledging our tics, and how
+// far ahead of the game its own tics have come in.
+
+static void SampleQueues(void)
+{
+    int i;
+
+    ++net_sv_stats.tics;
+
+    for (i=0; i<MAXNETNODES; ++i)
+    {
+        net_client_t *client = &clients[i];
+        unsigned int sendqueue, recvwindow;
+
+        if (!ClientConnected(client))
+        {
+            continue;
+        }
+
+        sendqueue = client->sendseq - client->acknowledged;
+        recvwindow = client->drone ? 0 :
+                     NET_SV_PlayerTics(client->player_number)
+                     - recvwindow_start;
+
+        ++net_sv_stats.samples;
+        net_sv_stats.sendqueue_total += sendqueue;
+        net_sv_stats.sendqueue_max = MAX(net_sv_stats.sendqueue_max, sendqueue);
+        net_sv_stats.recvwindow_total += recvwindow;
+        net_sv_stats.recvwindow_max = MAX(net_sv_stats.recvwindow_max,
+                                          recvwindow);
+    }
+}
+
 // Possibly advance the recv window if all connected clients have
 // used the data in the window
 
@@ -519,6 +567,8 @@ static void NET_SV_AdvanceWindow(void)
         memset(&recvwindow[BACKUPTICS-1], 0, sizeof(*recvwindow));
         ++recvwindow_start;
         NET_Log("server: advanced receive window to %d", recvwindow_start);
+
+        SampleQueues();
     }
 }
 
@@ -894,6 +944,9 @@ static void StartGame(void)
             continue;
 
         clients[i].last_gamedata_time = nowtime;
+        clients[i].gamedata_send_time = nowtime;
+        clients[i].need_to_acknowledge = false;
+        NET_SackInit(&clients[i].sack, sv_settings.extratics);
 
         startpacket = NET_Conn_NewReliable(&clients[i].connection,
                                            NET_PACKET_TYPE_GAMESTART);
@@ -1028,6 +1081,8 @@ static void NET_SV_SendResendRequest(net_client_t *client, int start, int end)
     NET_Conn_SendPacket(&client->connection, packet);
     NET_FreePacket(packet);
 
+    net_sv_stats.requested += end - start + 1;
+
     // Store the time we send the resend request
 
     nowtime = I_GetTimeMS();
@@ -1188,6 +1243,12 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
         }
 
         recvobj = &recvwindow[index][player];
+
+        if (recvobj->active)
+        {
+            ++net_sv_stats.duplicates;
+        }
+
         recvobj->active = true;
         recvobj->diff = diff;
         recvobj->latency = latency;
@@ -1255,6 +1316,91 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
     }
 }
 
+// Process compact game data from a client (NET_PROTOCOL_WOOF_1). The
+// client sends lost tics again on its own when it sees they are missing
+// from our acknowledgements, so no resend requests are needed.
+
+static void NET_SV_ParseCompactGameData(net_packet_t *packet,
+                                        net_client_t *client)
+{
+    net_compact_header_t header;
+    net_ticdiff_t diffs[NET_SACK_TICS];
+    unsigned int seq, ackseq;
+    unsigned int nowtime;
+    int i, num_diffs;
+    int index;
+
+    if (server_state != SERVER_IN_GAME)
+    {
+        NET_Log("server: error: not in game state: server_state=%d",
+                server_state);
+        return;
+    }
+
+    if (!NET_ReadCompactTicDiffs(packet, &header, diffs,
+                                 sv_settings.lowres_turn))
+    {
+        NET_Log("server: error: failed to read compact game data");
+        return;
+    }
+
+    ackseq = NET_SV_ExpandTicNum(header.ack);
+
+    if (ackseq > client->acknowledged)
+    {
+        NET_Log("server: acknowledged up to %d", ackseq);
+        client->acknowledged = ackseq;
+    }
+
+    NET_SackUpdate(&client->sack, ackseq, header.sack);
+
+    // Drones do not contribute any game data.
+
+    if (client->drone || !header.tics)
+    {
+        return;
+    }
+
+    nowtime = I_GetTimeMS();
+    seq = NET_SV_ExpandTicNum(header.start);
+
+    NET_Log("server: got compact game data, seq=%d, tics=0x%x, ackseq=%d",
+            seq, header.tics, ackseq);
+
+    for (i = num_diffs = 0; i < NET_SACK_TICS; ++i)
+    {
+        net_client_recv_t *recvobj;
+
+        if (!(header.tics & (1u << i)))
+        {
+            continue;
+        }
+
+        index = seq + i - recvwindow_start;
+        ++num_diffs;
+
+        if (index < 0 || index >= BACKUPTICS)
+        {
+            continue;
+        }
+
+        recvobj = &recvwindow[index][client->player_number];
+
+        if (recvobj->active)
+        {
+            ++net_sv_stats.duplicates;
+        }
+
+        recvobj->active = true;
+        recvobj->diff = diffs[num_diffs - 1];
+        recvobj->latency = header.latency;
+
+        client->last_gamedata_time = nowtime;
+    }
+
+    client->need_to_acknowledge = true;
+}
+
 static void NET_SV_ParseGameDataACK(net_packet_t *packet, net_client_t *client)
 {
     unsigned int ackseq;
@@ -1289,12 +1435,132 @@ static void NET_SV_ParseGameDataACK(net_packet_t *packet, net_client_t *client)
     }
 }
 
+// Send the tics in mask, counted from start, along with which of the
+// client's own tics we have. NET_PROTOCOL_WOOF_1 only.
+
+static void NET_SV_SendCompactTics(net_client_t *client,
+                                   unsigned int start, unsigned int mask)
+{
+    net_compact_header_t header;
+    net_full_ticcmd_t *cmds[NET_SACK_TICS];
+    net_packet_t *packet;
+    const unsigned int resends = client->sack.resends;
+    int i, num_cmds;
+
+    // Everything before the first tic missing from the client is in;
+    // recvwindow_start only moves on once all players' tics are.
+
+    header.ack = recvwindow_start;
+    header.sack = 0;
+
+    if (!client->drone)
+    {
+        for (i = 0; i < BACKUPTICS
+                 && recvwindow[i][client->player_number].active; ++i);
+
+        header.ack += i;
+
+        for (; i < BACKUPTICS && header.ack + NET_SACK_TICS > recvwindow_start + i; ++i)
+        {
+            if (recvwindow[i][client->player_number].active)
+            {
+                header.sack |= 1u << (recvwindow_start + i - header.ack);
+            }
+        }
+    }
+
+    header.ack &= 0xff;
+    header.start = start & 0xff;
+    header.tics = 0;
+    header.latency = 0;
+    num_cmds = 0;
+
+    for (i = 0; i < NET_SACK_TICS; ++i)
+    {
+        net_full_ticcmd_t *cmd;
+
+        cmd = &client->sendqueue[(start + i) % BACKUPTICS];
+
+        if ((mask & (1u << i)) && cmd->seq == start + i)
+        {
+            header.tics |= 1u << i;
+            cmds[num_cmds++] = cmd;
+            NET_SackSent(&client->sack, start + i);
+        }
+    }
+
+    packet = NET_NewPacket(64);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_COMPACT_GAMEDATA);
+    NET_WriteCompactFullTiccmds(packet, &header, cmds, sv_settings.lowres_turn);
+    NET_Conn_SendPacket(&client->connection, packet);
+    NET_FreePacket(packet);
+
+    net_sv_stats.resent += client->sack.resends - resends;
+    client->need_to_acknowledge = false;
+    client->gamedata_send_time = I_GetTimeMS();
+}
+
+// Send the client everything it is still missing from the send queue
+// and acknowledge what it sent us, all in one packet. Apart from when
+// there are new tics, this is done at most once a tic.
+
+static void NET_SV_SendCompactGameData(net_client_t *client, boolean newtics)
+{
+    unsigned int start, mask;
+    unsigned int i;
+    boolean urgent = newtics;
+
+    if (!newtics
+     && I_GetTimeMS() - client->gamedata_send_time < 1000 / TICRATE)
+    {
+        return;
+    }
+
+    start = client->sendseq;
+    mask = 0;
+
+    for (i = client->acknowledged; i < client->sendseq; ++i)
+    {
+        if (NET_SackWanted(&client->sack, i))
+        {
+            urgent |= !NET_SackRedundant(&client->sack, i);
+
+            if (!mask)
+            {
+                start = i;
+            }
+            else if (i - start >= NET_SACK_TICS)
+            {
+                break;
+            }
+
+            mask |= 1u << (i - start);
+        }
+    }
+
+    // Redundant copies and acknowledgements go along with the next new
+    // tic, unless it takes too long.
+
+    if ((mask && urgent)
+     || ((mask || client->need_to_acknowledge)
+      && I_GetTimeMS() - client->gamedata_send_time >= 2 * 1000 / TICRATE))
+    {
+        NET_SV_SendCompactTics(client, start, mask);
+    }
+}
+
 static void NET_SV_SendTics(net_client_t *client, 
                             unsigned int start, unsigned int end)
 {
     net_packet_t *packet;
     unsigned int i;
 
+    if (CompactGameData(client))
+    {
+        NET_SV_SendCompactTics(client, start, NET_TicRangeMask(start, end));
+        return;
+    }
+
     packet = NET_NewPacket(500);
 
     NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA);
@@ -1375,6 +1641,7 @@ static void NET_SV_ParseResendRequest(net_packet_t *packet, net_client_t *client
     // Resend those tics
     NET_Log("server: resending tics %d-%d", start, last);
     NET_SV_SendTics(client, start, last);
+    net_sv_stats.resent += num_tics;
 }
 
 // Send a response back to the client
@@ -1548,6 +1815,9 @@ static void NET_SV_Packet(net_packet_t *packet, net_addr_t *addr)
             case NET_PACKET_TYPE_GAMEDATA:
                 NET_SV_ParseGameData(packet, client);
                 break;
+            case NET_PACKET_TYPE_COMPACT_GAMEDATA:
+                NET_SV_ParseCompactGameData(packet, client);
+                break;
             case NET_PACKET_TYPE_GAMEDATA_ACK:
                 NET_SV_ParseGameDataACK(packet, client);
                 break;
@@ -1563,7 +1833,10 @@ static void NET_SV_Packet(net_packet_t *packet, net_addr_t *addr)
 }
 
 
-static void NET_SV_PumpSendQueue(net_client_t *client)
+// Generate the next tic for the client's send queue, if all the data
+// for it has come in. Returns true if it has.
+
+static boolean NET_SV_PumpSendQueue(net_client_t *client)
 {
     net_full_ticcmd_t cmd;
     int recv_index;
@@ -1576,7 +1849,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
 
     if (client->sendseq - NET_SV_LatestAcknowledged() > 40)
     {
-        return;
+        return false;
     }
     
     // Work out the index into the receive window
@@ -1585,7 +1858,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
 
     if (recv_index < 0 || recv_index >= BACKUPTICS)
     {
-        return;
+        return false;
     }
 
     // Check if we can generate a new entry for the send queue
@@ -1612,7 +1885,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
             // We do not have this player's ticcmd, so we cannot
             // generate a complete command yet.
 
-            return;
+            return false;
         }
 
         ++num_players;
@@ -1626,7 +1899,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
 
     if (num_players == 0 && client->sendseq > recvwindow_start + 10)
     {
-        return;
+        return false;
     }
 
     // We have all data we need to generate a command for this tic.
@@ -1671,6 +1944,15 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
 
     client->sendqueue[client->sendseq % BACKUPTICS] = cmd;
 
+    // With NET_PROTOCOL_WOOF_1, new tics go out together, see
+    // NET_SV_SendCompactGameData().
+
+    if (CompactGameData(client))
+    {
+        ++client->sendseq;
+        return true;
+    }
+
     // Transmit the new tic to the client
 
     starttic = client->sendseq - sv_settings.extratics;
@@ -1684,6 +1966,8 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
     NET_SV_SendTics(client, starttic, endtic);
 
     ++client->sendseq;
+
+    return true;
 }
 
 // Prevent against deadlock: resend requests are usually only
@@ -1746,6 +2030,7 @@ void NET_SV_CheckDeadlock(net_client_t *client)
             NET_Log("server: also resending tics %d-%d to break deadlock",
                     client->acknowledged, client->sendseq - 1);
             NET_SV_SendTics(client, client->acknowledged, client->sendseq - 1);
+            net_sv_stats.resent += client->sendseq - client->acknowledged;
         }
     }
 }
@@ -1841,7 +2126,22 @@ static void NET_SV_RunClient(net_client_t *client)
 
     if (server_state == SERVER_IN_GAME)
     {
-        NET_SV_PumpSendQueue(client);
+        if (CompactGameData(client))
+        {
+            boolean newtics = false;
+
+            while (NET_SV_PumpSendQueue(client))
+            {
+                newtics = true;
+            }
+
+            NET_SV_SendCompactGameData(client, newtics);
+        }
+        else
+        {
+            NET_SV_PumpSendQueue(client);
+        }
+
         NET_SV_CheckDeadlock(client);
     }
 }
@@ -1935,6 +2235,15 @@ void NET_SV_RegisterWithMaster(void)
     }
 }
 
+unsigned int NET_SV_PlayerTics(int player)
+{
+    int i;
+
+    for (i = 0; i < BACKUPTICS && recvwindow[i][player].active; ++i);
+
+    return recvwindow_start + i;
+}
+
 // Run server code to check for new packets/send packets as the server
 // requires
 
@@ -17,6 +17,24 @@
 #ifndef NET_SERVER_H
 #define NET_SERVER_H
 
+// Load statistics, for -netstats. The queue depths are sampled once a
+// tic for every client.
+
+typedef struct
+{
+    unsigned int tics;              // tics the game has moved on
+    unsigned int resent;            // tics sent to clients again
+    unsigned int requested;         // tics asked from clients again
+    unsigned int duplicates;        // tics received more than once
+    unsigned int samples;
+    unsigned int sendqueue_total;   // tics clients have yet to acknowledge
+    unsigned int sendqueue_max;
+    unsigned int recvwindow_total;  // tics received ahead of the game
+    unsigned int recvwindow_max;
+} net_server_stats_t;
+
+extern net_server_stats_t net_sv_stats;
+
 // initialize server and wait for connections
 
 void NET_SV_Init(void);
@@ -38,5 +56,9 @@ void NET_SV_AddModule(net_module_t *module);
 
 void NET_SV_RegisterWithMaster(void);
 
+// Tics received from a player so far, counting up to the first missing.
+
+unsigned int NET_SV_PlayerTics(int player);
+
 #endif /* #ifndef NET_SERVER_H */
 
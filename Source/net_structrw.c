@@ -20,6 +20,7 @@
 
 #include "doomtype.h"
 #include "i_system.h"
+#include "m_argv.h"
 #include "m_misc2.h"
 #include "net_packet.h"
 #include "net_structrw.h"
@@ -32,8 +33,13 @@ static struct
     const char *name;
 } protocol_names[] = {
     {NET_PROTOCOL_CHOCOLATE_DOOM_0, "CHOCOLATE_DOOM_0"},
+    {NET_PROTOCOL_WOOF_1,           "WOOF_1"},
 };
 
+// Newest protocol offered to or accepted from the other end.
+
+net_protocol_t net_max_protocol = NET_NUM_PROTOCOLS - 1;
+
 void NET_WriteConnectData(net_packet_t *packet, net_connect_data_t *data)
 {
     NET_WriteInt8(packet, data->gamemode);
@@ -478,6 +484,701 @@ void NET_WriteFullTiccmd(net_packet_t *packet, net_full_ticcmd_t *cmd, boolean l
     }
 }
 
+//
+// Compact game data (NET_PROTOCOL_WOOF_1)
+//
+// The body of a NET_PACKET_TYPE_COMPACT_GAMEDATA packet is a single
+// stream coded with an adaptive binary range coder, as in LZMA. The
+// models start over with every packet so that each packet can be decoded
+// on its own, and every ticcmd field is predicted from the last value
+// sent for the same player earlier in the packet.
+//
+
+#define RC_TOP       (1u << 24)
+#define RC_PROBBITS  11
+#define RC_PROBMAX   (1 << RC_PROBBITS)
+#define RC_MOVEBITS  4  // adapt fast, the streams are short
+
+// Probability of a 0 bit, out of RC_PROBMAX.
+typedef uint16_t rc_prob_t;
+
+typedef struct
+{
+    net_packet_t *packet;
+    uint64_t low;
+    uint32_t range;
+    uint32_t code;
+    int cachesize;
+    byte cache;
+    boolean first;
+    boolean error;
+} rangecoder_t;
+
+static void RC_InitEncoder(rangecoder_t *rc, net_packet_t *packet)
+{
+    memset(rc, 0, sizeof(*rc));
+    rc->packet = packet;
+    rc->range = 0xffffffff;
+    rc->cachesize = 1;
+    rc->first = true;
+}
+
+static void RC_ShiftLow(rangecoder_t *rc)
+{
+    if ((uint32_t) rc->low < 0xff000000 || (rc->low >> 32) != 0)
+    {
+        byte temp = rc->cache;
+
+        do
+        {
+            // The first byte is always zero, no need to send it.
+
+            if (!rc->first)
+            {
+                NET_WriteInt8(rc->packet, (byte) (temp + (rc->low >> 32)));
+            }
+
+            rc->first = false;
+            temp = 0xff;
+        } while (--rc->cachesize != 0);
+
+        rc->cache = (byte) (rc->low >> 24);
+    }
+
+    rc->cachesize++;
+    rc->low = (rc->low & 0x00ffffff) << 8;
+}
+
+static void RC_EncodeBit(rangecoder_t *rc, rc_prob_t *prob, int bit)
+{
+    const uint32_t bound = (rc->range >> RC_PROBBITS) * *prob;
+
+    if (!bit)
+    {
+        rc->range = bound;
+        *prob += (RC_PROBMAX - *prob) >> RC_MOVEBITS;
+    }
+    else
+    {
+        rc->low += bound;
+        rc->range -= bound;
+        *prob -= *prob >> RC_MOVEBITS;
+    }
+
+    while (rc->range < RC_TOP)
+    {
+        rc->range <<= 8;
+        RC_ShiftLow(rc);
+    }
+}
+
+// The low bits of value, without a model.
+
+static void RC_EncodeDirect(rangecoder_t *rc, unsigned int value, int bits)
+{
+    while (--bits >= 0)
+    {
+        rc->range >>= 1;
+
+        if ((value >> bits) & 1)
+        {
+            rc->low += rc->range;
+        }
+
+        while (rc->range < RC_TOP)
+        {
+            rc->range <<= 8;
+            RC_ShiftLow(rc);
+        }
+    }
+}
+
+static void RC_Flush(rangecoder_t *rc)
+{
+    int i;
+
+    for (i = 0; i < 5; ++i)
+    {
+        RC_ShiftLow(rc);
+    }
+}
+
+static byte RC_ReadByte(rangecoder_t *rc)
+{
+    unsigned int b;
+
+    if (!NET_ReadInt8(rc->packet, &b))
+    {
+        rc->error = true;
+        return 0;
+    }
+
+    return b;
+}
+
+static void RC_InitDecoder(rangecoder_t *rc, net_packet_t *packet)
+{
+    int i;
+
+    memset(rc, 0, sizeof(*rc));
+    rc->packet = packet;
+    rc->range = 0xffffffff;
+
+    for (i = 0; i < 4; ++i)
+    {
+        rc->code = (rc->code << 8) | RC_ReadByte(rc);
+    }
+}
+
+static int RC_DecodeBit(rangecoder_t *rc, rc_prob_t *prob)
+{
+    const uint32_t bound = (rc->range >> RC_PROBBITS) * *prob;
+    int bit;
+
+    if (rc->code < bound)
+    {
+        rc->range = bound;
+        *prob += (RC_PROBMAX - *prob) >> RC_MOVEBITS;
+        bit = 0;
+    }
+    else
+    {
+        rc->code -= bound;
+        rc->range -= bound;
+        *prob -= *prob >> RC_MOVEBITS;
+        bit = 1;
+    }
+
+    while (rc->range < RC_TOP)
+    {
+        rc->range <<= 8;
+        rc->code = (rc->code << 8) | RC_ReadByte(rc);
+    }
+
+    return bit;
+}
+
+static unsigned int RC_DecodeDirect(rangecoder_t *rc, int bits)
+{
+    unsigned int value = 0;
+
+    while (--bits >= 0)
+    {
+        rc->range >>= 1;
+        value <<= 1;
+
+        if (rc->code >= rc->range)
+        {
+            rc->code -= rc->range;
+            value |= 1;
+        }
+
+        while (rc->range < RC_TOP)
+        {
+            rc->range <<= 8;
+            rc->code = (rc->code << 8) | RC_ReadByte(rc);
+        }
+    }
+
+    return value;
+}
+
+// Signed values up to 16 bits: whether it is zero, the sign, the number
+// of bits in unary and then the bits below the leading one.
+
+typedef struct
+{
+    rc_prob_t zero;
+    rc_prob_t sign;
+    rc_prob_t length[16];
+} rc_value_t;
+
+static void RC_EncodeValue(rangecoder_t *rc, rc_value_t *model, int value)
+{
+    unsigned int m;
+    int n;
+
+    RC_EncodeBit(rc, &model->zero, value != 0);
+
+    if (value == 0)
+    {
+        return;
+    }
+
+    RC_EncodeBit(rc, &model->sign, value < 0);
+    m = value < 0 ? -value : value;
+
+    for (n = 1; n < 16 && (m >> n) != 0; ++n)
+    {
+        RC_EncodeBit(rc, &model->length[n - 1], 1);
+    }
+
+    if (n < 16)
+    {
+        RC_EncodeBit(rc, &model->length[n - 1], 0);
+    }
+
+    RC_EncodeDirect(rc, m, n - 1);
+}
+
+static int RC_DecodeValue(rangecoder_t *rc, rc_value_t *model)
+{
+    boolean negative;
+    unsigned int m;
+    int n;
+
+    if (!RC_DecodeBit(rc, &model->zero))
+    {
+        return 0;
+    }
+
+    negative = RC_DecodeBit(rc, &model->sign);
+
+    for (n = 1; n < 16 && RC_DecodeBit(rc, &model->length[n - 1]); ++n);
+
+    m = (1u << (n - 1)) | RC_DecodeDirect(rc, n - 1);
+
+    return negative ? -(int) m : (int) m;
+}
+
+// Tic bitmaps: the position of the highest bit set, then the bits below.
+
+typedef struct
+{
+    rc_value_t top;
+    rc_prob_t bit;
+} rc_mask_t;
+
+static void RC_EncodeMask(rangecoder_t *rc, rc_mask_t *model, unsigned int mask)
+{
+    int top, i;
+
+    for (top = 0; top < 32 && (mask >> top) != 0; ++top);
+
+    RC_EncodeValue(rc, &model->top, top);
+
+    for (i = 0; i < top - 1; ++i)
+    {
+        RC_EncodeBit(rc, &model->bit, (mask >> i) & 1);
+    }
+}
+
+static unsigned int RC_DecodeMask(rangecoder_t *rc, rc_mask_t *model)
+{
+    unsigned int mask;
+    int top, i;
+
+    top = RC_DecodeValue(rc, &model->top);
+
+    if (top <= 0 || top > 32)
+    {
+        rc->error |= top != 0;
+        return 0;
+    }
+
+    mask = 1u << (top - 1);
+
+    for (i = 0; i < top - 1; ++i)
+    {
+        if (RC_DecodeBit(rc, &model->bit))
+        {
+            mask |= 1u << i;
+        }
+    }
+
+    return mask;
+}
+
+// The fields of a ticcmd diff, in the order they are coded.
+
+static const unsigned int ticdiff_fields[] =
+{
+    NET_TICDIFF_FORWARD,
+    NET_TICDIFF_SIDE,
+    NET_TICDIFF_TURN,
+    NET_TICDIFF_BUTTONS,
+    NET_TICDIFF_CONSISTANCY,
+    NET_TICDIFF_CHATCHAR,
+};
+
+#define NUMFIELDS arrlen(ticdiff_fields)
+
+typedef struct
+{
+    // Whether a field changed, by whether it did in the last tic.
+
+    rc_prob_t changed[NUMFIELDS][2];
+
+    rc_value_t forward, side, turn, latency;
+    rc_prob_t buttons[8];
+    rc_prob_t same_players;
+    rc_mask_t sack, tics;
+
+    // What was sent last for each player.
+
+    net_ticdiff_t last[NET_MAXPLAYERS];
+    unsigned int playeringame;
+} ticmodel_t;
+
+static void InitModel(ticmodel_t *model)
+{
+    rc_prob_t *prob = (rc_prob_t *) model;
+    int i;
+
+    memset(model, 0, sizeof(*model));
+
+    // Everything up to the predictions is a probability.
+
+    for (i = 0; i < offsetof(ticmodel_t, last) / sizeof(*prob); ++i)
+    {
+        prob[i] = RC_PROBMAX / 2;
+    }
+
+    // Most fields do not change from one tic to the next, and neither
+    // do the buttons or the players in the game.
+
+    for (i = 0; i < NUMFIELDS; ++i)
+    {
+        model->changed[i][0] = RC_PROBMAX * 7 / 8;
+    }
+
+    for (i = 0; i < 8; ++i)
+    {
+        model->buttons[i] = RC_PROBMAX * 7 / 8;
+    }
+
+    model->same_players = RC_PROBMAX / 8;
+}
+
+static void EncodeHeader(rangecoder_t *rc, ticmodel_t *model,
+                         net_compact_header_t *header)
+{
+    RC_EncodeDirect(rc, header->ack, 8);
+    RC_EncodeMask(rc, &model->sack, header->sack);
+    RC_EncodeMask(rc, &model->tics, header->tics);
+
+    if (header->tics != 0)
+    {
+        RC_EncodeDirect(rc, header->start, 8);
+    }
+}
+
+static void DecodeHeader(rangecoder_t *rc, ticmodel_t *model,
+                         net_compact_header_t *header)
+{
+    header->ack = RC_DecodeDirect(rc, 8);
+    header->sack = RC_DecodeMask(rc, &model->sack);
+    header->tics = RC_DecodeMask(rc, &model->tics);
+    header->start = header->tics != 0 ? RC_DecodeDirect(rc, 8) : 0;
+    header->latency = 0;
+}
+
+static void EncodeTicDiff(rangecoder_t *rc, ticmodel_t *model,
+                          net_ticdiff_t *last, net_ticdiff_t *diff,
+                          boolean lowres_turn)
+{
+    int i;
+
+    for (i = 0; i < NUMFIELDS; ++i)
+    {
+        RC_EncodeBit(rc, &model->changed[i][(last->diff & ticdiff_fields[i]) != 0],
+                     (diff->diff & ticdiff_fields[i]) != 0);
+    }
+
+    // Keep what the other end will decode as the prediction, lowres_turn
+    // drops the low byte of angleturn.
+
+    if (diff->diff & NET_TICDIFF_FORWARD)
+    {
+        RC_EncodeValue(rc, &model->forward, (signed char)
+                       (diff->cmd.forwardmove - last->cmd.forwardmove));
+        last->cmd.forwardmove = diff->cmd.forwardmove;
+    }
+
+    if (diff->diff & NET_TICDIFF_SIDE)
+    {
+        RC_EncodeValue(rc, &model->side, (signed char)
+                       (diff->cmd.sidemove - last->cmd.sidemove));
+        last->cmd.sidemove = diff->cmd.sidemove;
+    }
+
+    if (diff->diff & NET_TICDIFF_TURN)
+    {
+        if (lowres_turn)
+        {
+            const int turn = diff->cmd.angleturn / 256;
+
+            RC_EncodeValue(rc, &model->turn, (signed char)
+                           (turn - last->cmd.angleturn / 256));
+            last->cmd.angleturn = turn * 256;
+        }
+        else
+        {
+            RC_EncodeValue(rc, &model->turn, (short)
+                           (diff->cmd.angleturn - last->cmd.angleturn));
+            last->cmd.angleturn = diff->cmd.angleturn;
+        }
+    }
+
+    if (diff->diff & NET_TICDIFF_BUTTONS)
+    {
+        const unsigned int flipped = diff->cmd.buttons ^ last->cmd.buttons;
+
+        for (i = 0; i < 8; ++i)
+        {
+            RC_EncodeBit(rc, &model->buttons[i], (flipped >> i) & 1);
+        }
+
+        last->cmd.buttons = diff->cmd.buttons;
+    }
+
+    if (diff->diff & NET_TICDIFF_CONSISTANCY)
+    {
+        RC_EncodeDirect(rc, diff->cmd.consistancy, 8);
+    }
+
+    if (diff->diff & NET_TICDIFF_CHATCHAR)
+    {
+        RC_EncodeDirect(rc, diff->cmd.chatchar, 8);
+    }
+
+    last->diff = diff->diff;
+}
+
+static void DecodeTicDiff(rangecoder_t *rc, ticmodel_t *model,
+                          net_ticdiff_t *last, net_ticdiff_t *diff,
+                          boolean lowres_turn)
+{
+    int i;
+
+    diff->diff = 0;
+
+    for (i = 0; i < NUMFIELDS; ++i)
+    {
+        if (RC_DecodeBit(rc, &model->changed[i][(last->diff & ticdiff_fields[i]) != 0]))
+        {
+            diff->diff |= ticdiff_fields[i];
+        }
+    }
+
+    if (diff->diff & NET_TICDIFF_FORWARD)
+    {
+        last->cmd.forwardmove += RC_DecodeValue(rc, &model->forward);
+        diff->cmd.forwardmove = last->cmd.forwardmove;
+    }
+
+    if (diff->diff & NET_TICDIFF_SIDE)
+    {
+        last->cmd.sidemove += RC_DecodeValue(rc, &model->side);
+        diff->cmd.sidemove = last->cmd.sidemove;
+    }
+
+    if (diff->diff & NET_TICDIFF_TURN)
+    {
+        if (lowres_turn)
+        {
+            const signed char turn = last->cmd.angleturn / 256
+                                   + RC_DecodeValue(rc, &model->turn);
+
+            last->cmd.angleturn = turn * 256;
+        }
+        else
+        {
+            last->cmd.angleturn += RC_DecodeValue(rc, &model->turn);
+        }
+
+        diff->cmd.angleturn = last->cmd.angleturn;
+    }
+
+    if (diff->diff & NET_TICDIFF_BUTTONS)
+    {
+        for (i = 0; i < 8; ++i)
+        {
+            if (RC_DecodeBit(rc, &model->buttons[i]))
+            {
+                last->cmd.buttons ^= 1 << i;
+            }
+        }
+
+        diff->cmd.buttons = last->cmd.buttons;
+    }
+
+    if (diff->diff & NET_TICDIFF_CONSISTANCY)
+    {
+        diff->cmd.consistancy = RC_DecodeDirect(rc, 8);
+    }
+
+    if (diff->diff & NET_TICDIFF_CHATCHAR)
+    {
+        diff->cmd.chatchar = RC_DecodeDirect(rc, 8);
+    }
+
+    last->diff = diff->diff;
+}
+
+static int CountTics(unsigned int tics)
+{
+    int count = 0;
+
+    for (; tics != 0; tics &= tics - 1)
+    {
+        ++count;
+    }
+
+    return count;
+}
+
+// Client to server: the ticcmd diffs of the local player, diffs[] holds
+// one for every bit set in header->tics.
+
+void NET_WriteCompactTicDiffs(net_packet_t *packet,
+                              net_compact_header_t *header,
+                              net_ticdiff_t **diffs, boolean lowres_turn)
+{
+    ticmodel_t model;
+    rangecoder_t rc;
+    int i;
+
+    InitModel(&model);
+    RC_InitEncoder(&rc, packet);
+
+    EncodeHeader(&rc, &model, header);
+
+    if (header->tics != 0)
+    {
+        RC_EncodeValue(&rc, &model.latency, (short) header->latency);
+    }
+
+    for (i = CountTics(header->tics); --i >= 0; ++diffs)
+    {
+        EncodeTicDiff(&rc, &model, &model.last[0], *diffs, lowres_turn);
+    }
+
+    RC_Flush(&rc);
+}
+
+boolean NET_ReadCompactTicDiffs(net_packet_t *packet,
+                                net_compact_header_t *header,
+                                net_ticdiff_t *diffs, boolean lowres_turn)
+{
+    ticmodel_t model;
+    rangecoder_t rc;
+    int i;
+
+    InitModel(&model);
+    RC_InitDecoder(&rc, packet);
+
+    DecodeHeader(&rc, &model, header);
+
+    if (header->tics != 0)
+    {
+        header->latency = RC_DecodeValue(&rc, &model.latency);
+    }
+
+    for (i = CountTics(header->tics); --i >= 0 && !rc.error; ++diffs)
+    {
+        DecodeTicDiff(&rc, &model, &model.last[0], diffs, lowres_turn);
+    }
+
+    return !rc.error;
+}
+
+// Server to client: complete sets of ticcmds, one for every bit set in
+// header->tics.
+
+void NET_WriteCompactFullTiccmds(net_packet_t *packet,
+                                 net_compact_header_t *header,
+                                 net_full_ticcmd_t **cmds,
+                                 boolean lowres_turn)
+{
+    ticmodel_t model;
+    rangecoder_t rc;
+    int latency = 0;
+    int i, j;
+
+    InitModel(&model);
+    RC_InitEncoder(&rc, packet);
+
+    EncodeHeader(&rc, &model, header);
+
+    for (i = CountTics(header->tics); --i >= 0; ++cmds)
+    {
+        net_full_ticcmd_t *cmd = *cmds;
+        unsigned int playeringame = 0;
+
+        RC_EncodeValue(&rc, &model.latency, (short) (cmd->latency - latency));
+        latency = cmd->latency;
+
+        for (j = 0; j < NET_MAXPLAYERS; ++j)
+        {
+            if (cmd->playeringame[j])
+            {
+                playeringame |= 1 << j;
+            }
+        }
+
+        RC_EncodeBit(&rc, &model.same_players,
+                     playeringame != model.playeringame);
+
+        if (playeringame != model.playeringame)
+        {
+            RC_EncodeDirect(&rc, playeringame, NET_MAXPLAYERS);
+            model.playeringame = playeringame;
+        }
+
+        for (j = 0; j < NET_MAXPLAYERS; ++j)
+        {
+            if (cmd->playeringame[j])
+            {
+                EncodeTicDiff(&rc, &model, &model.last[j], &cmd->cmds[j],
+                              lowres_turn);
+            }
+        }
+    }
+
+    RC_Flush(&rc);
+}
+
+boolean NET_ReadCompactFullTiccmds(net_packet_t *packet,
+                                   net_compact_header_t *header,
+                                   net_full_ticcmd_t *cmds,
+                                   boolean lowres_turn)
+{
+    ticmodel_t model;
+    rangecoder_t rc;
+    int latency = 0;
+    int i, j;
+
+    InitModel(&model);
+    RC_InitDecoder(&rc, packet);
+
+    DecodeHeader(&rc, &model, header);
+
+    for (i = CountTics(header->tics); --i >= 0 && !rc.error; ++cmds)
+    {
+        latency = (short) (latency + RC_DecodeValue(&rc, &model.latency));
+        cmds->latency = latency;
+
+        if (RC_DecodeBit(&rc, &model.same_players))
+        {
+            model.playeringame = RC_DecodeDirect(&rc, NET_MAXPLAYERS);
+        }
+
+        for (j = 0; j < NET_MAXPLAYERS; ++j)
+        {
+            cmds->playeringame[j] = (model.playeringame & (1 << j)) != 0;
+
+            if (cmds->playeringame[j])
+            {
+                DecodeTicDiff(&rc, &model, &model.last[j], &cmds->cmds[j],
+                              lowres_turn);
+            }
+        }
+    }
+
+    return !rc.error;
+}
+
 void NET_WriteWaitData(net_packet_t *packet, net_waitdata_t *data)
 {
     int i;
@@ -589,13 +1290,26 @@ void NET_WritePRNGSeed(net_packet_t *packet, prng_seed_t seed)
     NET_WriteBlob(packet, seed, sizeof(prng_seed_t));
 }
 */
+// -oldprotocol sticks to the Chocolate Doom protocol.
+
+static net_protocol_t MaxProtocol(void)
+{
+    if (M_CheckParm("-oldprotocol") > 0)
+    {
+        return NET_PROTOCOL_CHOCOLATE_DOOM_0;
+    }
+
+    return net_max_protocol;
+}
+
 static net_protocol_t ParseProtocolName(const char *name)
 {
     int i;
 
     for (i = 0; i < arrlen(protocol_names); ++i)
     {
-        if (!strcmp(protocol_names[i].name, name))
+        if (!strcmp(protocol_names[i].name, name)
+         && protocol_names[i].protocol <= MaxProtocol())
         {
             return protocol_names[i].protocol;
         }
@@ -685,11 +1399,12 @@ net_protocol_t NET_ReadProtocolList(net_packet_t *packet)
 // protocols is always sent.
 void NET_WriteProtocolList(net_packet_t *packet)
 {
+    const net_protocol_t max = MaxProtocol();
     int i;
 
-    NET_WriteInt8(packet, NET_NUM_PROTOCOLS);
+    NET_WriteInt8(packet, max + 1);
 
-    for (i = 0; i < NET_NUM_PROTOCOLS; ++i)
+    for (i = 0; i <= max; ++i)
     {
         NET_WriteProtocol(packet, i);
     }
@@ -36,6 +36,11 @@ extern void NET_TiccmdPatch(ticcmd_t *src, net_ticdiff_t *diff, ticcmd_t *dest);
 boolean NET_ReadFullTiccmd(net_packet_t *packet, net_full_ticcmd_t *cmd, boolean lowres_turn);
 void NET_WriteFullTiccmd(net_packet_t *packet, net_full_ticcmd_t *cmd, boolean lowres_turn);
 
+void NET_WriteCompactTicDiffs(net_packet_t *packet, net_compact_header_t *header, net_ticdiff_t **diffs, boolean lowres_turn);
+boolean NET_ReadCompactTicDiffs(net_packet_t *packet, net_compact_header_t *header, net_ticdiff_t *diffs, boolean lowres_turn);
+void NET_WriteCompactFullTiccmds(net_packet_t *packet, net_compact_header_t *header, net_full_ticcmd_t **cmds, boolean lowres_turn);
+boolean NET_ReadCompactFullTiccmds(net_packet_t *packet, net_compact_header_t *header, net_full_ticcmd_t *cmds, boolean lowres_turn);
+
 boolean NET_ReadSHA1Sum(net_packet_t *packet, sha1_digest_t digest);
 void NET_WriteSHA1Sum(net_packet_t *packet, sha1_digest_t digest);
 
@@ -46,6 +51,7 @@ boolean NET_ReadWaitData(net_packet_t *packet, net_waitdata_t *data);
 //void NET_WritePRNGSeed(net_packet_t *packet, prng_seed_t seed);
 
 // Protocol list exchange.
+extern net_protocol_t net_max_protocol;
 net_protocol_t NET_ReadProtocol(net_packet_t *packet);
 void NET_WriteProtocol(net_packet_t *packet, net_protocol_t protocol);
 net_protocol_t NET_ReadProtocolList(net_packet_t *packet);
@@ -923,25 +923,29 @@ static boolean P_LookForMonsters(mobj_t *actor, boolean allaround)
       int y = (actor->y - bmaporgy)>>MAPBLOCKSHIFT;
       int d;
 
+      // Only things which PIT_FindTarget may accept are visited, in
+      // the same order as with P_BlockThingsIterator.
+      boolean friends = !(actor->flags & MF_FRIEND);
+
       current_actor = actor;
       current_allaround = allaround;
 
       // Search first in the immediate vicinity.
 
-      if (!P_BlockThingsIterator(x, y, PIT_FindTarget))
+      if (!P_BlockTargetsIterator(x, y, friends, PIT_FindTarget))
 	return true;
 
       for (d=1; d<5; d++)
 	{
 	  int i = 1 - d;
 	  do
-	    if (!P_BlockThingsIterator(x+i, y-d, PIT_FindTarget) ||
-		!P_BlockThingsIterator(x+i, y+d, PIT_FindTarget))
+	    if (!P_BlockTargetsIterator(x+i, y-d, friends, PIT_FindTarget) ||
+		!P_BlockTargetsIterator(x+i, y+d, friends, PIT_FindTarget))
 	      return true;
 	  while (++i < d);
 	  do
-	    if (!P_BlockThingsIterator(x-d, y+i, PIT_FindTarget) ||
-		!P_BlockThingsIterator(x+d, y+i, PIT_FindTarget))
+	    if (!P_BlockTargetsIterator(x-d, y+i, friends, PIT_FindTarget) ||
+		!P_BlockTargetsIterator(x+d, y+i, friends, PIT_FindTarget))
 	      return true;
 	  while (--i + d >= 0);
 	}
@@ -2676,6 +2680,7 @@ void A_Spawn(mobj_t *mo)
       if (comp[comp_friendlyspawn])
       {
       newmobj->flags = (newmobj->flags & ~MF_FRIEND) | (mo->flags & MF_FRIEND);
+      P_UpdateTargetLink(newmobj);
       }
     }
 }
@@ -3196,6 +3201,8 @@ void A_AddFlags(mobj_t* actor)
 
   actor->flags  |= flags;
   actor->flags2 |= flags2;
+
+  P_UpdateTargetLink(actor);
 }
 
 //
@@ -3216,6 +3223,8 @@ void A_RemoveFlags(mobj_t* actor)
 
   actor->flags  &= ~flags;
   actor->flags2 &= ~flags2;
+
+  P_UpdateTargetLink(actor);
 }
 
 //----------------------------------------------------------------------------
@@ -72,6 +72,9 @@ result_e T_MovePlane
 
   sector->oldgametic = gametic;
 
+  // cached sight checks may cross this sector
+  P_ClearSightCache();
+
   switch(floorOrCeiling)
   {
     case 0:
@@ -51,6 +51,7 @@ boolean P_TryMove(mobj_t *thing, fixed_t x, fixed_t y, boolean dropoff);
 boolean P_TeleportMove(mobj_t *thing, fixed_t x, fixed_t y,boolean boss);
 void    P_SlideMove(mobj_t *mo);
 boolean P_CheckSight(mobj_t *t1, mobj_t *t2);
+void    P_ClearSightCache(void);
 boolean P_CheckFov(mobj_t *t1, mobj_t *t2, angle_t fov);
 void    P_UseLines(player_t *player);
 
@@ -83,6 +84,9 @@ extern msecnode_t *sector_list;                             // phares 3/16/98
 extern fixed_t tmbbox[4];         // phares 3/20/98
 extern line_t *blockline;   // killough 8/11/98
 
+// sight checks and how many of them were answered from the cache
+extern unsigned int sight_checks, sight_hits;
+
 #endif // __P_MAP__
 
 //----------------------------------------------------------------------------
@@ -209,6 +209,70 @@ void P_LineOpening(line_t *linedef)
 // On each position change, BLOCKMAP and other
 // lookups maintaining lists ot things inside
 // these structures need to be updated.
+
+//
+// Target links
+//
+// Things which may become targets of MBF friends and enemies (see
+// PIT_FindTarget) are kept in a second chain per block, separately for
+// friends and enemies. Each chain holds its things in the same order as
+// the block links, so searching it visits the candidates in the same
+// order as P_BlockThingsIterator would.
+//
+
+static mobj_t **P_TargetChain(mobj_t *thing)
+{
+  if (!(thing->flags & MF_COUNTKILL || thing->type == MT_SKULL))
+    return NULL;
+
+  return &targetlinks[(thing->flags & MF_FRIEND ? bmapwidth*bmapheight : 0) +
+                      thing->tblock - 1];
+}
+
+static void P_UnlinkTarget(mobj_t *thing)
+{
+  mobj_t *tnext, **tprev = thing->tprev;
+
+  if (tprev && (*tprev = tnext = thing->tnext))
+    tnext->tprev = tprev;
+  thing->tprev = NULL;
+}
+
+//
+// P_UpdateTargetLink
+//
+// Move a thing to the right target chain after a change of its
+// MF_FRIEND or MF_COUNTKILL flags.
+//
+
+void P_UpdateTargetLink(mobj_t *thing)
+{
+  mobj_t **link, *next;
+
+  if (!thing->tblock)
+    return;
+
+  P_UnlinkTarget(thing);
+
+  if (!(link = P_TargetChain(thing)))
+    return;
+
+  // insert in front of the next thing in the block which is in this chain
+  for (next = thing->bnext; next; next = next->bnext)
+    if (next->tprev && P_TargetChain(next) == link)
+      break;
+
+  if (next)
+    link = next->tprev;
+  else
+    while (*link)
+      link = &(*link)->tnext;
+
+  if ((thing->tnext = *link))
+    thing->tnext->tprev = &thing->tnext;
+  thing->tprev = link;
+  *link = thing;
+}
 //
 
 void P_UnsetThingPosition (mobj_t *thing)
@@ -257,6 +321,9 @@ void P_UnsetThingPosition (mobj_t *thing)
       mobj_t *bnext, **bprev = thing->bprev;
       if (bprev && (*bprev = bnext = thing->bnext))  // unlink from block map
 	bnext->bprev = bprev;
+
+      P_UnlinkTarget(thing);
+      thing->tblock = 0;
     }
 }
 
@@ -322,9 +389,23 @@ void P_SetThingPosition(mobj_t *thing)
 	    bnext->bprev = &thing->bnext;
 	  thing->bprev = link;
           *link = thing;
+
+          // link into the target chain of the block
+          thing->tblock = blocky*bmapwidth+blockx + 1;
+          thing->tprev = NULL;
+          if ((link = P_TargetChain(thing)))
+            {
+              if ((thing->tnext = *link))
+                thing->tnext->tprev = &thing->tnext;
+              thing->tprev = link;
+              *link = thing;
+            }
         }
       else        // thing is off the map
-        thing->bnext = NULL, thing->bprev = NULL;
+        {
+          thing->bnext = NULL, thing->bprev = NULL;
+          thing->tprev = NULL, thing->tblock = 0;
+        }
     }
 }
 
@@ -429,6 +510,25 @@ boolean P_BlockThingsIterator(int x, int y, boolean func(mobj_t*))
   return true;
 }
 
+//
+// P_BlockTargetsIterator
+//
+// Like P_BlockThingsIterator, but only visits the things in the block
+// which may be targets, either only friends or only enemies.
+//
+
+boolean P_BlockTargetsIterator(int x, int y, boolean friends,
+                               boolean func(mobj_t*))
+{
+  mobj_t *mobj;
+  if (!(x<0 || y<0 || x>=bmapwidth || y>=bmapheight))
+    for (mobj = targetlinks[(friends ? bmapwidth*bmapheight : 0) +
+                            y*bmapwidth+x]; mobj; mobj = mobj->tnext)
+      if (!func(mobj))
+        return false;
+  return true;
+}
+
 //
 // INTERCEPT ROUTINES
 //
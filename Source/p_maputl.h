@@ -69,8 +69,11 @@ int     P_BoxOnLineSide (fixed_t *tmbox, line_t *ld);
 void    P_LineOpening (line_t *linedef);
 void    P_UnsetThingPosition(mobj_t *thing);
 void    P_SetThingPosition(mobj_t *thing);
+void    P_UpdateTargetLink(mobj_t *thing);
 boolean P_BlockLinesIterator (int x, int y, boolean func(line_t *));
 boolean P_BlockThingsIterator(int x, int y, boolean func(mobj_t *));
+boolean P_BlockTargetsIterator(int x, int y, boolean friends,
+                               boolean func(mobj_t *));
 boolean ThingIsOnLine(mobj_t *t, line_t *l);  // killough 3/15/98
 boolean P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
                        int flags, boolean trav(intercept_t *));
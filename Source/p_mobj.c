@@ -666,6 +666,7 @@ void P_NightmareRespawn(mobj_t* mobj)
 
   // killough 11/98: transfer friendliness from deceased
   mo->flags = (mo->flags & ~MF_FRIEND) | (mobj->flags & MF_FRIEND);
+  P_UpdateTargetLink(mo);
 
   // [crispy] count respawned monsters
   if (!(mo->flags & MF_FRIEND))
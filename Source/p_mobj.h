@@ -281,6 +281,12 @@ typedef struct mobj_s
     // Links in blocks (if needed).
     struct mobj_s*      bnext;
     struct mobj_s**     bprev; // killough 8/11/98: change to ptr-to-ptr
+
+    // Links among the possible monster targets in the same block, in the
+    // same order as the block links.
+    struct mobj_s*      tnext;
+    struct mobj_s**     tprev;
+    int                 tblock; // block number + 1 while in the blockmap
     
     struct subsector_s* subsector;
 
@@ -0,0 +1,390 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Background loader staging the next level during the intermission.
+//
+//      While the tally screen is up, a thread of its own reads the map
+//      lumps of the next level, the flats and texture patches they refer
+//      to and the sprites of their things into memory taken from the libc
+//      heap, and composes the wall textures. Neither the zone nor the lump
+//      cache are thread-safe, so all of this is only handed over to them
+//      by the main thread once P_SetupLevel() gets to the level.
+//
+
+#include "doomstat.h"
+#include "doomdata.h"
+#include "i_system.h"
+#include "i_thread.h"
+#include "info.h"
+#include "m_swap.h"
+#include "r_data.h"
+#include "r_state.h"
+#include "w_wad.h"
+#include "z_zone.h"
+#include "p_preload.h"
+
+int preload_level;
+
+extern int numtextures;
+
+typedef struct
+{
+  int lump;
+  byte *data;
+} staged_t;
+
+typedef struct
+{
+  int texnum;
+  byte *data;     // both composites, see R_ComposeTexture()
+} composed_t;
+
+static struct
+{
+  i_thread_t *thread;
+  volatile boolean cancel;
+  int lumpnum;                // map marker lump, -1 while idle
+  const byte **lumpdata;      // per lump: staged, mapped or predefined data
+  staged_t *staged;
+  int numstaged, maxstaged;
+  int maplumps;               // staged[0..maplumps-1] belong to the map
+  composed_t *composed;
+  int numcomposed;
+  int warmed;                 // mapped lumps only faulted in
+  size_t bytes;
+  int loadtime;               // ms the loader has been busy
+  int waittime;               // ms the level setup had to wait for it
+} preload = { NULL, false, -1 };
+
+//
+// The loader thread
+//
+
+// Makes the data of a lump available to the loader. Mapped lumps are
+// handed out as they are by W_CacheLumpNum(), so touching their pages is
+// all that needs to be done about them.
+
+static const byte *StageLump(int lump)
+{
+  const lumpinfo_t *l;
+  byte *data;
+
+  if (lump < 0 || lump >= numlumps || preload.cancel)
+    return NULL;
+
+  if (preload.lumpdata[lump])
+    return preload.lumpdata[lump];
+
+  l = &lumpinfo[lump];
+
+  if (l->size <= 0)
+    return NULL;
+
+  if (l->data)
+    return preload.lumpdata[lump] = l->data;
+
+  if (l->mapped && !(l->position & (sizeof(int)-1)))
+  {
+    const volatile byte *p = l->mapped;
+    int i;
+
+    for (i = 0; i < l->size; i += 4096)
+      (void) p[i];
+
+    preload.warmed++;
+    return preload.lumpdata[lump] = l->mapped;
+  }
+
+  if (preload.numstaged == preload.maxstaged)
+  {
+    int max = preload.maxstaged ? preload.maxstaged * 2 : 256;
+    staged_t *staged = (realloc)(preload.staged, max * sizeof(*staged));
+
+    if (!staged)
+      return NULL;
+
+    preload.staged = staged;
+    preload.maxstaged = max;
+  }
+
+  if (!(data = (malloc)(l->size)))
+    return NULL;
+
+  if (!W_ReadLumpSafe(lump, data))
+  {
+    (free)(data);
+    return NULL;
+  }
+
+  preload.staged[preload.numstaged].lump = lump;
+  preload.staged[preload.numstaged].data = data;
+  preload.numstaged++;
+  preload.bytes += l->size;
+
+  return preload.lumpdata[lump] = data;
+}
+
+static void MarkTexture(byte *hitlist, const char *name)
+{
+  int texnum = R_CheckTextureNumForName(name);
+
+  if (texnum > 0)
+    hitlist[texnum] = 1;
+}
+
+static void ComposeTexture(int texnum)
+{
+  const int count = R_TexturePatchCount(texnum);
+  const patch_t **patches;
+  byte *data = NULL;
+  int i;
+
+  if (count <= 0 || !(patches = (malloc)(count * sizeof(*patches))))
+    return;
+
+  for (i = 0; i < count; i++)
+    if (!(patches[i] = (const patch_t *) StageLump(R_TexturePatchLump(texnum, i))))
+      break;
+
+  if (i == count)
+    data = R_ComposeTexture(texnum, patches);
+
+  (free)(patches);
+
+  if (data)
+  {
+    preload.composed[preload.numcomposed].texnum = texnum;
+    preload.composed[preload.numcomposed].data = data;
+    preload.numcomposed++;
+  }
+}
+
+static int PreloadThread(void *unused)
+{
+  const uint64_t start = I_GetTimeUS();
+  const int lumpnum = preload.lumpnum;
+  const mapsector_t *ms;
+  const mapsidedef_t *msd;
+  const mapthing_t *mt;
+  byte *hitlist;
+  int i, j, k, count;
+
+  // The map lumps, as far as the level setup reads them.
+
+  for (i = ML_THINGS; i <= ML_BLOCKMAP && lumpnum + i < numlumps; i++)
+    StageLump(lumpnum + i);
+
+  preload.maplumps = preload.numstaged;
+
+  // Flats.
+
+  if ((ms = (const mapsector_t *) StageLump(lumpnum + ML_SECTORS)))
+    for (i = lumpinfo[lumpnum + ML_SECTORS].size / sizeof(*ms); --i >= 0; )
+    {
+      StageLump((W_CheckNumForName)(ms[i].floorpic, ns_flats));
+      StageLump((W_CheckNumForName)(ms[i].ceilingpic, ns_flats));
+    }
+
+  // Textures: their patches first, then the composites.
+
+  if ((hitlist = (calloc)(numtextures, 1)))
+  {
+    if ((msd = (const mapsidedef_t *) StageLump(lumpnum + ML_SIDEDEFS)))
+      for (i = lumpinfo[lumpnum + ML_SIDEDEFS].size / sizeof(*msd); --i >= 0; )
+      {
+        MarkTexture(hitlist, msd[i].toptexture);
+        MarkTexture(hitlist, msd[i].bottomtexture);
+        MarkTexture(hitlist, msd[i].midtexture);
+      }
+
+    for (i = count = 0; i < numtextures; i++)
+      if (hitlist[i])
+      {
+        for (j = R_TexturePatchCount(i); --j >= 0; )
+          StageLump(R_TexturePatchLump(i, j));
+        count++;
+      }
+
+    if (count && (preload.composed = (malloc)(count * sizeof(*preload.composed))))
+      for (i = 0; i < numtextures && !preload.cancel; i++)
+        if (hitlist[i])
+          ComposeTexture(i);
+
+    (free)(hitlist);
+  }
+
+  // Sprites, by the spawn states of the things.
+
+  if ((hitlist = (calloc)(num_sprites, 1)))
+  {
+    if ((mt = (const mapthing_t *) StageLump(lumpnum + ML_THINGS)))
+      for (i = lumpinfo[lumpnum + ML_THINGS].size / sizeof(*mt); --i >= 0; )
+      {
+        const int type = SHORT(mt[i].type);
+
+        for (j = 0; j < num_mobj_types; j++)
+          if (mobjinfo[j].doomednum == type)
+          {
+            hitlist[states[mobjinfo[j].spawnstate].sprite] = 1;
+            break;
+          }
+      }
+
+    for (i = num_sprites; --i >= 0 && !preload.cancel; )
+      if (hitlist[i])
+        for (j = sprites[i].numframes; --j >= 0; )
+        {
+          const short *sflump = sprites[i].spriteframes[j].lump;
+
+          for (k = 8; --k >= 0; )
+            StageLump(firstspritelump + sflump[k]);
+        }
+
+    (free)(hitlist);
+  }
+
+  preload.loadtime = (int) ((I_GetTimeUS() - start) / 1000);
+
+  return 0;
+}
+
+//
+// The main thread
+//
+
+static void FreeStaging(void)
+{
+  int i;
+
+  for (i = 0; i < preload.numstaged; i++)
+    (free)(preload.staged[i].data);
+  for (i = 0; i < preload.numcomposed; i++)
+    (free)(preload.composed[i].data);
+
+  (free)(preload.staged);
+  (free)(preload.composed);
+  (free)(preload.lumpdata);
+
+  preload.staged = NULL;
+  preload.composed = NULL;
+  preload.lumpdata = NULL;
+  preload.numstaged = preload.maxstaged = preload.maplumps = 0;
+  preload.numcomposed = preload.warmed = 0;
+  preload.bytes = 0;
+  preload.loadtime = preload.waittime = 0;
+  preload.lumpnum = -1;
+}
+
+static void CancelPreload(void)
+{
+  if (preload.thread)
+  {
+    preload.cancel = true;
+    I_WaitThread(preload.thread);
+    preload.thread = NULL;
+  }
+
+  FreeStaging();
+}
+
+static void LinkLump(staged_t *staged)
+{
+  const int lump = staged->lump;
+
+  if (!lumpcache[lump])
+    memcpy(Z_Malloc(lumpinfo[lump].size, PU_CACHE, &lumpcache[lump]),
+           staged->data, lumpinfo[lump].size);
+
+  (free)(staged->data);
+  staged->data = NULL;
+}
+
+void P_StartPreload(int episode, int map)
+{
+  static boolean first = true;
+  int lumpnum;
+
+  CancelPreload();
+
+  // Keep -timedemo results comparable.
+  if (!preload_level || timingdemo)
+    return;
+
+  if ((lumpnum = W_CheckNumForName(MAPNAME(episode, map))) < 0)
+    return;
+
+  if (!(preload.lumpdata = (calloc)(numlumps, sizeof(*preload.lumpdata))))
+    return;
+
+  preload.lumpnum = lumpnum;
+  preload.cancel = false;
+
+  if (!(preload.thread = I_CreateThread(PreloadThread, "preload", NULL)))
+  {
+    FreeStaging();
+    return;
+  }
+
+  if (first)
+  {
+    I_AtExit(CancelPreload, false);
+    first = false;
+  }
+}
+
+void P_WaitPreload(int lumpnum)
+{
+  const uint64_t start = I_GetTimeUS();
+  int i;
+
+  if (preload.lumpnum != lumpnum)
+  {
+    CancelPreload();
+    return;
+  }
+
+  if (preload.thread)
+  {
+    I_WaitThread(preload.thread);
+    preload.thread = NULL;
+  }
+
+  preload.waittime = (int) ((I_GetTimeUS() - start) / 1000);
+
+  for (i = 0; i < preload.maplumps; i++)
+    LinkLump(&preload.staged[i]);
+}
+
+void P_LinkPreload(void)
+{
+  const uint64_t start = I_GetTimeUS();
+  int i;
+
+  if (preload.lumpnum < 0)
+    return;
+
+  for (i = preload.maplumps; i < preload.numstaged; i++)
+    LinkLump(&preload.staged[i]);
+
+  for (i = 0; i < preload.numcomposed; i++)
+    R_LinkComposite(preload.composed[i].texnum, preload.composed[i].data);
+
+  fprintf(stderr, "P_LinkPreload: %d lumps (%d KB) read, %d mapped lumps "
+          "touched, %d textures composed in %d ms; stalled %d ms waiting, "
+          "%d ms linking\n", preload.numstaged, (int) (preload.bytes >> 10),
+          preload.warmed, preload.numcomposed, preload.loadtime, preload.waittime,
+          (int) ((I_GetTimeUS() - start) / 1000));
+
+  FreeStaging();
+}
@@ -0,0 +1,38 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Background loader staging the next level during the intermission.
+//
+
+#ifndef __P_PRELOAD__
+#define __P_PRELOAD__
+
+#include "doomtype.h"
+
+extern int preload_level;   // config: preload the next level
+
+// Starts reading the lumps of the given map and composing its textures on
+// a thread of its own. Called when the intermission begins.
+void P_StartPreload(int episode, int map);
+
+// Waits for the loader and hands the staged map lumps over to the lump
+// cache, if it has been working on the map at lumpnum. Anything else
+// staged is thrown away.
+void P_WaitPreload(int lumpnum);
+
+// Hands the staged graphics over to the lump and composite caches and
+// releases the staging area.
+void P_LinkPreload(void);
+
+#endif
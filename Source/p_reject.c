@@ -0,0 +1,789 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      REJECT table builder for maps shipping an empty REJECT lump.
+//
+//      Sector-to-sector visibility is computed by flowing through the
+//      two-sided lines of the map, narrowing the set of possible lines of
+//      sight at every step like a 2D portal visibility set. The result is
+//      conservative: a pair is only rejected if no straight line through
+//      the open space of the map can connect the two sectors.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomstat.h"
+#include "d_main.h"
+#include "i_system.h"
+#include "i_thread.h"
+#include "m_misc2.h"
+#include "p_reject.h"
+#include "p_setup.h"
+#include "r_state.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+int build_reject;
+
+// Distances in map units. Everything closer to the clipping line than
+// EPSILON is kept, so rounding never closes a gap the game can see through.
+
+#define EPSILON    2.0
+#define MAXDEPTH   512
+#define MAXSTEPS   (1 << 17)
+
+#define CACHEMAGIC   "WREJ"
+#define CACHEVERSION 1
+
+typedef struct
+{
+  double x1, y1, x2, y2;
+} rseg_t;
+
+// a*x + b*y + c is the signed distance, the positive side is kept
+
+typedef struct
+{
+  double a, b, c;
+} rplane_t;
+
+typedef struct
+{
+  rseg_t seg;
+  boolean vertex;   // a corner shared by several sectors
+  int front, back;  // sectors of a two-sided line
+  int first, count; // sectors around a corner, in cornersecs[]
+} rportal_t;
+
+static rportal_t *portals;
+static int numportals;
+static int *cornersecs;
+
+static int *secportals;  // portals of each sector, starting at secfirst[]
+static int *secfirst;
+static boolean *unclosed;
+
+static byte *visible;    // one bit row per sector
+static int rowbytes;
+static boolean *overflowed;
+
+typedef struct
+{
+  byte *row;
+  byte *onpath;          // portals on the current path
+  int steps;
+  boolean overflow;
+  rseg_t src;            // the portal the source sector is left through
+  rplane_t srcplane;
+  boolean hassrcplane;
+} rflow_t;
+
+static inline void SetVisible(byte *row, int sector)
+{
+  row[sector >> 3] |= 1 << (sector & 7);
+}
+
+static inline boolean IsVisible(const byte *row, int sector)
+{
+  return (row[sector >> 3] & (1 << (sector & 7))) != 0;
+}
+
+//
+// Geometry
+//
+
+static void FlipPlane(rplane_t *p)
+{
+  p->a = -p->a;
+  p->b = -p->b;
+  p->c = -p->c;
+}
+
+static boolean MakePlane(rplane_t *p, double x1, double y1,
+                         double x2, double y2, boolean left)
+{
+  double dx = x2 - x1, dy = y2 - y1;
+  double len = sqrt(dx * dx + dy * dy);
+
+  if (len < 1e-6)
+    return false;
+
+  p->a = -dy / len;
+  p->b = dx / len;
+  p->c = (dy * x1 - dx * y1) / len;
+
+  if (!left)
+    FlipPlane(p);
+
+  return true;
+}
+
+static inline double PlaneDist(const rplane_t *p, double x, double y)
+{
+  return p->a * x + p->b * y + p->c;
+}
+
+static boolean ClipSeg(rseg_t *s, const rplane_t *p)
+{
+  double d1 = PlaneDist(p, s->x1, s->y1) + EPSILON;
+  double d2 = PlaneDist(p, s->x2, s->y2) + EPSILON;
+  double t;
+
+  if (d1 < 0 && d2 < 0)
+    return false;
+
+  if (d1 < 0)
+  {
+    t = d1 / (d1 - d2);
+    s->x1 += t * (s->x2 - s->x1);
+    s->y1 += t * (s->y2 - s->y1);
+  }
+  else if (d2 < 0)
+  {
+    t = d2 / (d2 - d1);
+    s->x2 += t * (s->x1 - s->x2);
+    s->y2 += t * (s->y1 - s->y2);
+  }
+  return true;
+}
+
+// The lines through one endpoint of the source and one endpoint of the
+// pass portal which have both portals on opposite sides bound the space
+// any line of sight through both of them can reach. If all endpoints lie
+// on one line, only a thin strip along it is left.
+
+static int Separators(const rseg_t *s, const rseg_t *p, rplane_t *out)
+{
+  const double sx[2] = {s->x1, s->x2}, sy[2] = {s->y1, s->y2};
+  const double px[2] = {p->x1, p->x2}, py[2] = {p->y1, p->y2};
+  int i, j, num = 0;
+
+  for (i = 0; i < 2; i++)
+    for (j = 0; j < 2; j++)
+    {
+      rplane_t *plane = &out[num];
+      double ds, dp;
+
+      if (!MakePlane(plane, sx[i], sy[i], px[j], py[j], true))
+        continue;
+
+      ds = PlaneDist(plane, sx[i ^ 1], sy[i ^ 1]);
+      dp = PlaneDist(plane, px[j ^ 1], py[j ^ 1]);
+
+      if (fabs(ds) <= EPSILON && fabs(dp) <= EPSILON)
+      {
+        out[num + 1] = *plane;
+        FlipPlane(&out[num + 1]);
+        num += 2;
+        continue;
+      }
+
+      if ((ds > EPSILON && dp < -EPSILON) || (ds < -EPSILON && dp > EPSILON) ||
+          fabs(dp) <= EPSILON)
+      {
+        if (ds > 0)
+          FlipPlane(plane);
+      }
+      else if (fabs(ds) <= EPSILON)
+      {
+        if (dp < 0)
+          FlipPlane(plane);
+      }
+      else
+        continue;
+
+      num++;
+    }
+
+  return num;
+}
+
+// Side of a two-sided line the reference portal lies on: 0 for the front,
+// 1 for the back, -1 if it cannot be told. Only needed for lines having
+// the same sector on both sides.
+
+static int RefSide(const rportal_t *t, const rseg_t *ref)
+{
+  rplane_t plane;
+  double d1, d2;
+
+  if (!MakePlane(&plane, t->seg.x1, t->seg.y1, t->seg.x2, t->seg.y2, true))
+    return -1;
+
+  d1 = PlaneDist(&plane, ref->x1, ref->y1);
+  d2 = PlaneDist(&plane, ref->x2, ref->y2);
+
+  if (d1 <= EPSILON && d2 <= EPSILON && (d1 < -EPSILON || d2 < -EPSILON))
+    return 0;   // right of the line direction is the front side
+  if (d1 >= -EPSILON && d2 >= -EPSILON && (d1 > EPSILON || d2 > EPSILON))
+    return 1;
+  return -1;
+}
+
+//
+// Flow
+//
+
+static void Flow(rflow_t *f, int sector, const rseg_t *pass,
+                 const rplane_t *passplane, int depth);
+
+static void Enter(rflow_t *f, int pi, int sector, const rseg_t *seg,
+                  const rseg_t *ref, int depth)
+{
+  const rportal_t *t = &portals[pi];
+  rplane_t plane;
+  int side, next;
+
+  f->onpath[pi] = 1;
+
+  if (t->vertex)
+  {
+    int i;
+
+    for (i = t->first; i < t->first + t->count && !f->overflow; i++)
+      if (cornersecs[i] != sector)
+        Flow(f, cornersecs[i], seg, NULL, depth);
+  }
+  else
+  {
+    if (t->front == sector && t->back != sector)
+      side = 0;
+    else if (t->back == sector && t->front != sector)
+      side = 1;
+    else
+      side = ref ? RefSide(t, ref) : -1;
+
+    next = side == 1 ? t->front : t->back;
+
+    // The line of sight continues on the far side of the line.
+    if (side >= 0 &&
+        MakePlane(&plane, t->seg.x1, t->seg.y1, t->seg.x2, t->seg.y2, !side))
+      Flow(f, next, seg, &plane, depth);
+    else
+      Flow(f, next, seg, NULL, depth);
+  }
+
+  f->onpath[pi] = 0;
+}
+
+static void Flow(rflow_t *f, int sector, const rseg_t *pass,
+                 const rplane_t *passplane, int depth)
+{
+  rplane_t seps[8];
+  int numseps;
+  int i;
+
+  SetVisible(f->row, sector);
+
+  if (++f->steps > MAXSTEPS || depth > MAXDEPTH)
+  {
+    f->overflow = true;
+    return;
+  }
+
+  numseps = Separators(&f->src, pass, seps);
+
+  for (i = secfirst[sector]; i < secfirst[sector + 1] && !f->overflow; i++)
+  {
+    int pi = secportals[i];
+    rseg_t seg;
+    int k;
+
+    if (f->onpath[pi])
+      continue;
+
+    seg = portals[pi].seg;
+
+    if (f->hassrcplane && !ClipSeg(&seg, &f->srcplane))
+      continue;
+    if (passplane && !ClipSeg(&seg, passplane))
+      continue;
+    for (k = 0; k < numseps; k++)
+      if (!ClipSeg(&seg, &seps[k]))
+        break;
+    if (k < numseps)
+      continue;
+
+    Enter(f, pi, sector, &seg, pass, depth + 1);
+  }
+}
+
+// Sectors connected to the source in any way, used when the flow gives up.
+
+static void FloodFill(byte *row, int source)
+{
+  int *queue = (malloc)(numsectors * sizeof(*queue));
+  int head = 0, tail = 0;
+
+  memset(row, 0, rowbytes);
+  SetVisible(row, source);
+  queue[tail++] = source;
+
+  while (head < tail)
+  {
+    int sector = queue[head++];
+    int i, j;
+
+    for (i = secfirst[sector]; i < secfirst[sector + 1]; i++)
+    {
+      const rportal_t *t = &portals[secportals[i]];
+
+      if (t->vertex)
+      {
+        for (j = t->first; j < t->first + t->count; j++)
+          if (!IsVisible(row, cornersecs[j]))
+          {
+            SetVisible(row, cornersecs[j]);
+            queue[tail++] = cornersecs[j];
+          }
+      }
+      else
+      {
+        int next = t->front == sector ? t->back : t->front;
+
+        if (!IsVisible(row, next))
+        {
+          SetVisible(row, next);
+          queue[tail++] = next;
+        }
+      }
+    }
+  }
+
+  (free)(queue);
+}
+
+static void RejectRow(void *data, int source)
+{
+  rflow_t f;
+  int i;
+
+  memset(&f, 0, sizeof(f));
+  f.row = visible + source * rowbytes;
+  f.onpath = (calloc)(numportals, 1);
+
+  SetVisible(f.row, source);
+
+  for (i = secfirst[source]; i < secfirst[source + 1] && !f.overflow; i++)
+  {
+    int pi = secportals[i];
+    const rportal_t *s = &portals[pi];
+
+    f.src = s->seg;
+    f.hassrcplane = false;
+
+    if (!s->vertex && s->front != s->back)
+    {
+      // keep the far side of the line
+      f.hassrcplane = MakePlane(&f.srcplane, s->seg.x1, s->seg.y1,
+                                s->seg.x2, s->seg.y2, s->front == source);
+    }
+
+    Enter(&f, pi, source, &s->seg, NULL, 1);
+  }
+
+  if (f.overflow)
+  {
+    FloodFill(f.row, source);
+    overflowed[source] = true;
+  }
+
+  (free)(f.onpath);
+}
+
+//
+// Portal setup
+//
+
+static void AddSectorPortal(int *count, int sector, int pi)
+{
+  if (secportals)
+    secportals[secfirst[sector] + count[sector]] = pi;
+  count[sector]++;
+}
+
+static boolean IsPortal(const line_t *line)
+{
+  return (line->flags & ML_TWOSIDED) && line->backsector;
+}
+
+static void SetupPortals(void)
+{
+  int *vertfirst, *vertlines;
+  int *count, *around;
+  int maxdegree = 0;
+  int numcorners = 0, numcornersecs = 0;
+  int pass, i, j, k;
+
+  // Lines meeting at each vertex.
+
+  vertfirst = (calloc)(numvertexes + 1, sizeof(*vertfirst));
+  vertlines = (malloc)(numlines * 2 * sizeof(*vertlines));
+
+  for (i = 0; i < numlines; i++)
+  {
+    vertfirst[lines[i].v1 - vertexes + 1]++;
+    vertfirst[lines[i].v2 - vertexes + 1]++;
+  }
+  for (i = 0; i < numvertexes; i++)
+  {
+    maxdegree = MAX(maxdegree, vertfirst[i + 1]);
+    vertfirst[i + 1] += vertfirst[i];
+  }
+  count = (calloc)(numvertexes, sizeof(*count));
+  for (i = 0; i < numlines; i++)
+  {
+    int v1 = lines[i].v1 - vertexes, v2 = lines[i].v2 - vertexes;
+    vertlines[vertfirst[v1] + count[v1]++] = i;
+    vertlines[vertfirst[v2] + count[v2]++] = i;
+  }
+  (free)(count);
+
+  // Find the sectors around each vertex. A sector whose lines do not meet
+  // an even number of times at all of its vertices is not closed and is
+  // assumed to see everything. Vertices where walls meet between different
+  // sectors become corner portals, lines of sight may squeeze through them.
+
+  around = (malloc)(MAX(maxdegree, 1) * 2 * sizeof(*around));
+  unclosed = (calloc)(numsectors, sizeof(*unclosed));
+
+  for (pass = 0; pass < 2; pass++)
+  {
+    numcorners = numcornersecs = 0;
+
+    for (i = 0; i < numvertexes; i++)
+    {
+      int num = 0;
+      boolean wall = false;
+
+      for (j = vertfirst[i]; j < vertfirst[i + 1]; j++)
+      {
+        const line_t *line = &lines[vertlines[j]];
+        int secs[2];
+
+        secs[0] = line->frontsector - sectors;
+        secs[1] = line->backsector ? line->backsector - sectors : -1;
+
+        if (!IsPortal(line))
+          wall = true;
+
+        for (k = 0; k < 2; k++)
+        {
+          int n;
+
+          if (secs[k] < 0)
+            continue;
+          for (n = 0; n < num && around[n] != secs[k]; n++);
+          if (n == num)
+            around[num++] = secs[k];
+        }
+      }
+
+      if (pass == 0)
+      {
+        // Closed sectors border each vertex with an even number of lines.
+        for (k = 0; k < num; k++)
+        {
+          int sides = 0;
+
+          for (j = vertfirst[i]; j < vertfirst[i + 1]; j++)
+          {
+            const line_t *line = &lines[vertlines[j]];
+
+            if (line->frontsector == line->backsector)
+              continue;
+            if (line->frontsector - sectors == around[k] ||
+                (line->backsector && line->backsector - sectors == around[k]))
+              sides++;
+          }
+          if (sides & 1)
+            unclosed[around[k]] = true;
+        }
+      }
+
+      if (wall && num > 1)
+      {
+        if (pass == 1)
+        {
+          rportal_t *t = &portals[numportals++];
+
+          t->seg.x1 = t->seg.x2 = vertexes[i].x / (double) FRACUNIT;
+          t->seg.y1 = t->seg.y2 = vertexes[i].y / (double) FRACUNIT;
+          t->vertex = true;
+          t->front = t->back = -1;
+          t->first = numcornersecs;
+          t->count = num;
+          memcpy(cornersecs + numcornersecs, around, num * sizeof(*around));
+        }
+        numcorners++;
+        numcornersecs += num;
+      }
+    }
+
+    if (pass == 0)
+    {
+      for (i = 0; i < numlines; i++)
+        if (IsPortal(&lines[i]))
+          numportals++;
+
+      portals = (malloc)((numportals + numcorners) * sizeof(*portals));
+      cornersecs = (malloc)(MAX(numcornersecs, 1) * sizeof(*cornersecs));
+      numportals = 0;
+
+      for (i = 0; i < numlines; i++)
+      {
+        const line_t *line = &lines[i];
+        rportal_t *t;
+
+        if (!IsPortal(line))
+          continue;
+
+        t = &portals[numportals++];
+        t->seg.x1 = line->v1->x / (double) FRACUNIT;
+        t->seg.y1 = line->v1->y / (double) FRACUNIT;
+        t->seg.x2 = line->v2->x / (double) FRACUNIT;
+        t->seg.y2 = line->v2->y / (double) FRACUNIT;
+        t->vertex = false;
+        t->front = line->frontsector - sectors;
+        t->back = line->backsector - sectors;
+        t->first = t->count = 0;
+      }
+    }
+  }
+
+  (free)(around);
+  (free)(vertfirst);
+  (free)(vertlines);
+
+  // Portals of each sector, counted first and then filled in.
+
+  secfirst = (calloc)(numsectors + 1, sizeof(*secfirst));
+  count = (calloc)(numsectors, sizeof(*count));
+
+  for (pass = 0; pass < 2; pass++)
+  {
+    for (i = 0; i < numportals; i++)
+    {
+      const rportal_t *t = &portals[i];
+
+      if (t->vertex)
+      {
+        for (j = t->first; j < t->first + t->count; j++)
+          AddSectorPortal(count, cornersecs[j], i);
+      }
+      else
+      {
+        AddSectorPortal(count, t->front, i);
+        if (t->back != t->front)
+          AddSectorPortal(count, t->back, i);
+      }
+    }
+
+    if (pass == 0)
+    {
+      for (i = 0; i < numsectors; i++)
+        secfirst[i + 1] = secfirst[i] + count[i];
+      secportals = (malloc)(MAX(secfirst[numsectors], 1) * sizeof(*secportals));
+      memset(count, 0, numsectors * sizeof(*count));
+    }
+  }
+
+  (free)(count);
+}
+
+static void FreePortals(void)
+{
+  (free)(portals);
+  (free)(cornersecs);
+  (free)(secportals);
+  (free)(secfirst);
+  (free)(unclosed);
+  portals = NULL;
+  cornersecs = NULL;
+  secportals = NULL;
+  secfirst = NULL;
+  unclosed = NULL;
+  numportals = 0;
+}
+
+//
+// Cache
+//
+
+static ULong64 HashMap(int lumpnum)
+{
+  static const int maplumps[] = {ML_VERTEXES, ML_LINEDEFS, ML_SIDEDEFS, ML_SECTORS};
+  ULong64 hash = 0xcbf29ce484222325ULL;   // FNV-1a
+  int i, j;
+
+  for (i = 0; i < arrlen(maplumps); i++)
+  {
+    const byte *data = W_CacheLumpNum(lumpnum + maplumps[i], PU_CACHE);
+    int length = W_LumpLength(lumpnum + maplumps[i]);
+
+    for (j = 0; j < length; j++)
+    {
+      hash ^= data[j];
+      hash *= 0x100000001b3ULL;
+    }
+  }
+
+  hash ^= numsectors;
+  hash *= 0x100000001b3ULL;
+  return hash;
+}
+
+static char *CacheName(ULong64 hash)
+{
+  char name[32];
+  char *dir = M_StringJoin(D_DoomPrefDir(), DIR_SEPARATOR_S, "reject", NULL);
+  char *path;
+
+  M_MakeDirectory(dir);
+  M_snprintf(name, sizeof(name), "%08x%08x.rej",
+             (unsigned int) (hash >> 32), (unsigned int) hash);
+  path = M_StringJoin(dir, DIR_SEPARATOR_S, name, NULL);
+  (free)(dir);
+  return path;
+}
+
+static void WriteHeader(byte *header)
+{
+  int i;
+
+  memcpy(header, CACHEMAGIC, 4);
+  for (i = 0; i < 4; i++)
+  {
+    header[4 + i] = (CACHEVERSION >> (8 * i)) & 0xff;
+    header[8 + i] = (numsectors >> (8 * i)) & 0xff;
+  }
+}
+
+static boolean LoadCache(const char *path, byte *reject, int length)
+{
+  byte header[12], expect[12];
+  boolean ok = false;
+  FILE *fp = fopen(path, "rb");
+
+  if (!fp)
+    return false;
+
+  WriteHeader(expect);
+  if (fread(header, 1, sizeof(header), fp) == sizeof(header) &&
+      !memcmp(header, expect, sizeof(header)) &&
+      fread(reject, 1, length, fp) == length)
+    ok = true;
+
+  fclose(fp);
+  return ok;
+}
+
+static void SaveCache(const char *path, const byte *reject, int length)
+{
+  FILE *fp = fopen(path, "wb");
+  byte header[12];
+  boolean ok;
+
+  if (!fp)
+    return;
+
+  WriteHeader(header);
+  ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header) &&
+       fwrite(reject, 1, length, fp) == length;
+  fclose(fp);
+
+  if (!ok)
+    remove(path);
+}
+
+//
+// P_BuildReject
+//
+
+boolean P_BuildReject(int lumpnum)
+{
+  const int length = (numsectors * numsectors + 7) / 8;
+  byte *reject;
+  char *path;
+  uint64_t start;
+  int i, j, overflows = 0;
+
+  // The table changes the outcome of sight checks, which would break
+  // demo and network sync with other ports.
+  if (!build_reject || demo_compatibility || demoplayback || demorecording ||
+      netgame || !numsectors)
+    return false;
+
+  for (i = 0; i < length; i++)
+    if (rejectmatrix[i])
+      return false;
+
+  // The original lump comes straight from the read-only mapping of the
+  // WAD file unless -nommap is given, so the table goes into a copy.
+  reject = Z_Malloc(length, PU_LEVEL, NULL);
+
+  path = CacheName(HashMap(lumpnum));
+
+  if (LoadCache(path, reject, length))
+  {
+    rejectmatrix = reject;
+    (free)(path);
+    return true;
+  }
+
+  start = I_GetTimeUS();
+
+  SetupPortals();
+
+  rowbytes = (numsectors + 7) / 8;
+  visible = (calloc)(numsectors, rowbytes);
+  overflowed = (calloc)(numsectors, sizeof(*overflowed));
+
+  I_RunParallel(RejectRow, NULL, numsectors);
+
+  // Sight is symmetric, and open sectors may see anything.
+
+  memset(reject, 0, length);
+
+  for (i = 0; i < numsectors; i++)
+  {
+    overflows += overflowed[i];
+    for (j = 0; j < numsectors; j++)
+    {
+      if (unclosed[i] || unclosed[j] ||
+          IsVisible(visible + i * rowbytes, j) ||
+          IsVisible(visible + j * rowbytes, i))
+        continue;
+      reject[(i * numsectors + j) >> 3] |= 1 << ((i * numsectors + j) & 7);
+    }
+  }
+
+  (free)(visible);
+  (free)(overflowed);
+  visible = NULL;
+  overflowed = NULL;
+  FreePortals();
+
+  fprintf(stderr, "P_BuildReject: %d sectors in %d ms (%d flood filled)\n",
+          numsectors, (int) ((I_GetTimeUS() - start) / 1000), overflows);
+
+  SaveCache(path, reject, length);
+  (free)(path);
+
+  rejectmatrix = reject;
+  return true;
+}
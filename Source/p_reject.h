@@ -0,0 +1,30 @@
+//
+// Copyright(C) 2023 Woof! developers
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      REJECT table builder for maps shipping an empty REJECT lump.
+//
+
+#ifndef __P_REJECT__
+#define __P_REJECT__
+
+#include "doomtype.h"
+
+extern int build_reject;    // config: build missing REJECT tables
+
+// Replace an all-zero rejectmatrix by a conservative table computed from
+// the map geometry, or loaded from the on-disk cache. Must be called after
+// P_LoadReject(). Returns true if a table has been built or loaded.
+boolean P_BuildReject(int lumpnum);
+
+#endif
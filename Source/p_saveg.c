@@ -164,22 +164,89 @@ static void saveg_writep(const void *p)
 #define saveg_write_enum saveg_write32
 
 // [crispy] enumerate all thinker pointers
+//
+// Mobj thinkers are numbered from 1 in thinker list order. Both ways of
+// the translation are looked up in tables built by a single pass over
+// the thinker list, instead of walking the list for every pointer. The
+// tables are only valid while the list of mobjs does not change, they
+// are dropped by P_ClearThinkerIndex() when (un)archiving is done.
+
+typedef struct
+{
+    thinker_t *thinker;
+    int index;
+} thinkerindex_t;
+
+static thinker_t **index_to_thinker;     // index_to_thinker[0] is NULL
+static int num_thinker_indices;
+static thinkerindex_t *thinker_hash;     // open addressing, power of 2
+static unsigned thinker_hash_mask;
+
+static unsigned P_ThinkerHash(const thinker_t *thinker)
+{
+    return (unsigned)(((uintptr_t) thinker >> 4) * 2654435761u) &
+           thinker_hash_mask;
+}
+
+static void P_BuildThinkerIndex(void)
+{
+    thinker_t *th;
+    int count = 0;
+    unsigned size = 64;
+
+    for (th = thinkercap.next; th != &thinkercap; th = th->next)
+        if (th->function == P_MobjThinker)
+            count++;
+
+    while (size < 2 * (unsigned) count)
+        size <<= 1;
+
+    index_to_thinker = malloc((count + 1) * sizeof(*index_to_thinker));
+    thinker_hash = calloc(size, sizeof(*thinker_hash));
+    thinker_hash_mask = size - 1;
+    num_thinker_indices = count;
+
+    index_to_thinker[0] = NULL;
+    count = 0;
+
+    for (th = thinkercap.next; th != &thinkercap; th = th->next)
+        if (th->function == P_MobjThinker)
+        {
+            unsigned i = P_ThinkerHash(th);
+
+            while (thinker_hash[i].thinker)
+                i = (i + 1) & thinker_hash_mask;
+
+            thinker_hash[i].thinker = th;
+            thinker_hash[i].index = ++count;
+            index_to_thinker[count] = th;
+        }
+}
+
+static void P_ClearThinkerIndex(void)
+{
+    free(index_to_thinker);
+    free(thinker_hash);
+    index_to_thinker = NULL;
+    thinker_hash = NULL;
+    num_thinker_indices = 0;
+}
+
 static int P_ThinkerToIndex(thinker_t* thinker)
 {
-    thinker_t* th;
-    int i;
+    unsigned i;
 
     if (!thinker)
         return 0;
 
-    for (th = thinkercap.next, i = 0; th != &thinkercap; th = th->next)
+    if (!thinker_hash)
+        P_BuildThinkerIndex();
+
+    for (i = P_ThinkerHash(thinker); thinker_hash[i].thinker;
+         i = (i + 1) & thinker_hash_mask)
     {
-        if (th->function == P_MobjThinker)
-        {
-            i++;
-            if (th == thinker)
-                return i;
-        }
+        if (thinker_hash[i].thinker == thinker)
+            return thinker_hash[i].index;
     }
 
     return 0;
@@ -188,23 +255,16 @@ static int P_ThinkerToIndex(thinker_t* thinker)
 // [crispy] replace indizes with corresponding pointers
 static thinker_t* P_IndexToThinker(int index)
 {
-    thinker_t* th;
-    int i;
-
     if (!index)
         return NULL;
 
-    for (th = thinkercap.next, i = 0; th != &thinkercap; th = th->next)
-    {
-        if (th->function == P_MobjThinker)
-        {
-            i++;
-            if (i == index)
-                return th;
-        }
-    }
+    if (!index_to_thinker)
+        P_BuildThinkerIndex();
 
-    return NULL;
+    if (index < 0 || index > num_thinker_indices)
+        return NULL;
+
+    return index_to_thinker[index];
 }
 
 //
@@ -345,6 +405,11 @@ static void saveg_read_mobj_t(mobj_t *str)
     // struct mobj_s** bprev;
     str->bprev = saveg_readp();
 
+    // target links are rebuilt by P_SetThingPosition()
+    str->tnext = NULL;
+    str->tprev = NULL;
+    str->tblock = 0;
+
     // struct subsector_s* subsector;
     str->subsector = saveg_readp();
 
@@ -2562,6 +2627,8 @@ void P_ArchiveSpecials (void)
 
   // add a terminating marker
   saveg_write8(tc_endspecials);
+
+  P_ClearThinkerIndex();
 }
 
 
@@ -2726,6 +2793,8 @@ void P_UnArchiveSpecials (void)
         I_Error ("P_UnarchiveSpecials:Unknown tclass %i "
                  "in savegame",tclass);
       }
+
+  P_ClearThinkerIndex();
 }
 
 // killough 2/16/98: save/restore random number generator state information
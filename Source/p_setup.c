@@ -36,6 +36,8 @@
 #include "r_things.h"
 #include "p_maputl.h"
 #include "p_map.h"
+#include "p_preload.h"
+#include "p_reject.h"
 #include "p_setup.h"
 #include "p_spec.h"
 #include "p_tick.h"
@@ -43,6 +45,9 @@
 #include "s_sound.h"
 #include "s_musinfo.h" // [crispy] S_ParseMusInfo()
 #include "m_misc2.h" // [FG] M_StringJoin()
+#include "d_main.h" // D_DoomPrefDir()
+#include "i_system.h"
+#include "i_thread.h"
 
 // [FG] support maps with NODES in compressed or uncompressed ZDBSP format or DeePBSP format
 #include "p_extnodes.h"
@@ -93,6 +98,7 @@ long      *blockmaplump;          // was short -- killough
 fixed_t   bmaporgx, bmaporgy;     // origin of block map
 
 mobj_t    **blocklinks;           // for thing chains
+mobj_t    **targetlinks;          // enemies, then friends
 
 boolean   skipblstart;  // MaxW: Skip initial blocklist short
 
@@ -586,46 +592,216 @@ void P_LoadSideDefs2(int lump)
                                  // jff 10/8/98 use guardband>0
                                  // jff 10/12/98 0 ok with + 1 in rows,cols
 
-typedef struct linelist_t        // type used to list lines in each block
+// Lines are binned into blocks in parallel, each job handling a range of
+// lines and recording (block, line) pairs. The pairs are then merged in
+// descending line order, which gives the same lists as the original
+// serial algorithm that grew them backwards.
+
+typedef struct
 {
-  long num;
-  struct linelist_t *next;
-} linelist_t;
+  int first, last;               // range of lines
+  int *pairs;                    // block and line numbers
+  int numpairs, maxpairs;
+  int *done;                     // line+1 if the block has got the line
+} bmapchunk_t;
+
+static int bmap_xorg, bmap_yorg, bmap_ncols, bmap_nrows;
 
 //
 // Subroutine to add a line number to a block list
 // It simply returns if the line is already in the block
 //
 
-static void AddBlockLine
-(
-  linelist_t **lists,
-  int *count,
-  int *done,
-  int blockno,
-  long lineno
-)
+static void AddBlockLine(bmapchunk_t *c, int blockno, int lineno)
 {
-  linelist_t *l;
-
-  if (done[blockno])
+  if (c->done[blockno] == lineno + 1)
     return;
+  c->done[blockno] = lineno + 1;
+
+  if (c->numpairs == c->maxpairs)
+  {
+    c->maxpairs = c->maxpairs ? c->maxpairs * 2 : 1024;
+    c->pairs = (realloc)(c->pairs, c->maxpairs * 2 * sizeof(*c->pairs));
+  }
+  c->pairs[c->numpairs * 2] = blockno;
+  c->pairs[c->numpairs * 2 + 1] = lineno;
+  c->numpairs++;
+}
+
+// For each linedef in the wad, determine all blockmap blocks it touches,
+// and add the linedef number to the blocklists for those blocks
+
+static void P_BlockLinesOfLine(bmapchunk_t *c, int i)
+{
+  const int xorg = bmap_xorg, yorg = bmap_yorg;
+  const int ncols = bmap_ncols, nrows = bmap_nrows;
+  int x1 = lines[i].v1->x>>FRACBITS;         // lines[i] map coords
+  int y1 = lines[i].v1->y>>FRACBITS;
+  int x2 = lines[i].v2->x>>FRACBITS;
+  int y2 = lines[i].v2->y>>FRACBITS;
+  int dx = x2-x1;
+  int dy = y2-y1;
+  int vert = !dx;                            // lines[i] slopetype
+  int horiz = !dy;
+  int spos = (dx^dy) > 0;
+  int sneg = (dx^dy) < 0;
+  int bx,by;                                 // block cell coords
+  int minx = x1>x2? x2 : x1;                 // extremal lines[i] coords
+  int maxx = x1>x2? x1 : x2;
+  int miny = y1>y2? y2 : y1;
+  int maxy = y1>y2? y1 : y2;
+  int j, jmin, jmax;
+
+  // The line always belongs to the blocks containing its endpoints
+
+  bx = (x1-xorg)>>blkshift;
+  by = (y1-yorg)>>blkshift;
+  AddBlockLine(c,by*ncols+bx,i);
+  bx = (x2-xorg)>>blkshift;
+  by = (y2-yorg)>>blkshift;
+  AddBlockLine(c,by*ncols+bx,i);
+
+  // For each column, see where the line along its left edge, which
+  // it contains, intersects the Linedef i. Add i to each corresponding
+  // blocklist. Columns outside the line's extent are never touched.
+
+  if (!vert)    // don't interesect vertical lines with columns
+  {
+    jmin = MAX(0, (minx-xorg+blkmask)>>blkshift);
+    jmax = MIN(ncols-1, (maxx-xorg)>>blkshift);
+
+    for (j=jmin;j<=jmax;j++)
+    {
+      // intersection of Linedef with x=xorg+(j<<blkshift)
+      // (y-y1)*dx = dy*(x-x1)
+      // y = dy*(x-x1)+y1*dx;
+
+      int x = xorg+(j<<blkshift);       // (x,y) is intersection
+      int y = (dy*(x-x1))/dx+y1;
+      int yb = (y-yorg)>>blkshift;      // block row number
+      int yp = (y-yorg)&blkmask;        // y position within block
+
+      if (yb<0 || yb>nrows-1)     // outside blockmap, continue
+        continue;
+
+      if (x<minx || x>maxx)       // line doesn't touch column
+        continue;
+
+      // The cell that contains the intersection point is always added
+
+      AddBlockLine(c,ncols*yb+j,i);
+
+      // if the intersection is at a corner it depends on the slope
+      // (and whether the line extends past the intersection) which
+      // blocks are hit
+
+      if (yp==0)        // intersection at a corner
+      {
+        if (sneg)       //   \ - blocks x,y-, x-,y
+        {
+          if (yb>0 && miny<y)
+            AddBlockLine(c,ncols*(yb-1)+j,i);
+          if (j>0 && minx<x)
+            AddBlockLine(c,ncols*yb+j-1,i);
+        }
+        else if (spos)  //   / - block x-,y-
+        {
+          if (yb>0 && j>0 && minx<x)
+            AddBlockLine(c,ncols*(yb-1)+j-1,i);
+        }
+        else if (horiz) //   - - block x-,y
+        {
+          if (j>0 && minx<x)
+            AddBlockLine(c,ncols*yb+j-1,i);
+        }
+      }
+      else if (j>0 && minx<x) // else not at corner: x-,y
+        AddBlockLine(c,ncols*yb+j-1,i);
+    }
+  }
+
+  // For each row, see where the line along its bottom edge, which
+  // it contains, intersects the Linedef i. Add i to all the corresponding
+  // blocklists.
+
+  if (!horiz)
+  {
+    jmin = MAX(0, (miny-yorg+blkmask)>>blkshift);
+    jmax = MIN(nrows-1, (maxy-yorg)>>blkshift);
+
+    for (j=jmin;j<=jmax;j++)
+    {
+      // intersection of Linedef with y=yorg+(j<<blkshift)
+      // (x,y) on Linedef i satisfies: (y-y1)*dx = dy*(x-x1)
+      // x = dx*(y-y1)/dy+x1;
+
+      int y = yorg+(j<<blkshift);       // (x,y) is intersection
+      int x = (dx*(y-y1))/dy+x1;
+      int xb = (x-xorg)>>blkshift;      // block column number
+      int xp = (x-xorg)&blkmask;        // x position within block
+
+      if (xb<0 || xb>ncols-1)   // outside blockmap, continue
+        continue;
+
+      if (y<miny || y>maxy)     // line doesn't touch row
+        continue;
+
+      // The cell that contains the intersection point is always added
+
+      AddBlockLine(c,ncols*j+xb,i);
+
+      // if the intersection is at a corner it depends on the slope
+      // (and whether the line extends past the intersection) which
+      // blocks are hit
 
-  l = malloc(sizeof(linelist_t));
-  l->num = lineno;
-  l->next = lists[blockno];
-  lists[blockno] = l;
-  count[blockno]++;
-  done[blockno] = 1;
+      if (xp==0)        // intersection at a corner
+      {
+        if (sneg)       //   \ - blocks x,y-, x-,y
+        {
+          if (j>0 && miny<y)
+            AddBlockLine(c,ncols*(j-1)+xb,i);
+          if (xb>0 && minx<x)
+            AddBlockLine(c,ncols*j+xb-1,i);
+        }
+        else if (vert)  //   | - block x,y-
+        {
+          if (j>0 && miny<y)
+            AddBlockLine(c,ncols*(j-1)+xb,i);
+        }
+        else if (spos)  //   / - block x-,y-
+        {
+          if (xb>0 && j>0 && miny<y)
+            AddBlockLine(c,ncols*(j-1)+xb-1,i);
+        }
+      }
+      else if (j>0 && miny<y) // else not on a corner: x,y-
+        AddBlockLine(c,ncols*(j-1)+xb,i);
+    }
+  }
 }
 
-static void P_CreateBlockMap(void)
+static void P_BlockLinesJob(void *data, int index)
+{
+  bmapchunk_t *c = (bmapchunk_t *) data + index;
+  int i;
+
+  c->done = (calloc)(bmap_ncols * bmap_nrows, sizeof(*c->done));
+
+  for (i = c->first; i < c->last; i++)
+    P_BlockLinesOfLine(c, i);
+
+  (free)(c->done);
+  c->done = NULL;
+}
+
+static long P_CreateBlockMap(void)
 {
   int xorg,yorg;                 // blockmap origin (lower left)
   int nrows,ncols;               // blockmap dimensions
-  linelist_t **blocklists=NULL;  // array of pointers to lists of lines
+  bmapchunk_t *chunks;           // lines binned by each job
+  int numchunks;
   int *blockcount=NULL;          // array of counters of line lists
-  int *blockdone=NULL;           // array keeping track of blocks/line
+  long *blockpos=NULL;           // next free entry of each list
   int NBlocks;                   // number of cells = nrows*ncols
   long linetotal=0;              // total length of all blocklists
   int i,j;
@@ -662,187 +838,42 @@ static void P_CreateBlockMap(void)
   nrows = (map_maxy+blkmargin-yorg+1+blkmask)>>blkshift;  //+1 needed for
   NBlocks = ncols*nrows;                                  //map exactly 1 cell
 
-  // create the array of pointers on NBlocks to blocklists
-  // also create an array of linelist counts on NBlocks
-  // finally make an array in which we can mark blocks done per line
+  bmap_xorg = xorg;
+  bmap_yorg = yorg;
+  bmap_ncols = ncols;
+  bmap_nrows = nrows;
 
-  // CPhipps - calloc's
-  blocklists = calloc(NBlocks,sizeof(linelist_t *));
-  blockcount = calloc(NBlocks,sizeof(int));
-  blockdone = malloc(NBlocks*sizeof(int));
+  // bin the lines, a few ranges of lines per thread for load balancing
 
-  // initialize each blocklist, and enter the trailing -1 in all blocklists
-  // note the linked list of lines grows backwards
+  numchunks = MAX(1, MIN(numlines, I_GetNumCPUs() * 4));
+  chunks = (calloc)(numchunks, sizeof(*chunks));
 
-  for (i=0;i<NBlocks;i++)
+  for (i=0;i<numchunks;i++)
   {
-    blocklists[i] = malloc(sizeof(linelist_t));
-    blocklists[i]->num = -1;
-    blocklists[i]->next = NULL;
-    blockcount[i]++;
+    chunks[i].first = (long) numlines * i / numchunks;
+    chunks[i].last = (long) numlines * (i+1) / numchunks;
   }
 
-  // For each linedef in the wad, determine all blockmap blocks it touches,
-  // and add the linedef number to the blocklists for those blocks
+  I_RunParallel(P_BlockLinesJob, chunks, numchunks);
 
-  for (i=0;i<numlines;i++)
-  {
-    int x1 = lines[i].v1->x>>FRACBITS;         // lines[i] map coords
-    int y1 = lines[i].v1->y>>FRACBITS;
-    int x2 = lines[i].v2->x>>FRACBITS;
-    int y2 = lines[i].v2->y>>FRACBITS;
-    int dx = x2-x1;
-    int dy = y2-y1;
-    int vert = !dx;                            // lines[i] slopetype
-    int horiz = !dy;
-    int spos = (dx^dy) > 0;
-    int sneg = (dx^dy) < 0;
-    int bx,by;                                 // block cell coords
-    int minx = x1>x2? x2 : x1;                 // extremal lines[i] coords
-    int maxx = x1>x2? x1 : x2;
-    int miny = y1>y2? y2 : y1;
-    int maxy = y1>y2? y1 : y2;
-
-    // no blocks done for this linedef yet
-
-    memset(blockdone,0,NBlocks*sizeof(int));
-
-    // The line always belongs to the blocks containing its endpoints
-
-    bx = (x1-xorg)>>blkshift;
-    by = (y1-yorg)>>blkshift;
-    AddBlockLine(blocklists,blockcount,blockdone,by*ncols+bx,i);
-    bx = (x2-xorg)>>blkshift;
-    by = (y2-yorg)>>blkshift;
-    AddBlockLine(blocklists,blockcount,blockdone,by*ncols+bx,i);
-
-
-    // For each column, see where the line along its left edge, which
-    // it contains, intersects the Linedef i. Add i to each corresponding
-    // blocklist.
-
-    if (!vert)    // don't interesect vertical lines with columns
-    {
-      for (j=0;j<ncols;j++)
-      {
-        // intersection of Linedef with x=xorg+(j<<blkshift)
-        // (y-y1)*dx = dy*(x-x1)
-        // y = dy*(x-x1)+y1*dx;
-
-        int x = xorg+(j<<blkshift);       // (x,y) is intersection
-        int y = (dy*(x-x1))/dx+y1;
-        int yb = (y-yorg)>>blkshift;      // block row number
-        int yp = (y-yorg)&blkmask;        // y position within block
-
-        if (yb<0 || yb>nrows-1)     // outside blockmap, continue
-          continue;
-
-        if (x<minx || x>maxx)       // line doesn't touch column
-          continue;
-
-        // The cell that contains the intersection point is always added
-
-        AddBlockLine(blocklists,blockcount,blockdone,ncols*yb+j,i);
-
-        // if the intersection is at a corner it depends on the slope
-        // (and whether the line extends past the intersection) which
-        // blocks are hit
-
-        if (yp==0)        // intersection at a corner
-        {
-          if (sneg)       //   \ - blocks x,y-, x-,y
-          {
-            if (yb>0 && miny<y)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*(yb-1)+j,i);
-            if (j>0 && minx<x)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*yb+j-1,i);
-          }
-          else if (spos)  //   / - block x-,y-
-          {
-            if (yb>0 && j>0 && minx<x)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*(yb-1)+j-1,i);
-          }
-          else if (horiz) //   - - block x-,y
-          {
-            if (j>0 && minx<x)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*yb+j-1,i);
-          }
-        }
-        else if (j>0 && minx<x) // else not at corner: x-,y
-          AddBlockLine(blocklists,blockcount,blockdone,ncols*yb+j-1,i);
-      }
-    }
-
-    // For each row, see where the line along its bottom edge, which
-    // it contains, intersects the Linedef i. Add i to all the corresponding
-    // blocklists.
-
-    if (!horiz)
-    {
-      for (j=0;j<nrows;j++)
-      {
-        // intersection of Linedef with y=yorg+(j<<blkshift)
-        // (x,y) on Linedef i satisfies: (y-y1)*dx = dy*(x-x1)
-        // x = dx*(y-y1)/dy+x1;
-
-        int y = yorg+(j<<blkshift);       // (x,y) is intersection
-        int x = (dx*(y-y1))/dy+x1;
-        int xb = (x-xorg)>>blkshift;      // block column number
-        int xp = (x-xorg)&blkmask;        // x position within block
-
-        if (xb<0 || xb>ncols-1)   // outside blockmap, continue
-          continue;
-
-        if (y<miny || y>maxy)     // line doesn't touch row
-          continue;
-
-        // The cell that contains the intersection point is always added
-
-        AddBlockLine(blocklists,blockcount,blockdone,ncols*j+xb,i);
+  // every blocklist has an initial 0 and a trailing -1
+  // count the total number of lines (and 0's and -1's)
 
-        // if the intersection is at a corner it depends on the slope
-        // (and whether the line extends past the intersection) which
-        // blocks are hit
+  blockcount = (malloc)(NBlocks*sizeof(*blockcount));
+  blockpos = (malloc)(NBlocks*sizeof(*blockpos));
 
-        if (xp==0)        // intersection at a corner
-        {
-          if (sneg)       //   \ - blocks x,y-, x-,y
-          {
-            if (j>0 && miny<y)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*(j-1)+xb,i);
-            if (xb>0 && minx<x)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*j+xb-1,i);
-          }
-          else if (vert)  //   | - block x,y-
-          {
-            if (j>0 && miny<y)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*(j-1)+xb,i);
-          }
-          else if (spos)  //   / - block x-,y-
-          {
-            if (xb>0 && j>0 && miny<y)
-              AddBlockLine(blocklists,blockcount,blockdone,ncols*(j-1)+xb-1,i);
-          }
-        }
-        else if (j>0 && miny<y) // else not on a corner: x,y-
-          AddBlockLine(blocklists,blockcount,blockdone,ncols*(j-1)+xb,i);
-      }
-    }
-  }
+  for (i=0;i<NBlocks;i++)
+    blockcount[i] = 2;
 
-  // Add initial 0 to all blocklists
-  // count the total number of lines (and 0's and -1's)
+  for (i=0;i<numchunks;i++)
+    for (j=0;j<chunks[i].numpairs;j++)
+      blockcount[chunks[i].pairs[j*2]]++;
 
-  memset(blockdone,0,NBlocks*sizeof(int));
-  for (i=0,linetotal=0;i<NBlocks;i++)
-  {
-    AddBlockLine(blocklists,blockcount,blockdone,i,0);
+  for (i=0;i<NBlocks;i++)
     linetotal += blockcount[i];
-  }
 
   // Create the blockmap lump
 
-  //blockmaplump = malloc_IfSameLevel(blockmaplump, sizeof(*blockmaplump) * (4 + NBlocks + linetotal));
   blockmaplump = Z_Malloc(sizeof(*blockmaplump) * (4 + NBlocks + linetotal), PU_LEVEL, 0);
 
   // blockmap header
@@ -856,27 +887,30 @@ static void P_CreateBlockMap(void)
 
   for (i=0;i<NBlocks;i++)
   {
-    linelist_t *bl = blocklists[i];
     long offs = blockmaplump[4+i] =   // set offset to block's list
       (i? blockmaplump[4+i-1] : 4+NBlocks) + (i? blockcount[i-1] : 0);
 
-    // add the lines in each block's list to the blockmaplump
-    // delete each list node as we go
+    blockmaplump[offs] = 0;
+    blockmaplump[offs + blockcount[i] - 1] = -1;
+    blockpos[i] = offs + 1;
+  }
 
-    while (bl)
-    {
-      linelist_t *tmp = bl->next;
-      blockmaplump[offs++] = bl->num;
-      free(bl);
-      bl = tmp;
-    }
+  // lines follow in descending order
+
+  for (i=numchunks-1;i>=0;i--)
+  {
+    for (j=chunks[i].numpairs-1;j>=0;j--)
+      blockmaplump[blockpos[chunks[i].pairs[j*2]]++] = chunks[i].pairs[j*2+1];
+    (free)(chunks[i].pairs);
   }
 
   // free all temporary storage
 
-  free (blocklists);
-  free (blockcount);
-  free (blockdone);
+  (free)(chunks);
+  (free)(blockcount);
+  (free)(blockpos);
+
+  return 4 + NBlocks + linetotal;
 }
 
 #else // MBF_STRICT
@@ -894,9 +928,10 @@ static void P_CreateBlockMap(void)
 // Please note: This section of code is not interchangable with TeamTNT's
 // code which attempts to fix the same problem.
 
-static void P_CreateBlockMap(void)
+static long P_CreateBlockMap(void)
 {
   register int i;
+  long lumplen;
   fixed_t minx = INT_MAX, miny = INT_MAX, maxx = INT_MIN, maxy = INT_MIN;
 
   // First find limits of map
@@ -1015,6 +1050,7 @@ static void P_CreateBlockMap(void)
 
       // Allocate blockmap lump with computed count
       blockmaplump = Z_Malloc(sizeof(*blockmaplump) * count, PU_LEVEL, 0);
+      lumplen = count;
     }									 
 
     // Now compress the blockmap.
@@ -1041,6 +1077,8 @@ static void P_CreateBlockMap(void)
       free(bmap);    // Free uncompressed blockmap
     }
   }
+
+  return lumplen;
 }
 
 #endif // MBF_STRICT
@@ -1072,6 +1110,136 @@ static void P_SetSkipBlockStart(void)
     }
 }
 
+//
+// Blockmap cache
+//
+// Generated blockmaps are kept in the config directory, keyed by a hash
+// of the map geometry they are built from.
+
+#define BMAPCACHEMAGIC "WBMP"
+#define BMAPCACHEVERSION 1
+
+static int blockmap_time;       // ms spent to generate or load the blockmap
+static boolean blockmap_cached;
+
+static ULong64 P_BlockMapHash(void)
+{
+  ULong64 hash = 0xcbf29ce484222325ULL;   // FNV-1a
+  int i;
+
+#define HASHINT(x) { unsigned int v_ = (x); int b_; \
+    for (b_ = 0; b_ < 32; b_ += 8) { hash ^= (v_ >> b_) & 0xff; hash *= 0x100000001b3ULL; } }
+
+#ifdef MBF_STRICT
+  HASHINT(1);
+#else
+  HASHINT(0);
+#endif
+  HASHINT(numvertexes);
+  for (i = 0; i < numvertexes; i++)
+  {
+    HASHINT(vertexes[i].x);
+    HASHINT(vertexes[i].y);
+  }
+  HASHINT(numlines);
+  for (i = 0; i < numlines; i++)
+  {
+    HASHINT(lines[i].v1 - vertexes);
+    HASHINT(lines[i].v2 - vertexes);
+  }
+
+#undef HASHINT
+
+  return hash;
+}
+
+static char *P_BlockMapCacheName(void)
+{
+  ULong64 hash = P_BlockMapHash();
+  char *dir = M_StringJoin(D_DoomPrefDir(), DIR_SEPARATOR_S, "blockmap", NULL);
+  char name[32];
+  char *path;
+
+  M_MakeDirectory(dir);
+  M_snprintf(name, sizeof(name), "%08x%08x.bmp",
+             (unsigned int) (hash >> 32), (unsigned int) hash);
+  path = M_StringJoin(dir, DIR_SEPARATOR_S, name, NULL);
+  (free)(dir);
+  return path;
+}
+
+static boolean P_LoadBlockMapCache(const char *path)
+{
+  int32_t header[3], *data = NULL;
+  boolean ok = false;
+  long count = 0, i;
+  FILE *fp;
+
+  if (!(fp = fopen(path, "rb")))
+    return false;
+
+  if (fread(header, sizeof(*header), 3, fp) == 3 &&
+      !memcmp(header, BMAPCACHEMAGIC, 4) &&
+      LONG(header[1]) == BMAPCACHEVERSION)
+  {
+    count = LONG(header[2]);
+
+    if (count >= 4 && count < 0x10000000 &&
+        (data = (malloc)(count * sizeof(*data))) &&
+        fread(data, sizeof(*data), count, fp) == count)
+      ok = true;
+  }
+  fclose(fp);
+
+  if (ok)
+  {
+    blockmaplump = Z_Malloc(sizeof(*blockmaplump) * count, PU_LEVEL, 0);
+    for (i = 0; i < count; i++)
+      blockmaplump[i] = LONG(data[i]);
+
+    bmaporgx = blockmaplump[0];
+    bmaporgy = blockmaplump[1];
+    bmapwidth = blockmaplump[2];
+    bmapheight = blockmaplump[3];
+  }
+
+  (free)(data);
+  return ok;
+}
+
+static void P_SaveBlockMapCache(const char *path, long count)
+{
+  int32_t header[3], *data;
+  boolean ok;
+  long i;
+  FILE *fp;
+
+  if (!(fp = fopen(path, "wb")))
+    return;
+
+  data = (malloc)(count * sizeof(*data));
+
+  // the blockmap parameters go into the header words of the lump
+  data[0] = LONG(bmaporgx);
+  data[1] = LONG(bmaporgy);
+  data[2] = LONG(bmapwidth);
+  data[3] = LONG(bmapheight);
+  for (i = 4; i < count; i++)
+    data[i] = LONG(blockmaplump[i]);
+
+  memcpy(header, BMAPCACHEMAGIC, 4);
+  header[1] = LONG(BMAPCACHEVERSION);
+  header[2] = LONG(count);
+
+  ok = fwrite(header, sizeof(*header), 3, fp) == 3 &&
+       fwrite(data, sizeof(*data), count, fp) == count;
+  fclose(fp);
+  (free)(data);
+
+  if (!ok)
+    remove(path);
+}
+
 //
 // P_LoadBlockMap
 //
@@ -1088,7 +1256,14 @@ boolean P_LoadBlockMap (int lump)
 
   if (M_CheckParm("-blockmap") || (count = W_LumpLength(lump)/2) >= 0x10000 || count < 4) // [FG] always rebuild too short blockmaps
   {
-    P_CreateBlockMap();
+    uint64_t start = I_GetTimeUS();
+    char *path = P_BlockMapCacheName();
+
+    if (!(blockmap_cached = P_LoadBlockMapCache(path)))
+      P_SaveBlockMapCache(path, P_CreateBlockMap());
+
+    (free)(path);
+    blockmap_time = (int) ((I_GetTimeUS() - start) / 1000);
   }
   else
     {
@@ -1128,6 +1303,8 @@ boolean P_LoadBlockMap (int lump)
   count = sizeof(*blocklinks)* bmapwidth*bmapheight;
   blocklinks = Z_Malloc (count,PU_LEVEL, 0);
   memset (blocklinks, 0, count);
+  targetlinks = Z_Malloc (count*2,PU_LEVEL, 0);
+  memset (targetlinks, 0, count*2);
   blockmap = blockmaplump+4;
 
   return ret;
@@ -1425,7 +1602,8 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
   char  lumpname[9];
   int   lumpnum;
   mapformat_t mapformat;
-  boolean gen_blockmap, pad_reject;
+  boolean gen_blockmap, pad_reject, build_rej;
+  uint64_t setup_start = I_GetTimeUS();
 
   totalkills = totalitems = totalsecret = wminfo.maxfrags = 0;
   // [crispy] count spawned monsters
@@ -1452,6 +1630,8 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
 
   P_InitThinkers();
 
+  P_ClearSightCache();
+
   // if working with a devlopment map, reload it
   //    W_Reload ();     killough 1/31/98: W_Reload obsolete
 
@@ -1463,6 +1643,9 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
 
   lumpnum = W_GetNumForName(lumpname);
 
+  // take over what has been loaded during the intermission
+  P_WaitPreload(lumpnum);
+
   leveltime = 0;
   oldleveltime = 0;
 
@@ -1503,6 +1686,9 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
   // [FG] pad the REJECT table when the lump is too small
   pad_reject = P_LoadReject (lumpnum+ML_REJECT, P_GroupLines());
 
+  // build a REJECT table if the map does not ship a usable one
+  build_rej = P_BuildReject(lumpnum);
+
   P_RemoveSlimeTrails();    // killough 10/98: remove slime trails from wad
 
   // [FG] seg lengths and angles used for rendering
@@ -1541,6 +1727,11 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
   P_SpawnSpecials();
 
   // preload graphics
+  P_LinkPreload();
+
+  // compose all wall textures of the level now rather than while rendering
+  R_BuildLevelComposites();
+
   if (precache)
     R_PrecacheLevel();
 
@@ -1553,7 +1744,7 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
       nomonsters ? " -nomonsters" : "",
       NULL);
 
-    fprintf(stderr, "P_SetupLevel: %.8s (%s), %s%s%s, Skill %d%s, Total %d:%02d:%02d, Demo Version %d\n",
+    fprintf(stderr, "P_SetupLevel: %.8s (%s), %s%s%s%s, Skill %d%s, Total %d:%02d:%02d, Demo Version %d\n",
       lumpname, W_WadNameForLump(lumpnum),
       mapformat == MFMT_ZDBSPX ? "ZDBSP nodes" :
       mapformat == MFMT_ZDBSPZ ? "compressed ZDBSP nodes" :
@@ -1561,10 +1752,19 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
       "Doom nodes",
       gen_blockmap ? " + generated Blockmap" : "",
       pad_reject ? " + padded Reject table" : "",
+      build_rej ? " + built Reject table" : "",
       (int)skill, rfn_str,
       ttime/3600, (ttime%3600)/60, ttime%60,
       demo_version);
 
+    if (gen_blockmap)
+      fprintf(stderr, "P_SetupLevel: loaded in %d ms, blockmap %s in %d ms\n",
+        (int) ((I_GetTimeUS() - setup_start) / 1000),
+        blockmap_cached ? "read from cache" : "generated", blockmap_time);
+    else
+      fprintf(stderr, "P_SetupLevel: loaded in %d ms\n",
+        (int) ((I_GetTimeUS() - setup_start) / 1000));
+
     (free)(rfn_str);
   }
 }
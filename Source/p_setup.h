@@ -45,6 +45,7 @@ extern int      bmapheight;      // in mapblocks
 extern fixed_t  bmaporgx;
 extern fixed_t  bmaporgy;        // origin of block map
 extern mobj_t   **blocklinks;    // for thing chains
+extern mobj_t   **targetlinks;   // possible monster targets, see p_maputl.c
 
 extern boolean skipblstart; // MaxW: Skip initial blocklist short
 
@@ -26,8 +26,11 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <string.h>
+
 #include "doomstat.h"
 #include "r_main.h"
+#include "p_map.h"
 #include "p_maputl.h"
 #include "p_setup.h"
 #include "m_bbox.h"
@@ -211,14 +214,14 @@ static boolean P_CrossBSPNode(int bspnum, register los_t *los)
 }
 
 //
-// P_CheckSight
+// CheckSight
 // Returns true
 //  if a straight line between t1 and t2 is unobstructed.
-// Uses REJECT.
+// Uses REJECT. Sets *traced if the BSP has been traversed.
 //
 // killough 4/20/98: cleaned up, made to use new LOS struct
 
-boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
+static boolean CheckSight(mobj_t *t1, mobj_t *t2, boolean *traced)
 {
   const sector_t *s1 = t1->subsector->sector;
   const sector_t *s2 = t2->subsector->sector;
@@ -257,6 +260,7 @@ boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
   // Now look from eyes of t1 to any part of t2.
 
   validcount++;
+  *traced = true;
 
   los.topslope = (los.bottomslope = t2->z - (los.sightzstart =
                                              t1->z + t1->height -
@@ -278,6 +282,75 @@ boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
   return P_CrossBSPNode(numnodes-1, &los);
 }
 
+//
+// Sight check cache
+//
+// Many monsters look for the same few targets in one tic. The result of a
+// check only depends on the positions and heights of both things and on
+// the sector heights, so it is kept until the next tic or until a floor or
+// ceiling moves.
+
+#define SIGHTCACHESIZE 4096
+
+typedef struct {
+  const subsector_t *ss1, *ss2;
+  fixed_t x1, y1, z1, h1;
+  fixed_t x2, y2, z2, h2;
+  unsigned int stamp;
+  boolean result, traced;
+} sightcache_t;
+
+static sightcache_t sightcache[SIGHTCACHESIZE];
+static unsigned int sightstamp = 1;
+
+unsigned int sight_checks, sight_hits;
+
+void P_ClearSightCache(void)
+{
+  if (!++sightstamp)
+    {
+      memset(sightcache, 0, sizeof(sightcache));
+      sightstamp = 1;
+    }
+}
+
+boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
+{
+  unsigned int hash;
+  sightcache_t *c;
+
+  hash = (unsigned int) t1->x * 0x9e3779b1u ^ (unsigned int) t1->y * 0x85ebca6bu ^
+         (unsigned int) t2->x * 0xc2b2ae35u ^ (unsigned int) t2->y * 0x27d4eb2fu ^
+         (unsigned int) t1->z ^ (unsigned int) t2->z * 0x165667b1u;
+  c = &sightcache[(hash ^ hash >> 15) & (SIGHTCACHESIZE - 1)];
+
+  sight_checks++;
+
+  if (c->stamp == sightstamp &&
+      c->ss1 == t1->subsector && c->ss2 == t2->subsector &&
+      c->x1 == t1->x && c->y1 == t1->y && c->z1 == t1->z && c->h1 == t1->height &&
+      c->x2 == t2->x && c->y2 == t2->y && c->z2 == t2->z && c->h2 == t2->height)
+    {
+      sight_hits++;
+
+      // keep validcount in step with an uncached check
+      if (c->traced)
+        validcount++;
+
+      return c->result;
+    }
+
+  c->stamp = sightstamp;
+  c->ss1 = t1->subsector;
+  c->ss2 = t2->subsector;
+  c->x1 = t1->x; c->y1 = t1->y; c->z1 = t1->z; c->h1 = t1->height;
+  c->x2 = t2->x; c->y2 = t2->y; c->z2 = t2->z; c->h2 = t2->height;
+  c->traced = false;
+  c->result = CheckSight(t1, t2, &c->traced);
+
+  return c->result;
+}
+
 //
 // mbf21: P_CheckFov
 // Returns true if t2 is within t1's field of view.
@@ -173,6 +173,27 @@ void P_InitPicAnims (void)
   Z_ChangeTag (animdefs,PU_CACHE); //jff 3/23/98 allow table to be freed
 }
 
+//
+// P_MarkAnimTextures
+// Marks every frame of the texture animations that have a frame marked.
+//
+
+void P_MarkAnimTextures(byte *hitlist)
+{
+  const anim_t *anim;
+  int i, j;
+
+  for (anim = anims; anim < lastanim; anim++)
+    if (anim->istexture)
+      for (i = anim->basepic; i < anim->basepic + anim->numpics; i++)
+        if (hitlist[i])
+        {
+          for (j = anim->basepic; j < anim->basepic + anim->numpics; j++)
+            hitlist[j] = 1;
+          break;
+        }
+}
+
 ///////////////////////////////////////////////////////////////
 //
 // Linedef and Sector Special Implementation Utility Functions
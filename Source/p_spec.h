@@ -955,6 +955,11 @@ void P_InitSwitchList(void);
 // at map load
 void P_SpawnSpecials(void);
 
+// Also mark the other frames of animated textures and the other side of
+// switches that are marked in hitlist, indexed by texture number.
+void P_MarkAnimTextures(byte *hitlist);
+void P_MarkSwitchTextures(byte *hitlist);
+
 // every tic
 void P_UpdateSpecials(void);
 
@@ -110,6 +110,20 @@ void P_InitSwitchList(void)
   Z_ChangeTag(alphSwitchList,PU_CACHE); //jff 3/23/98 allow table to be freed
 }
 
+//
+// P_MarkSwitchTextures
+// Marks the other texture of the switches that have one texture marked.
+//
+
+void P_MarkSwitchTextures(byte *hitlist)
+{
+  int i;
+
+  for (i = 0; i < numswitches*2; i++)
+    if (hitlist[switchlist[i]])
+      hitlist[switchlist[i^1]] = 1;
+}
+
 //
 // P_StartButton()
 //
@@ -27,10 +27,13 @@
 //-----------------------------------------------------------------------------
 
 #include "doomstat.h"
+#include "p_map.h"
+#include "p_maputl.h"
 #include "p_user.h"
 #include "p_spec.h"
 #include "p_tick.h"
 #include "s_musinfo.h" // [crispy] T_MAPMusic()
+#include "d_bench.h"
 
 int leveltime;
 int oldleveltime;
@@ -103,6 +106,10 @@ void P_UpdateThinker(thinker_t *thinker)
    thinker->cnext = th;
    thinker->cprev = th->cprev;
    th->cprev = thinker;
+
+   // keep the target chains of the blockmap in step
+   if (thinker->function == P_MobjThinker)
+     P_UpdateTargetLink((mobj_t *) thinker);
 }
 
 //
@@ -263,6 +270,10 @@ void P_Ticker (void)
 		 players[consoleplayer].viewz != 1))
     return;
 
+  D_BenchStart(bench_ticker);
+
+  P_ClearSightCache();
+
   for (i=0; i<MAXPLAYERS; i++)
     if (playeringame[i])
       P_PlayerThink(&players[i]);
@@ -271,6 +282,8 @@ void P_Ticker (void)
   P_UpdateSpecials();
   P_RespawnSpecials();
   leveltime++;                       // for par times
+
+  D_BenchStop(bench_ticker);
 }
 
 //----------------------------------------------------------------------------
@@ -35,19 +35,19 @@
 #include "r_plane.h"
 #include "r_things.h"
 
-seg_t     *curline;
-side_t    *sidedef;
-line_t    *linedef;
-sector_t  *frontsector;
-sector_t  *backsector;
-drawseg_t *ds_p;
+THREAD_LOCAL seg_t     *curline;
+THREAD_LOCAL side_t    *sidedef;
+THREAD_LOCAL line_t    *linedef;
+THREAD_LOCAL sector_t  *frontsector;
+THREAD_LOCAL sector_t  *backsector;
+THREAD_LOCAL drawseg_t *ds_p;
 
 // killough 4/7/98: indicates doors closed wrt automap bugfix:
-int      doorclosed;
+THREAD_LOCAL int      doorclosed;
 
 // killough: New code which removes 2s linedef limit
-drawseg_t *drawsegs;
-unsigned  maxdrawsegs;
+THREAD_LOCAL drawseg_t *drawsegs;
+THREAD_LOCAL unsigned  maxdrawsegs;
 // drawseg_t drawsegs[MAXDRAWSEGS];       // old code -- killough
 
 //
@@ -94,7 +94,7 @@ typedef struct {
 // Replaces the old R_Clip*WallSegment functions. It draws bits of walls in those
 // columns which aren't solid, and updates the solidcol[] array appropriately
 
-byte solidcol[MAX_SCREENWIDTH];
+THREAD_LOCAL byte solidcol[MAX_SCREENWIDTH];
 
 static void R_ClipWallSegment(int first, int last, boolean solid)
 {
@@ -300,6 +300,17 @@ static void R_MaybeInterpolateSector(sector_t* sector)
     }
 }
 
+// Interpolate all sectors up front, once per frame, instead of while
+// walking the BSP tree. Render threads then never write to the level.
+
+void R_InterpolateSectors(void)
+{
+  int i;
+
+  for (i = 0; i < numsectors; i++)
+    R_MaybeInterpolateSector(&sectors[i]);
+}
+
 //
 // R_AddLine
 // Clips the given segment
@@ -314,7 +325,7 @@ static void R_AddLine (seg_t *line)
   angle_t  angle2;
   angle_t  span;
   angle_t  tspan;
-  static sector_t tempsec;     // killough 3/8/98: ceiling/water hack
+  static THREAD_LOCAL sector_t tempsec; // killough 3/8/98: ceiling/water hack
 
   curline = line;
 
@@ -382,9 +393,10 @@ static void R_AddLine (seg_t *line)
   doorclosed = 0;       // killough 4/16/98
 
   // [AM] Interpolate sector movement before
-  //      running clipping tests.  Frontsector
-  //      should already be interpolated.
-  R_MaybeInterpolateSector(backsector);
+  //      running clipping tests.  Real sectors
+  //      have already been interpolated.
+  if (backsector == &tempsec)
+    R_MaybeInterpolateSector(backsector);
 
   // Closed door.
 
@@ -554,15 +566,6 @@ static void R_Subsector(int num)
   count = sub->numlines;
   line = &segs[sub->firstline];
 
-  // [AM] Interpolate sector movement.  Usually only needed
-  //      when you're standing inside the sector.
-  R_MaybeInterpolateSector(frontsector);
-
-  if (frontsector->heightsec != -1)
-  {
-    R_MaybeInterpolateSector(&sectors[frontsector->heightsec]);
-  }
-
   // killough 3/8/98, 4/4/98: Deep water / fake ceiling effect
   frontsector = R_FakeFlat(frontsector, &tempsec, &floorlightlevel,
                            &ceilinglightlevel, false);   // killough 4/11/98
@@ -31,30 +31,31 @@
 
 #include "r_defs.h"
 
-extern seg_t    *curline;
-extern side_t   *sidedef;
-extern line_t   *linedef;
-extern sector_t *frontsector;
-extern sector_t *backsector;
-extern int      rw_x;
-extern int      rw_stopx;
-extern boolean  segtextured;
-extern boolean  markfloor;      // false if the back side is the same plane
-extern boolean  markceiling;
+extern THREAD_LOCAL seg_t    *curline;
+extern THREAD_LOCAL side_t   *sidedef;
+extern THREAD_LOCAL line_t   *linedef;
+extern THREAD_LOCAL sector_t *frontsector;
+extern THREAD_LOCAL sector_t *backsector;
+extern THREAD_LOCAL int      rw_x;
+extern THREAD_LOCAL int      rw_stopx;
+extern THREAD_LOCAL boolean  segtextured;
+extern THREAD_LOCAL boolean  markfloor;      // false if the back side is the same plane
+extern THREAD_LOCAL boolean  markceiling;
 
 // old code -- killough:
 // extern drawseg_t drawsegs[MAXDRAWSEGS];
 // new code -- killough:
-extern drawseg_t *drawsegs;
-extern unsigned maxdrawsegs;
+extern THREAD_LOCAL drawseg_t *drawsegs;
+extern THREAD_LOCAL unsigned maxdrawsegs;
 
-extern drawseg_t *ds_p;
+extern THREAD_LOCAL drawseg_t *ds_p;
 
-extern byte solidcol[];
+extern THREAD_LOCAL byte solidcol[];
 
 void R_ClearClipSegs(void);
 void R_ClearDrawSegs(void);
 void R_RenderBSPNode(int bspnum);
+void R_InterpolateSectors(void);
 int R_DoorClosed(void);   // killough 1/17/98
 
 // killough 4/13/98: fake floors/ceilings for deep water / fake ceilings:
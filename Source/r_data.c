@@ -29,12 +29,17 @@
 
 #include "doomstat.h"
 #include "p_tick.h"
+#include "p_spec.h" // P_MarkAnimTextures(), P_MarkSwitchTextures()
 #include "w_wad.h"
 #include "r_main.h"
 #include "r_sky.h"
 #include "d_io.h"
 #include "m_argv.h" // M_CheckParm()
 #include "v_video.h" // cr_dark
+#include "i_thread.h"
+#include "i_system.h" // I_GetTimeUS()
+#include "m_misc2.h" // M_MakeDirectory()
+#include "d_main.h" // D_DoomPrefDir()
 
 #ifdef _WIN32
 #include "../win32/win_fopen.h"
@@ -192,58 +197,57 @@ static void R_DrawColumnInCache(const column_t *patch, byte *cache,
 }
 
 //
-// R_GenerateComposite
-// Using the texture definition,
-//  the composite texture is created from the patches,
-//  and each column is cached.
+// R_DrawPatchInComposite
+// Draws one patch of a texture into the composite,
+//  marking the cells it covers.
 //
-// Rewritten by Lee Killough for performance and to fix Medusa bug
 
-static void R_GenerateComposite(int texnum)
+static void R_DrawPatchInComposite(int texnum, const texpatch_t *patch,
+                                   const patch_t *realpatch,
+                                   byte *block, byte *marks)
 {
-  byte *block = Z_Malloc(texturecompositesize[texnum], PU_STATIC,
-                         (void **) &texturecomposite[texnum]);
-  texture_t *texture = textures[texnum];
-  // Composite the columns together.
-  texpatch_t *patch = texture->patches;
-  short *collump = texturecolumnlump[texnum];
-  unsigned *colofs = texturecolumnofs[texnum]; // killough 4/9/98: make 32-bit
-  unsigned *colofs2 = texturecolumnofs2[texnum];
-  int i = texture->patchcount;
-  // killough 4/9/98: marks to identify transparent regions in merged textures
-  byte *marks = calloc(texture->width, texture->height), *source;
-
-  // [FG] memory block for opaque textures
-  byte *block2 = Z_Malloc(texture->width * texture->height, PU_STATIC,
-                          (void **) &texturecomposite2[texnum]);
-  // [FG] initialize composite background to palette index 0 (usually black)
-  memset(block, 0, texturecompositesize[texnum]);
+  const texture_t *texture = textures[texnum];
+  const short *collump = texturecolumnlump[texnum];
+  const unsigned *colofs = texturecolumnofs[texnum];
+  int x, x1 = patch->originx, x2 = x1 + SHORT(realpatch->width);
+  const int *cofs = realpatch->columnofs - x1;
+
+  if (x1 < 0)
+    x1 = 0;
+  if (x2 > texture->width)
+    x2 = texture->width;
+  for (x = x1; x < x2 ; x++)
+    // [FG] generate composites for single-patched columns as well
+//  if (collump[x] == -1)      // Column has multiple patches?
+      // killough 1/25/98, 4/9/98: Fix medusa bug.
+      R_DrawColumnInCache((column_t*)((byte*) realpatch + LONG(cofs[x])),
+                          // [FG] single-patched columns are normally not composited
+                          // but directly read from the patch lump ignoring their originy
+                          block + colofs[x], collump[x] == -1 ? patch->originy : 0,
+                          texture->height, marks + x*texture->height);
+}
 
-  for (; --i >=0; patch++)
-    {
-      patch_t *realpatch = W_CacheLumpNum(patch->patch, PU_CACHE);
-      int x, x1 = patch->originx, x2 = x1 + SHORT(realpatch->width);
-      const int *cofs = realpatch->columnofs - x1;
+//
+// R_FinishComposite
+// Converts the drawn columns into posts
+//  and fills the opaque composite.
+//
 
-      if (x1 < 0)
-        x1 = 0;
-      if (x2 > texture->width)
-        x2 = texture->width;
-      for (x = x1; x < x2 ; x++)
-        // [FG] generate composites for single-patched columns as well
-//      if (collump[x] == -1)      // Column has multiple patches?
-          // killough 1/25/98, 4/9/98: Fix medusa bug.
-          R_DrawColumnInCache((column_t*)((byte*) realpatch + LONG(cofs[x])),
-                              // [FG] single-patched columns are normally not composited
-                              // but directly read from the patch lump ignoring their originy
-                              block + colofs[x], collump[x] == -1 ? patch->originy : 0,
-			      texture->height, marks + x*texture->height);
-    }
+static void R_FinishComposite(int texnum, byte *block, byte *block2,
+                              const byte *marks)
+{
+  const texture_t *texture = textures[texnum];
+  const unsigned *colofs = texturecolumnofs[texnum]; // killough 4/9/98: make 32-bit
+  const unsigned *colofs2 = texturecolumnofs2[texnum];
+  byte *source;
+  int i;
 
   // killough 4/9/98: Next, convert multipatched columns into true columns,
   // to fix Medusa bug while still allowing for transparent regions.
 
-  source = malloc(texture->height);       // temporary column
+  source = (malloc)(texture->height);     // temporary column
+  if (!source)
+    I_Error("R_FinishComposite: out of memory");
   for (i=0; i < texture->width; i++)
     // [FG] generate composites for all columns
 //  if (collump[i] == -1)                 // process only multipatched columns
@@ -296,8 +300,54 @@ static void R_GenerateComposite(int texnum)
             col = (column_t *)((byte *) col + len + 4); // next post
           }
       }
-  free(source);         // free temporary column
-  free(marks);          // free transparency marks
+  (free)(source);       // free temporary column
+}
+
+//
+// R_GenerateComposite
+// Using the texture definition,
+//  the composite texture is created from the patches,
+//  and each column is cached.
+//
+// Rewritten by Lee Killough for performance and to fix Medusa bug
+
+static void R_GenerateComposite(int texnum)
+{
+  byte *block = Z_Malloc(texturecompositesize[texnum], PU_STATIC,
+                         (void **) &texturecomposite[texnum]);
+  texture_t *texture = textures[texnum];
+  // Composite the columns together.
+  texpatch_t *patch = texture->patches;
+  int i = texture->patchcount;
+  // killough 4/9/98: marks to identify transparent regions in merged textures
+  byte *marks = (calloc)(texture->width, texture->height);
+
+  // [FG] memory block for opaque textures
+  byte *block2 = Z_Malloc(texture->width * texture->height, PU_STATIC,
+                          (void **) &texturecomposite2[texnum]);
+
+  if (!marks)
+    I_Error("R_GenerateComposite: out of memory");
+
+  // Keep the composites hidden from other render threads until they are
+  // complete, see R_CacheComposite().
+  texturecomposite[texnum] = texturecomposite2[texnum] = NULL;
+
+  // [FG] initialize composite background to palette index 0 (usually black)
+  memset(block, 0, texturecompositesize[texnum]);
+
+  for (; --i >=0; patch++)
+    R_DrawPatchInComposite(texnum, patch,
+                           W_CacheLumpNum(patch->patch, PU_CACHE),
+                           block, marks);
+
+  R_FinishComposite(texnum, block, block2, marks);
+  (free)(marks);        // free transparency marks
+
+  // publish the finished composites
+  I_ReleaseBarrier();
+  texturecomposite[texnum] = block;
+  texturecomposite2[texnum] = block2;
 
   // Now that the texture has been built in column cache,
   // it is purgable from zone memory.
@@ -306,6 +356,114 @@ static void R_GenerateComposite(int texnum)
   Z_ChangeTag(block2, PU_CACHE);
 }
 
+//
+// R_ComposeTexture
+// Builds both composites of a texture into one buffer from the libc heap,
+//  the opaque one following texturecompositesize[texnum] bytes in.
+//  patches[i] holds the lump data of the texture's i-th patch.
+//  Neither the zone nor the lump cache is touched, so that the level
+//  preloader may call this from its own thread.
+//
+
+byte *R_ComposeTexture(int texnum, const patch_t *const *patches)
+{
+  const texture_t *texture = textures[texnum];
+  const int size = texturecompositesize[texnum];
+  byte *block = (calloc)(1, size + texture->width * texture->height);
+  byte *marks = (calloc)(texture->width, texture->height);
+  int i;
+
+  if (!block || !marks)
+  {
+    (free)(block);
+    (free)(marks);
+    return NULL;
+  }
+
+  for (i = 0; i < texture->patchcount; i++)
+    R_DrawPatchInComposite(texnum, &texture->patches[i], patches[i],
+                           block, marks);
+
+  R_FinishComposite(texnum, block, block + size, marks);
+  (free)(marks);
+
+  return block;
+}
+
+// Installs a composite built by R_ComposeTexture(), unless the renderer
+// has generated that texture on its own meanwhile.
+
+void R_LinkComposite(int texnum, const byte *data)
+{
+  const texture_t *texture = textures[texnum];
+  const int size = texturecompositesize[texnum];
+  byte *block, *block2;
+
+  R_LockCache();
+  if (!texturecomposite[texnum] || !texturecomposite2[texnum])
+  {
+    block = Z_Malloc(size, PU_STATIC, (void **) &texturecomposite[texnum]);
+    block2 = Z_Malloc(texture->width * texture->height, PU_STATIC,
+                      (void **) &texturecomposite2[texnum]);
+    texturecomposite[texnum] = texturecomposite2[texnum] = NULL;
+
+    memcpy(block, data, size);
+    memcpy(block2, data + size, texture->width * texture->height);
+
+    I_ReleaseBarrier();
+    texturecomposite[texnum] = block;
+    texturecomposite2[texnum] = block2;
+
+    Z_ChangeTag(block, PU_CACHE);
+    Z_ChangeTag(block2, PU_CACHE);
+  }
+  R_UnlockCache();
+}
+
+// Patch lumps of a texture, for the level preloader.
+
+int R_TexturePatchCount(int texnum)
+{
+  return textures[texnum]->patchcount;
+}
+
+int R_TexturePatchLump(int texnum, int i)
+{
+  return textures[texnum]->patches[i].patch;
+}
+
+//
+// R_LockCache
+//
+// Serializes zone and lump cache accesses of the split-screen renderer's
+// threads. Does nothing while rendering single-threaded.
+//
+
+static i_mutex_t *cache_mutex;
+
+void R_LockCache(void)
+{
+  if (r_parallel)
+    I_LockMutex(cache_mutex);
+}
+
+void R_UnlockCache(void)
+{
+  if (r_parallel)
+    I_UnlockMutex(cache_mutex);
+}
+
+// Generates a missing composite. Another thread may have been quicker.
+
+static void R_CacheComposite(int texnum)
+{
+  R_LockCache();
+  if (!texturecomposite[texnum] || !texturecomposite2[texnum])
+    R_GenerateComposite(texnum);
+  R_UnlockCache();
+  I_AcquireBarrier();
+}
+
 //
 // R_GenerateLookup
 //
@@ -499,7 +657,7 @@ byte *R_GetColumn(int tex, int col)
   ofs  = texturecolumnofs2[tex][col];
 
   if (!texturecomposite2[tex])
-    R_GenerateComposite(tex);
+    R_CacheComposite(tex);
 
   return texturecomposite2[tex] + ofs;
 }
@@ -516,7 +674,7 @@ byte *R_GetColumnMod(int tex, int col)
   ofs  = texturecolumnofs[tex][col];
 
   if (!texturecomposite[tex])
-    R_GenerateComposite(tex);
+    R_CacheComposite(tex);
 
   return texturecomposite[tex] + ofs;
 }
@@ -862,6 +1020,153 @@ int tran_filter_pct = 66;       // filter percent
 
 #define TSC 12        /* number of fixed point digits in filter percent */
 
+// Parallel translucency table builder.
+//
+// Each row of the table is an independent job. All intermediate values
+// fit into 32 bits (|err| < 2^30 for 8-bit palette entries and TSC 12),
+// so the vector kernel computes exactly what the original long int code
+// did. The search picks the highest color index among equal errors, as
+// the original downward search with a strict comparison did.
+
+typedef struct
+{
+  int32_t pal[3][256], tot[256], pal_w1[3][256];
+  int32_t w2;
+  byte *tranmap;
+} tranmapjob_t;
+
+static void TranMapRow_Scalar(const tranmapjob_t *job, int i, byte *tp)
+{
+  int32_t r1 = job->pal[0][i] * job->w2;
+  int32_t g1 = job->pal[1][i] * job->w2;
+  int32_t b1 = job->pal[2][i] * job->w2;
+  int j;
+
+  for (j=0;j<256;j++,tp++)
+    {
+      register int color = 255;
+      register int32_t err;
+      int32_t r = job->pal_w1[0][j] + r1;
+      int32_t g = job->pal_w1[1][j] + g1;
+      int32_t b = job->pal_w1[2][j] + b1;
+      int32_t best = INT32_MAX;
+      do
+        if ((err = job->tot[color] - job->pal[0][color]*r
+            - job->pal[1][color]*g - job->pal[2][color]*b) < best)
+          best = err, *tp = color;
+      while (--color >= 0);
+    }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+#define HAVE_AVX2_TRANMAP
+
+// Eight colors per step. Colors are scanned upwards, so a lane takes a
+// new color on ties, and the lanes are merged preferring the higher index.
+
+__attribute__((target("avx2")))
+static void TranMapRow_AVX2(const tranmapjob_t *job, int i, byte *tp)
+{
+  int32_t r1 = job->pal[0][i] * job->w2;
+  int32_t g1 = job->pal[1][i] * job->w2;
+  int32_t b1 = job->pal[2][i] * job->w2;
+  int j;
+
+  for (j=0;j<256;j++)
+    {
+      __m256i r = _mm256_set1_epi32(job->pal_w1[0][j] + r1);
+      __m256i g = _mm256_set1_epi32(job->pal_w1[1][j] + g1);
+      __m256i b = _mm256_set1_epi32(job->pal_w1[2][j] + b1);
+      __m256i best = _mm256_set1_epi32(INT32_MAX);
+      __m256i bestcolor = _mm256_setzero_si256();
+      __m256i color = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+      const __m256i eight = _mm256_set1_epi32(8);
+      int32_t lane_err[8], lane_color[8];
+      int c, k;
+
+      for (c = 0; c < 256; c += 8)
+        {
+          __m256i err = _mm256_loadu_si256((const __m256i *) &job->tot[c]);
+          __m256i take;
+
+          err = _mm256_sub_epi32(err, _mm256_mullo_epi32(
+                  _mm256_loadu_si256((const __m256i *) &job->pal[0][c]), r));
+          err = _mm256_sub_epi32(err, _mm256_mullo_epi32(
+                  _mm256_loadu_si256((const __m256i *) &job->pal[1][c]), g));
+          err = _mm256_sub_epi32(err, _mm256_mullo_epi32(
+                  _mm256_loadu_si256((const __m256i *) &job->pal[2][c]), b));
+
+          // err <= best
+          take = _mm256_cmpgt_epi32(err, best);
+          bestcolor = _mm256_blendv_epi8(color, bestcolor, take);
+          best = _mm256_min_epi32(best, err);
+          color = _mm256_add_epi32(color, eight);
+        }
+
+      _mm256_storeu_si256((__m256i *) lane_err, best);
+      _mm256_storeu_si256((__m256i *) lane_color, bestcolor);
+
+      for (c = 0, k = 1; k < 8; k++)
+        if (lane_err[k] < lane_err[c] ||
+            (lane_err[k] == lane_err[c] && lane_color[k] > lane_color[c]))
+          c = k;
+
+      tp[j] = lane_color[c];
+    }
+}
+#endif
+
+static void (*TranMapRow)(const tranmapjob_t *, int, byte *) = TranMapRow_Scalar;
+
+static void TranMapJob(void *data, int i)
+{
+  const tranmapjob_t *job = data;
+  TranMapRow(job, i, job->tranmap + i*256);
+}
+
+//
+// R_BuildTranMap
+//
+// Compute a 256x256 translucency table for the given palette and
+// filter percentage, on all worker threads.
+//
+
+static void R_BuildTranMap(byte *tranmap, const byte *playpal, int pct)
+{
+  static tranmapjob_t job;      // too large for the stack of some ports
+  int32_t w1 = ((uint32_t) pct<<TSC)/100;
+  int i;
+
+#ifdef HAVE_AVX2_TRANMAP
+  if (!M_CheckParm("-nosimd") && __builtin_cpu_supports("avx2"))
+    TranMapRow = TranMapRow_AVX2;
+#endif
+
+  job.w2 = (1l<<TSC)-w1;
+  job.tranmap = tranmap;
+
+  // Convert playpal into int type, and transpose array,
+  // for fast inner-loop calculations. Precompute tot array.
+
+  for (i = 0; i < 256; i++)
+    {
+      const byte *p = playpal + i*3;
+      int32_t d = 0, t;
+      int k;
+
+      for (k = 0; k < 3; k++)
+        {
+          job.pal_w1[k][i] = (job.pal[k][i] = t = p[k]) * w1;
+          d += t*t;
+        }
+      job.tot[i] = d << (TSC-1);
+    }
+
+  I_RunParallel(TranMapJob, &job, 256);
+}
+
 void R_InitTranMap(int progress)
 {
   int lump = W_CheckNumForName("TRANMAP");
@@ -874,8 +1179,6 @@ void R_InitTranMap(int progress)
   else
     {   // Compose a default transparent filter map based on PLAYPAL.
       unsigned char *playpal = W_CacheLumpName("PLAYPAL", PU_STATIC);
-      extern const char *D_DoomPrefDir(void);
-      extern char *M_StringJoin(const char *s, ...);
       char *fname = M_StringJoin(D_DoomPrefDir(), DIR_SEPARATOR_S, "tranmap.dat", NULL);
       struct {
         unsigned char pct;
@@ -894,69 +1197,14 @@ void R_InitTranMap(int progress)
           fread(main_tranmap, 256, 256, cachefp) != 256 ||  // killough 4/11/98
           force_rebuild)
         {
-          long pal[3][256], tot[256], pal_w1[3][256];
-          long w1 = ((unsigned long) tran_filter_pct<<TSC)/100;
-          long w2 = (1l<<TSC)-w1;
-
-          // First, convert playpal into long int type, and transpose array,
-          // for fast inner-loop calculations. Precompute tot array.
-
-          {
-            register int i = 255;
-            register const unsigned char *p = playpal+255*3;
-            do
-              {
-                register long t,d;
-                pal_w1[0][i] = (pal[0][i] = t = p[0]) * w1;
-                d = t*t;
-                pal_w1[1][i] = (pal[1][i] = t = p[1]) * w1;
-                d += t*t;
-                pal_w1[2][i] = (pal[2][i] = t = p[2]) * w1;
-                d += t*t;
-                p -= 3;
-                tot[i] = d << (TSC-1);
-              }
-            while (--i>=0);
-          }
+          // display flashing disk
+          I_BeginRead(DISK_ICON_THRESHOLD);
 
-          // Next, compute all entries using minimum arithmetic.
+          R_BuildTranMap(main_tranmap, playpal, tran_filter_pct);
 
-          {
-            int i,j;
-            byte *tp = main_tranmap;
-            for (i=0;i<256;i++)
-              {
-                long r1 = pal[0][i] * w2;
-                long g1 = pal[1][i] * w2;
-                long b1 = pal[2][i] * w2;
-
-                if (!(i & 31) && progress)
-		  putchar('.');
-
-		if (!(~i & 15))
-		{
-		  if (i & 32)       // killough 10/98: display flashing disk
-		    I_EndRead();
-		  else
-		    I_BeginRead(DISK_ICON_THRESHOLD);
-		}
+          if (progress)
+            fputs("........",stdout);
 
-                for (j=0;j<256;j++,tp++)
-                  {
-                    register int color = 255;
-                    register long err;
-                    long r = pal_w1[0][j] + r1;
-                    long g = pal_w1[1][j] + g1;
-                    long b = pal_w1[2][j] + b1;
-                    long best = LONG_MAX;
-                    do
-                      if ((err = tot[color] - pal[0][color]*r
-                          - pal[1][color]*g - pal[2][color]*b) < best)
-                        best = err, *tp = color;
-                    while (--color >= 0);
-                  }
-              }
-          }
           if (cachefp)        // write out the cached translucency map
             {
               cache.pct = tran_filter_pct;
@@ -987,6 +1235,9 @@ void R_InitTranMap(int progress)
 
 void R_InitData(void)
 {
+  if (!cache_mutex)
+    cache_mutex = I_CreateMutex();
+
   R_InitTextures();
   R_InitFlats();
   R_InitSpriteLumps();
@@ -1139,6 +1390,330 @@ void R_PrecacheLevel(void)
   free(hitlist);
 }
 
+//
+// Composite cache
+//
+// With composite_cache set, the composites built at level start are
+// appended to a file in the config directory, which is keyed by a hash of
+// the texture definitions and of where their patches come from, and are
+// read back from there the next time they are needed.
+//
+
+#define COMPCACHEMAGIC "WCMP"
+#define COMPCACHEVERSION 1
+
+int composite_cache;
+
+static ULong64 R_CompositeHash(void)
+{
+  static const char *const lumps[] = {"TEXTURE1", "TEXTURE2", "PNAMES"};
+  ULong64 hash = 0xcbf29ce484222325ULL;   // FNV-1a
+  int i, j;
+
+#define HASHBYTE(x) { hash ^= (byte) (x); hash *= 0x100000001b3ULL; }
+#define HASHINT(x) { unsigned int v_ = (x); int b_; \
+    for (b_ = 0; b_ < 32; b_ += 8) HASHBYTE(v_ >> b_) }
+
+  HASHINT(COMPCACHEVERSION);
+
+  for (i = 0; i < arrlen(lumps); i++)
+  {
+    int lump = W_CheckNumForName(lumps[i]);
+
+    if (lump >= 0)
+    {
+      byte *data = W_CacheLumpNum(lump, PU_STATIC);
+
+      HASHINT(W_LumpLength(lump));
+      for (j = 0; j < W_LumpLength(lump); j++)
+        HASHBYTE(data[j]);
+      Z_ChangeTag(data, PU_CACHE);
+    }
+    else
+      HASHINT(-1);
+  }
+
+  // Patches may be replaced without touching the texture lumps.
+  for (i = 0; i < numtextures; i++)
+    for (j = 0; j < textures[i]->patchcount; j++)
+    {
+      const int lump = textures[i]->patches[j].patch;
+      const char *wad = W_WadNameForLump(lump);
+
+      HASHINT(lump);
+      HASHINT(lumpinfo[lump].size);
+      HASHINT(lumpinfo[lump].position);
+      while (*wad)
+        HASHBYTE(*wad++);
+    }
+
+#undef HASHINT
+#undef HASHBYTE
+
+  return hash;
+}
+
+static char *R_CompositeCacheName(void)
+{
+  static ULong64 hash;
+  static boolean hashed;
+  char *dir = M_StringJoin(D_DoomPrefDir(), DIR_SEPARATOR_S, "composite", NULL);
+  char name[32];
+  char *path;
+
+  if (!hashed)
+  {
+    hash = R_CompositeHash();
+    hashed = true;
+  }
+
+  M_MakeDirectory(dir);
+  M_snprintf(name, sizeof(name), "%08x%08x.cmp",
+             (unsigned int) (hash >> 32), (unsigned int) hash);
+  path = M_StringJoin(dir, DIR_SEPARATOR_S, name, NULL);
+  (free)(dir);
+  return path;
+}
+
+// Reads the composites of all textures flagged in hitlist which the cache
+// holds and clears their flags. Returns the number of composites read, or
+// -1 if the cache file is missing or invalid.
+
+static int R_LoadCompositeCache(const char *path, byte *hitlist)
+{
+  int32_t header[3], record[2];
+  int count = 0;
+  FILE *fp;
+
+  if (!(fp = fopen(path, "rb")))
+    return -1;
+
+  if (fread(header, sizeof(*header), 3, fp) != 3 ||
+      memcmp(header, COMPCACHEMAGIC, 4) ||
+      LONG(header[1]) != COMPCACHEVERSION ||
+      LONG(header[2]) != numtextures)
+  {
+    fclose(fp);
+    return -1;
+  }
+
+  while (fread(record, sizeof(*record), 2, fp) == 2)
+  {
+    const int texnum = LONG(record[0]);
+    const int size = LONG(record[1]);
+
+    if (size < 0)
+      break;
+
+    if (texnum >= 0 && texnum < numtextures && hitlist[texnum] &&
+        size == texturecompositesize[texnum] +
+                textures[texnum]->width * textures[texnum]->height)
+    {
+      const int size1 = texturecompositesize[texnum];
+      byte *block = Z_Malloc(size1, PU_STATIC,
+                             (void **) &texturecomposite[texnum]);
+      byte *block2 = Z_Malloc(size - size1, PU_STATIC,
+                              (void **) &texturecomposite2[texnum]);
+
+      if (fread(block, 1, size1, fp) != size1 ||
+          fread(block2, 1, size - size1, fp) != size - size1)
+      {
+        Z_Free(block);
+        Z_Free(block2);
+        break;
+      }
+
+      Z_ChangeTag(block, PU_LEVEL);
+      Z_ChangeTag(block2, PU_LEVEL);
+      hitlist[texnum] = 0;
+      count++;
+    }
+    else if (fseek(fp, size, SEEK_CUR))
+      break;
+  }
+
+  fclose(fp);
+  return count;
+}
+
+typedef struct
+{
+  int texnum;
+  const patch_t **patches;
+} compjob_t;
+
+static void R_SaveCompositeCache(const char *path, boolean append,
+                                 const compjob_t *jobs, int count)
+{
+  boolean ok = true;
+  FILE *fp;
+  int i;
+
+  if (!(fp = fopen(path, append ? "ab" : "wb")))
+    return;
+
+  if (!append)
+  {
+    int32_t header[3];
+
+    memcpy(header, COMPCACHEMAGIC, 4);
+    header[1] = LONG(COMPCACHEVERSION);
+    header[2] = LONG(numtextures);
+    ok = fwrite(header, sizeof(*header), 3, fp) == 3;
+  }
+
+  for (i = 0; i < count && ok; i++)
+  {
+    const int texnum = jobs[i].texnum;
+    const int size1 = texturecompositesize[texnum];
+    const int size2 = textures[texnum]->width * textures[texnum]->height;
+    int32_t record[2];
+
+    record[0] = LONG(texnum);
+    record[1] = LONG(size1 + size2);
+
+    ok = fwrite(record, sizeof(*record), 2, fp) == 2 &&
+         fwrite(texturecomposite[texnum], 1, size1, fp) == size1 &&
+         fwrite(texturecomposite2[texnum], 1, size2, fp) == size2;
+  }
+
+  fclose(fp);
+
+  if (!ok)
+    remove(path);
+}
+
+static void R_ComposeJob(void *data, int i)
+{
+  const compjob_t *job = (compjob_t *) data + i;
+  const texture_t *texture = textures[job->texnum];
+  byte *block = texturecomposite[job->texnum];
+  byte *marks = (calloc)(texture->width, texture->height);
+  int j;
+
+  if (!marks)
+    I_Error("R_ComposeJob: out of memory");
+
+  memset(block, 0, texturecompositesize[job->texnum]);
+
+  for (j = 0; j < texture->patchcount; j++)
+    R_DrawPatchInComposite(job->texnum, &texture->patches[j],
+                           job->patches[j], block, marks);
+
+  R_FinishComposite(job->texnum, block, texturecomposite2[job->texnum], marks);
+  (free)(marks);
+}
+
+//
+// R_BuildLevelComposites
+// Builds the composites of all wall textures of the level up front, on
+//  the worker pool, so that rendering does not stall on generating them
+//  when entering new areas. That includes all frames of animated wall
+//  textures and the other side of switches. They are kept until the next
+//  level starts.
+//
+
+void R_BuildLevelComposites(void)
+{
+  const uint64_t start = I_GetTimeUS();
+  byte *hitlist = (calloc)(numtextures, 1);
+  compjob_t *jobs;
+  const patch_t **patches;
+  char *path = NULL;
+  int i, j, numjobs = 0, numpatches = 0, loaded = 0, kept = 0;
+
+  if (!hitlist)
+    return;
+
+  for (i = numsides; --i >= 0;)
+    hitlist[sides[i].bottomtexture] =
+      hitlist[sides[i].toptexture] =
+      hitlist[sides[i].midtexture] = 1;
+
+  hitlist[skytexture] = 1;
+
+  // Switches first, their other side may be animated.
+  P_MarkSwitchTextures(hitlist);
+  P_MarkAnimTextures(hitlist);
+
+  hitlist[0] = 0;       // "NoTexture"
+
+  // Anything generated before, e.g. by the level preloader, stays.
+  for (i = 0; i < numtextures; i++)
+    if (hitlist[i] && texturecomposite[i] && texturecomposite2[i])
+    {
+      Z_ChangeTag(texturecomposite[i], PU_LEVEL);
+      Z_ChangeTag(texturecomposite2[i], PU_LEVEL);
+      hitlist[i] = 0;
+      kept++;
+    }
+
+  if (composite_cache)
+  {
+    path = R_CompositeCacheName();
+    loaded = R_LoadCompositeCache(path, hitlist);
+  }
+
+  for (i = 0; i < numtextures; i++)
+    if (hitlist[i])
+    {
+      numjobs++;
+      numpatches += textures[i]->patchcount;
+    }
+
+  jobs = (malloc)(numjobs * sizeof(*jobs) + 1);
+  patches = (malloc)(numpatches * sizeof(*patches) + 1);
+
+  if (!jobs || !patches)
+    I_Error("R_BuildLevelComposites: out of memory");
+
+  // The zone and the lump cache are no business of the workers.
+  for (i = j = numjobs = 0; i < numtextures; i++)
+    if (hitlist[i])
+    {
+      const texture_t *texture = textures[i];
+      int k;
+
+      Z_Malloc(texturecompositesize[i], PU_STATIC,
+               (void **) &texturecomposite[i]);
+      Z_Malloc(texture->width * texture->height, PU_STATIC,
+               (void **) &texturecomposite2[i]);
+
+      jobs[numjobs].texnum = i;
+      jobs[numjobs].patches = patches + j;
+      numjobs++;
+
+      for (k = 0; k < texture->patchcount; k++)
+        patches[j++] = W_CacheLumpNum(texture->patches[k].patch, PU_STATIC);
+    }
+
+  I_RunParallel(R_ComposeJob, jobs, numjobs);
+
+  for (i = 0; i < numjobs; i++)
+  {
+    Z_ChangeTag(texturecomposite[jobs[i].texnum], PU_LEVEL);
+    Z_ChangeTag(texturecomposite2[jobs[i].texnum], PU_LEVEL);
+  }
+  for (j = 0; j < numpatches; j++)
+    Z_ChangeTag((void *) patches[j], PU_CACHE);
+
+  if (path)
+  {
+    if (numjobs)
+      R_SaveCompositeCache(path, loaded >= 0, jobs, numjobs);
+    (free)(path);
+  }
+
+  fprintf(stderr, "R_BuildLevelComposites: %d textures composed, "
+          "%d read from cache, %d kept in %d ms\n", numjobs,
+          loaded > 0 ? loaded : 0, kept,
+          (int) ((I_GetTimeUS() - start) / 1000));
+
+  (free)(patches);
+  (free)(jobs);
+  (free)(hitlist);
+}
+
 // [FG] check if the lump can be a Doom patch
 // taken from PrBoom+ prboom2/src/r_patch.c:L350-L390
 
@@ -43,9 +43,22 @@
 byte *R_GetColumn(int tex, int col);
 byte *R_GetColumnMod(int tex, int col);
 
+// Guard zone and lump cache accesses while rendering multithreaded.
+void R_LockCache(void);
+void R_UnlockCache(void);
+
+// Off-thread texture composition for the level preloader.
+byte *R_ComposeTexture(int texnum, const patch_t *const *patches);
+void R_LinkComposite(int texnum, const byte *data);
+int R_TexturePatchCount(int texnum);
+int R_TexturePatchLump(int texnum, int i);
+
 // I/O, setting up the stuff.
 void R_InitData (void);
 void R_PrecacheLevel (void);
+void R_BuildLevelComposites (void);
+
+extern int composite_cache;   // config: keep level composites on disk
 
 // Retrieval.
 // Floor/ceiling opaque texture tiles,
@@ -64,7 +77,8 @@ void R_InitColormaps(void);   // killough 8/9/98
 
 boolean R_IsPatchLump (const int lump);
 
-extern byte *main_tranmap, *tranmap;
+extern byte *main_tranmap;
+extern THREAD_LOCAL byte *tranmap;
 
 #endif
 
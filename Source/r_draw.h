@@ -31,29 +31,32 @@
 
 #include "r_defs.h"
 
-extern lighttable_t *dc_colormap;
-extern int      dc_x;
-extern int      dc_yl;
-extern int      dc_yh;
-extern fixed_t  dc_iscale;
-extern fixed_t  dc_texturemid;
-extern int      dc_texheight;    // killough
-extern byte     dc_skycolor;
+extern THREAD_LOCAL lighttable_t *dc_colormap;
+extern THREAD_LOCAL int      dc_x;
+extern THREAD_LOCAL int      dc_yl;
+extern THREAD_LOCAL int      dc_yh;
+extern THREAD_LOCAL fixed_t  dc_iscale;
+extern THREAD_LOCAL fixed_t  dc_texturemid;
+extern THREAD_LOCAL int      dc_texheight;    // killough
+extern THREAD_LOCAL byte     dc_skycolor;
 extern int      linesize;        // killough 11/98
 
 // first pixel in a column
-extern byte     *dc_source;         
+extern THREAD_LOCAL byte     *dc_source;         
 
 // The span blitting interface.
 // Hook in assembler or system specific BLT here.
 
-void R_DrawColumn(void);
-void R_DrawTLColumn(void);      // drawing translucent textures // phares
+extern void (*R_DrawColumn)(void);
+extern void (*R_DrawTLColumn)(void);      // drawing translucent textures // phares
 extern void (*R_DrawFuzzColumn)(void);    // The Spectre/Invisibility effect.
 
 // [crispy] draw fuzz effect independent of rendering frame rate
 void R_SetFuzzPosTic(void);
 void R_SetFuzzPosDraw(void);
+int R_GetFuzzPos(void);
+void R_SetFuzzPos(int pos);
+void R_SkipFuzzColumn(void);
 
 // [FG] spectre drawing mode
 extern int fuzzcolumn_mode;
@@ -64,27 +67,33 @@ void R_DrawSkyColumn(void);
 // Draw with color translation tables, for player sprite rendering,
 //  Green/Red/Blue/Indigo shirts.
 
-void R_DrawTranslatedColumn(void);
+extern void (*R_DrawTranslatedColumn)(void);
 
 void R_VideoErase(unsigned ofs, int count);
 
-extern lighttable_t *ds_colormap;
+extern THREAD_LOCAL lighttable_t *ds_colormap;
 
-extern int     ds_y;
-extern int     ds_x1;
-extern int     ds_x2;
-extern fixed_t ds_xfrac;
-extern fixed_t ds_yfrac;
-extern fixed_t ds_xstep;
-extern fixed_t ds_ystep;
+extern THREAD_LOCAL int     ds_y;
+extern THREAD_LOCAL int     ds_x1;
+extern THREAD_LOCAL int     ds_x2;
+extern THREAD_LOCAL fixed_t ds_xfrac;
+extern THREAD_LOCAL fixed_t ds_yfrac;
+extern THREAD_LOCAL fixed_t ds_xstep;
+extern THREAD_LOCAL fixed_t ds_ystep;
 
 // start of a 64*64 tile image
-extern byte *ds_source;              
+extern THREAD_LOCAL byte *ds_source;              
 extern byte *translationtables;
-extern byte *dc_translation;
+extern THREAD_LOCAL byte *dc_translation;
 
 // Span blitting for rows, floor/ceiling. No Spectre effect needed.
-void R_DrawSpan(void);
+extern void (*R_DrawSpan)(void);
+
+// Select the fastest drawers for this CPU, returns their name.
+const char *R_InitDrawKernels(void);
+
+// Time all drawers and check them against the scalar ones (-drawbench).
+void R_DrawBenchmark(void);
 
 void R_InitBuffer(int width, int height);
 
@@ -38,6 +38,8 @@
 #include "r_sky.h"
 #include "v_video.h"
 #include "st_stuff.h"
+#include "i_thread.h"
+#include "d_bench.h"
 
 // Fineangles in the SCREENWIDTH wide window.
 #define FIELDOFVIEW 2048    
@@ -56,7 +58,7 @@ fixed_t  viewx, viewy, viewz;
 angle_t  viewangle;
 fixed_t  viewcos, viewsin;
 player_t *viewplayer;
-extern lighttable_t **walllights;
+extern THREAD_LOCAL lighttable_t **walllights;
 fixed_t  viewheightfrac; // [FG] sprite clipping optimizations
 
 //
@@ -96,7 +98,17 @@ lighttable_t **colormaps;
 
 int extralight;                           // bumped light from gun blasts
 
-void (*colfunc)(void) = R_DrawColumn;     // current column draw function
+THREAD_LOCAL void (*colfunc)(void); // current column draw function
+
+// Split-screen rendering: number of strips, and the columns this
+// thread draws. Outside of R_RenderStrips() all columns are drawn.
+
+int r_threads = 1;
+boolean r_parallel;
+THREAD_LOCAL int r_stripx1 = 0, r_stripx2 = MAX_SCREENWIDTH;
+
+// killough 3/20/98: localize scalelightfixed (readability/optimization)
+static lighttable_t *scalelightfixed[MAXLIGHTSCALE];
 
 //
 // R_PointOnSide
@@ -503,6 +515,7 @@ void R_Init (void)
   puts("R_InitSkyMap");
   R_InitTranslationTables();
   puts("R_InitTranslationsTables");
+  printf("R_InitDrawKernels: %s\n", R_InitDrawKernels());
 }
 
 //
@@ -604,6 +617,10 @@ void R_SetupFrame (player_t *player)
   viewsin = finesine[viewangle>>ANGLETOFINESHIFT];
   viewcos = finecosine[viewangle>>ANGLETOFINESHIFT];
 
+  // [AM] Interpolate sector movement. Done here for all sectors at once,
+  //      so that the render threads only ever read the sector heights.
+  R_InterpolateSectors();
+
   // killough 3/20/98, 4/4/98: select colormap based on player status
 
   if (player->mo->subsector->sector->heightsec != -1)
@@ -623,9 +640,6 @@ void R_SetupFrame (player_t *player)
 
   if (player->fixedcolormap)
     {
-      // killough 3/20/98: localize scalelightfixed (readability/optimization)
-      static lighttable_t *scalelightfixed[MAXLIGHTSCALE];
-
       fixedcolormap = fullcolormap   // killough 3/20/98: use fullcolormap
         + player->fixedcolormap*256*sizeof(lighttable_t);
         
@@ -644,7 +658,7 @@ void R_SetupFrame (player_t *player)
 // R_ShowStats
 //
 
-int rendered_visplanes, rendered_segs, rendered_vissprites;
+THREAD_LOCAL int rendered_visplanes, rendered_segs, rendered_vissprites;
 
 void R_ShowRenderingStats(void)
 {
@@ -661,6 +675,95 @@ static void R_ClearStats(void)
 
 int autodetect_hom = 0;       // killough 2/7/98: HOM autodetection flag
 
+//
+// R_RenderStrips
+//
+// Split-screen rendering. The view is cut into vertical strips which are
+// rendered in parallel. Each strip runs the complete BSP traversal, plane
+// and sprite setup, because clipping in one column depends on walls all
+// over the screen, and only skips the drawing outside its own columns.
+// The result is identical to the single-threaded renderer.
+//
+
+typedef struct {
+  int x1, x2;
+  int segs, visplanes, vissprites;
+  int fuzzpos;
+} renderstrip_t;
+
+static renderstrip_t renderstrips[MAX_THREADS];
+
+static void R_RenderStrip(void *data, int i)
+{
+  renderstrip_t *strip = (renderstrip_t *) data + i;
+
+  r_stripx1 = strip->x1;
+  r_stripx2 = strip->x2;
+
+  colfunc = R_DrawColumn;
+
+  if (fixedcolormap)
+    walllights = scalelightfixed;
+
+  R_ClearStats();
+  R_ClearClipSegs ();
+  R_ClearDrawSegs ();
+  R_ClearPlanes ();
+  R_ClearSprites ();
+
+  // Only the first strip is timed for -benchmark
+  if (!i) D_BenchStart(bench_bsp);
+  R_RenderBSPNode (numnodes-1);
+  if (!i) D_BenchStop(bench_bsp);
+
+  if (!i) D_BenchStart(bench_planes);
+  R_DrawPlanes ();
+  if (!i) D_BenchStop(bench_planes);
+
+  R_SetFuzzPosDraw();
+  if (!i) D_BenchStart(bench_masked);
+  R_DrawMasked ();
+  if (!i) D_BenchStop(bench_masked);
+
+  strip->segs = rendered_segs;
+  strip->visplanes = rendered_visplanes;
+  strip->vissprites = rendered_vissprites;
+  strip->fuzzpos = R_GetFuzzPos();
+}
+
+static void R_RenderStrips(int numstrips)
+{
+  int i;
+
+  // Strip borders are kept on even columns, because the blocky
+  // spectre drawer always writes two adjacent columns at once.
+  for (i = 0; i < numstrips; i++)
+    {
+      renderstrips[i].x1 = (viewwidth * i / numstrips) & ~1;
+      renderstrips[i].x2 = i == numstrips - 1 ? viewwidth :
+                           (viewwidth * (i + 1) / numstrips) & ~1;
+    }
+
+  // Cached lumps and composites must not be purged while other
+  // threads may still be reading them.
+  Z_SuspendPurge(true);
+  r_parallel = true;
+
+  I_RunParallel(R_RenderStrip, renderstrips, numstrips);
+
+  r_parallel = false;
+  Z_SuspendPurge(false);
+
+  r_stripx1 = 0;
+  r_stripx2 = MAX_SCREENWIDTH;
+
+  // All strips count the same, report what the first one saw
+  rendered_segs = renderstrips[0].segs;
+  rendered_visplanes = renderstrips[0].visplanes;
+  rendered_vissprites = renderstrips[0].vissprites;
+  R_SetFuzzPos(renderstrips[0].fuzzpos);
+}
+
 //
 // R_RenderView
 //
@@ -668,6 +771,8 @@ void R_RenderPlayerView (player_t* player)
 {       
   R_ClearStats();
 
+  colfunc = R_DrawColumn;
+
   R_SetupFrame (player);
 
   // Clear buffers.
@@ -750,8 +855,28 @@ void R_RenderPlayerView (player_t* player)
   // check for new console commands.
   NetUpdate ();
 
+  // Split-screen rendering, unless only the automap is drawn
+  if (r_threads != 1 && !(automapactive && !automapoverlay))
+    {
+      int numstrips = r_threads > 0 ? r_threads : I_GetNumCPUs();
+
+      if (numstrips > MAX_THREADS)
+        numstrips = MAX_THREADS;
+
+      if (numstrips > 1)
+        {
+          R_RenderStrips(numstrips);
+
+          // Check for new console commands.
+          NetUpdate ();
+          return;
+        }
+    }
+
   // The head node is the last node output.
+  D_BenchStart(bench_bsp);
   R_RenderBSPNode (numnodes-1);
+  D_BenchStop(bench_bsp);
     
   // [FG] update automap while playing
   if (automapactive && !automapoverlay)
@@ -760,14 +885,18 @@ void R_RenderPlayerView (player_t* player)
   // Check for new console commands.
   NetUpdate ();
     
+  D_BenchStart(bench_planes);
   R_DrawPlanes ();
+  D_BenchStop(bench_planes);
     
   // Check for new console commands.
   NetUpdate ();
     
   // [crispy] draw fuzz effect independent of rendering frame rate
   R_SetFuzzPosDraw();
+  D_BenchStart(bench_masked);
   R_DrawMasked ();
+  D_BenchStop(bench_masked);
 
   // Check for new console commands.
   NetUpdate ();
@@ -54,7 +54,19 @@ extern fixed_t  viewheightfrac; // [FG] sprite clipping optimizations
 // Rendering stats
 //
 
-extern int rendered_visplanes, rendered_segs, rendered_vissprites;
+extern THREAD_LOCAL int rendered_visplanes, rendered_segs, rendered_vissprites;
+
+//
+// Split-screen rendering.
+// Every render thread walks the whole BSP tree, but only draws the
+// columns [r_stripx1, r_stripx2) of its own vertical strip.
+//
+
+extern int r_threads;         // 0 = one per CPU, 1 = single-threaded
+extern boolean r_parallel;    // true while strips render concurrently
+extern THREAD_LOCAL int r_stripx1, r_stripx2;
+
+#define R_InStrip(x) ((x) >= r_stripx1 && (x) < r_stripx2)
 
 //
 // Lighting LUT.
@@ -96,7 +108,7 @@ angle_t R_InterpolateAngle(angle_t oangle, angle_t nangle, fixed_t scale);
 // Function pointer to switch refresh/drawing functions.
 //
 
-extern void (*colfunc)(void);
+extern THREAD_LOCAL void (*colfunc)(void);
 
 //
 // Utility functions.
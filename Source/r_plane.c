@@ -52,10 +52,10 @@
 
 #define MAXVISPLANES 128    /* must be a power of 2 */
 
-static visplane_t *visplanes[MAXVISPLANES];   // killough
-static visplane_t *freetail;                  // killough
-static visplane_t **freehead = &freetail;     // killough
-visplane_t *floorplane, *ceilingplane;
+static THREAD_LOCAL visplane_t *visplanes[MAXVISPLANES];   // killough
+static THREAD_LOCAL visplane_t *freetail;                  // killough
+static THREAD_LOCAL visplane_t **freehead;                 // killough
+THREAD_LOCAL visplane_t *floorplane, *ceilingplane;
 
 // killough -- hash function for visplanes
 // Empirically verified to be fairly uniform:
@@ -66,33 +66,38 @@ visplane_t *floorplane, *ceilingplane;
 // killough 8/1/98: set static number of openings to be large enough
 // (a static limit is okay in this case and avoids difficulties in r_segs.c)
 #define MAXOPENINGS (MAX_SCREENWIDTH*MAX_SCREENHEIGHT)
-int openings[MAXOPENINGS],*lastopening; // [FG] 32-bit integer math
+// Allocated once per render thread.
+static THREAD_LOCAL int *openings;
+THREAD_LOCAL int *lastopening; // [FG] 32-bit integer math
 
 // Clip values are the solid pixel bounding the range.
 //  floorclip starts out SCREENHEIGHT
 //  ceilingclip starts out -1
 
-int floorclip[MAX_SCREENWIDTH], ceilingclip[MAX_SCREENWIDTH]; // [FG] 32-bit integer math
+THREAD_LOCAL int floorclip[MAX_SCREENWIDTH], ceilingclip[MAX_SCREENWIDTH]; // [FG] 32-bit integer math
 
 // spanstart holds the start of a plane span; initialized to 0 at start
 
-static int spanstart[MAX_SCREENHEIGHT];                // killough 2/8/98
+static THREAD_LOCAL int spanstart[MAX_SCREENHEIGHT];                // killough 2/8/98
 
 //
 // texture mapping
 //
 
-static lighttable_t **planezlight;
-static fixed_t planeheight;
+static THREAD_LOCAL lighttable_t **planezlight;
+static THREAD_LOCAL fixed_t planeheight;
 
 // killough 2/8/98: make variables static
 
-static fixed_t basexscale, baseyscale;
-static fixed_t cachedheight[MAX_SCREENHEIGHT];
-static fixed_t cacheddistance[MAX_SCREENHEIGHT];
-static fixed_t cachedxstep[MAX_SCREENHEIGHT];
-static fixed_t cachedystep[MAX_SCREENHEIGHT];
-static fixed_t xoffs,yoffs;    // killough 2/28/98: flat offsets
+static THREAD_LOCAL fixed_t basexscale, baseyscale;
+static THREAD_LOCAL fixed_t cachedheight[MAX_SCREENHEIGHT];
+static THREAD_LOCAL fixed_t cacheddistance[MAX_SCREENHEIGHT];
+static THREAD_LOCAL fixed_t cachedxstep[MAX_SCREENHEIGHT];
+static THREAD_LOCAL fixed_t cachedystep[MAX_SCREENHEIGHT];
+static THREAD_LOCAL fixed_t cachedxfrac[MAX_SCREENHEIGHT];  // span start
+static THREAD_LOCAL fixed_t cachedyfrac[MAX_SCREENHEIGHT];  // at centerx
+static THREAD_LOCAL unsigned cachedlight[MAX_SCREENHEIGHT];
+static THREAD_LOCAL fixed_t xoffs,yoffs;    // killough 2/28/98: flat offsets
 
 fixed_t *yslope, yslopes[LOOKDIRS][MAX_SCREENHEIGHT], distscale[MAX_SCREENWIDTH];
 
@@ -127,8 +132,6 @@ void R_InitPlanes (void)
 
 static void R_MapPlane(int y, int x1, int x2)
 {
-  fixed_t distance;
-  unsigned index;
   int dx, dy;
 
 #ifdef RANGECHECK
@@ -136,37 +139,46 @@ static void R_MapPlane(int y, int x1, int x2)
     I_Error ("R_MapPlane: %i, %i at %i",x1,x2,y);
 #endif
 
+  // Split-screen rendering: clip the span to this thread's strip.
+  // ds_xfrac/ds_yfrac are linear in x, so the result is unchanged.
+  if (x1 < r_stripx1)
+    x1 = r_stripx1;
+  if (x2 >= r_stripx2)
+    x2 = r_stripx2 - 1;
+  if (x2 < x1)
+    return;
+
   // [FG] calculate flat coordinates relative to screen center
   if (!(dy = abs(centery - y)))
     return;
 
+  // Everything but the offsets and the light level of the plane only
+  // depends on its height, so it is worked out once per row and height.
   if (planeheight != cachedheight[y])
     {
+      fixed_t distance = FixedMul (planeheight, yslope[y]);
+      unsigned index = distance >> LIGHTZSHIFT;
+
       cachedheight[y] = planeheight;
-      distance = cacheddistance[y] = FixedMul (planeheight, yslope[y]);
-      ds_xstep = cachedxstep[y] = FixedMul (viewsin, planeheight) / dy;
-      ds_ystep = cachedystep[y] = FixedMul (viewcos, planeheight) / dy;
-    }
-  else
-    {
-      distance = cacheddistance[y];
-      ds_xstep = cachedxstep[y];
-      ds_ystep = cachedystep[y];
+      cacheddistance[y] = distance;
+      cachedxstep[y] = FixedMul (viewsin, planeheight) / dy;
+      cachedystep[y] = FixedMul (viewcos, planeheight) / dy;
+      cachedxfrac[y] =  viewx + FixedMul(viewcos, distance);
+      cachedyfrac[y] = -viewy - FixedMul(viewsin, distance);
+      cachedlight[y] = index >= MAXLIGHTZ ? MAXLIGHTZ-1 : index;
     }
 
+  ds_xstep = cachedxstep[y];
+  ds_ystep = cachedystep[y];
+
   dx = x1 - centerx;
 
   // killough 2/28/98: Add offsets
-  ds_xfrac =  viewx + FixedMul(viewcos, distance) + (dx * ds_xstep) + xoffs;
-  ds_yfrac = -viewy - FixedMul(viewsin, distance) + (dx * ds_ystep) + yoffs;
+  ds_xfrac = cachedxfrac[y] + (dx * ds_xstep) + xoffs;
+  ds_yfrac = cachedyfrac[y] + (dx * ds_ystep) + yoffs;
 
   if (!(ds_colormap = fixedcolormap))
-    {
-      index = distance >> LIGHTZSHIFT;
-      if (index >= MAXLIGHTZ )
-        index = MAXLIGHTZ-1;
-      ds_colormap = planezlight[index];
-    }
+    ds_colormap = planezlight[cachedlight[y]];
 
   ds_y = y;
   ds_x1 = x1;
@@ -189,10 +201,16 @@ void R_ClearPlanes(void)
   for (i=0 ; i<viewwidth ; i++)
     floorclip[i] = viewheight, ceilingclip[i] = -1;
 
+  if (!freehead)
+    freehead = &freetail;
+
   for (i=0;i<MAXVISPLANES;i++)    // new code -- killough
     for (*freehead = visplanes[i], visplanes[i] = NULL; *freehead; )
       freehead = &(*freehead)->next;
 
+  if (!openings && !(openings = (malloc)(MAXOPENINGS * sizeof(*openings))))
+    I_Error("R_ClearPlanes: out of memory for openings");
+
   lastopening = openings;
 
   // texture calculation
@@ -211,7 +229,10 @@ static visplane_t *new_visplane(unsigned hash)
 {
   visplane_t *check = freetail;
   if (!check)
-    check = calloc(1, sizeof *check);
+  {
+    if (!(check = (calloc)(1, sizeof *check)))  // per-thread
+      I_Error("new_visplane: out of memory");
+  }
   else
     if (!(freetail = freetail->next))
       freehead = &freetail;
@@ -341,7 +362,8 @@ static void R_MakeSpans(int x, unsigned int t1, unsigned int b1, unsigned int t2
 static void do_draw_plane(visplane_t *pl)
 {
   register int x;
-  if (pl->minx <= pl->maxx)
+  if (pl->minx <= pl->maxx &&
+      pl->maxx >= r_stripx1 && pl->minx < r_stripx2) // split-screen strip
   {
     if (pl->picnum == skyflatnum || pl->picnum & PL_SKYFLAT)  // sky flat
       {
@@ -420,12 +442,15 @@ static void do_draw_plane(visplane_t *pl)
             diff %= textureheight[texture];
             dc_texturemid = ORIGHEIGHT / 2 * FRACUNIT + diff;
           }
+          R_LockCache();
           dc_skycolor = R_GetSkyColor(texture);
+          R_UnlockCache();
           colfunc = R_DrawSkyColumn;
         }
 
 	// killough 10/98: Use sky scrolling offset, and possibly flip picture
-        for (x = pl->minx; (dc_x = x) <= pl->maxx; x++)
+        for (x = MAX(pl->minx, r_stripx1);
+             (dc_x = x) <= MIN(pl->maxx, r_stripx2 - 1); x++)
           if ((unsigned)(dc_yl = pl->top[x]) <= (dc_yh = pl->bottom[x])) // [FG] 32-bit integer math
             {
               dc_source = R_GetColumn(texture, ((an + xtoskyangle[x])^flip) >>
@@ -439,8 +464,10 @@ static void do_draw_plane(visplane_t *pl)
       {
         int stop, light;
 
+        R_LockCache();
         ds_source = W_CacheLumpNum(firstflat + flattranslation[pl->picnum],
                                    PU_STATIC);
+        R_UnlockCache();
 
         xoffs = pl->xoffs;  // killough 2/28/98: Add offsets
         yoffs = pl->yoffs;
@@ -460,7 +487,9 @@ static void do_draw_plane(visplane_t *pl)
         for (x = pl->minx ; x <= stop ; x++)
           R_MakeSpans(x,pl->top[x-1],pl->bottom[x-1],pl->top[x],pl->bottom[x]);
 
+        R_LockCache();
         Z_ChangeTag (ds_source, PU_CACHE);
+        R_UnlockCache();
       }
   }
 }
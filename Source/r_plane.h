@@ -35,15 +35,16 @@
 #define PL_SKYFLAT (0x80000000)
 
 // Visplane related.
-extern  int *lastopening; // [FG] 32-bit integer math
+extern THREAD_LOCAL int *lastopening; // [FG] 32-bit integer math
 
-extern int floorclip[], ceilingclip[]; // [FG] 32-bit integer math
+extern THREAD_LOCAL int floorclip[], ceilingclip[]; // [FG] 32-bit integer math
 extern fixed_t *yslope, yslopes[LOOKDIRS][MAX_SCREENHEIGHT], distscale[];
 
 void R_InitPlanes(void);
 void R_ClearPlanes(void);
 void R_DrawPlanes (void);
 
+
 visplane_t *R_FindPlane(
                         fixed_t height, 
                         int picnum,
@@ -44,44 +44,44 @@
 // killough 1/6/98: replaced globals with statics where appropriate
 
 // True if any of the segs textures might be visible.
-boolean  segtextured;
-boolean  markfloor;      // False if the back side is the same plane.
-boolean  markceiling;
-static boolean  maskedtexture;
-static int      toptexture;
-static int      bottomtexture;
-static int      midtexture;
+THREAD_LOCAL boolean  segtextured;
+THREAD_LOCAL boolean  markfloor;      // False if the back side is the same plane.
+THREAD_LOCAL boolean  markceiling;
+static THREAD_LOCAL boolean  maskedtexture;
+static THREAD_LOCAL int      toptexture;
+static THREAD_LOCAL int      bottomtexture;
+static THREAD_LOCAL int      midtexture;
 
-angle_t         rw_normalangle; // angle to line origin
-int             rw_angle1;
-fixed_t         rw_distance;
-lighttable_t    **walllights;
+THREAD_LOCAL angle_t         rw_normalangle; // angle to line origin
+THREAD_LOCAL int             rw_angle1;
+THREAD_LOCAL fixed_t         rw_distance;
+THREAD_LOCAL lighttable_t    **walllights;
 
 //
 // regular wall
 //
-int      rw_x;
-int      rw_stopx;
-static angle_t  rw_centerangle;
-static fixed_t  rw_offset;
-static fixed_t  rw_scale;
-static fixed_t  rw_scalestep;
-static fixed_t  rw_midtexturemid;
-static fixed_t  rw_toptexturemid;
-static fixed_t  rw_bottomtexturemid;
-static int      worldtop;
-static int      worldbottom;
-static int      worldhigh;
-static int      worldlow;
-static int64_t  pixhigh; // [FG] 64-bit integer math
-static int64_t  pixlow; // [FG] 64-bit integer math
-static fixed_t  pixhighstep;
-static fixed_t  pixlowstep;
-static int64_t  topfrac; // [FG] 64-bit integer math
-static fixed_t  topstep;
-static int64_t  bottomfrac; // [FG] 64-bit integer math
-static fixed_t  bottomstep;
-static int    *maskedtexturecol; // [FG] 32-bit integer math
+THREAD_LOCAL int      rw_x;
+THREAD_LOCAL int      rw_stopx;
+static THREAD_LOCAL angle_t  rw_centerangle;
+static THREAD_LOCAL fixed_t  rw_offset;
+static THREAD_LOCAL fixed_t  rw_scale;
+static THREAD_LOCAL fixed_t  rw_scalestep;
+static THREAD_LOCAL fixed_t  rw_midtexturemid;
+static THREAD_LOCAL fixed_t  rw_toptexturemid;
+static THREAD_LOCAL fixed_t  rw_bottomtexturemid;
+static THREAD_LOCAL int      worldtop;
+static THREAD_LOCAL int      worldbottom;
+static THREAD_LOCAL int      worldhigh;
+static THREAD_LOCAL int      worldlow;
+static THREAD_LOCAL int64_t  pixhigh; // [FG] 64-bit integer math
+static THREAD_LOCAL int64_t  pixlow; // [FG] 64-bit integer math
+static THREAD_LOCAL fixed_t  pixhighstep;
+static THREAD_LOCAL fixed_t  pixlowstep;
+static THREAD_LOCAL int64_t  topfrac; // [FG] 64-bit integer math
+static THREAD_LOCAL fixed_t  topstep;
+static THREAD_LOCAL int64_t  bottomfrac; // [FG] 64-bit integer math
+static THREAD_LOCAL fixed_t  bottomstep;
+static THREAD_LOCAL int    *maskedtexturecol; // [FG] 32-bit integer math
 
 //
 // R_RenderMaskedSegRange
@@ -94,6 +94,14 @@ void R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2)
   int      texnum;
   sector_t tempsec;      // killough 4/13/98
 
+  // Split-screen rendering: only this thread's columns
+  if (x1 < r_stripx1)
+    x1 = r_stripx1;
+  if (x2 >= r_stripx2)
+    x2 = r_stripx2 - 1;
+  if (x1 > x2)
+    return;
+
   // Calculate light table.
   // Use different light tables
   //   for horizontal / vertical / diagonal. Diagonal?
@@ -108,7 +116,11 @@ void R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2)
       colfunc = R_DrawTLColumn;
       tranmap = main_tranmap;
       if (curline->linedef->tranlump > 0)
-        tranmap = W_CacheLumpNum(curline->linedef->tranlump-1, PU_STATIC);
+        {
+          R_LockCache();
+          tranmap = W_CacheLumpNum(curline->linedef->tranlump-1, PU_STATIC);
+          R_UnlockCache();
+        }
     }
   // killough 4/11/98: end translucent 2s normal code
 
@@ -211,7 +223,11 @@ void R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2)
 
   // Except for main_tranmap, mark others purgable at this point
   if (curline->linedef->tranlump > 0 && general_translucency)
-    Z_ChangeTag(tranmap, PU_CACHE); // killough 4/11/98
+    {
+      R_LockCache();
+      Z_ChangeTag(tranmap, PU_CACHE); // killough 4/11/98
+      R_UnlockCache();
+    }
 }
 
 //
@@ -221,7 +237,7 @@ void R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2)
 // CALLED: CORE LOOPING ROUTINE.
 //
 
-static boolean didsolidcol; // True if at least one column was marked solid
+static THREAD_LOCAL boolean didsolidcol; // True if at least one column was marked solid
 
 #define HEIGHTBITS 12
 #define HEIGHTUNIT (1<<HEIGHTBITS)
@@ -240,6 +256,9 @@ static void R_RenderSegLoop (void)
       // no space above wall?
       int bottom, top = ceilingclip[rw_x]+1;
 
+      // split-screen rendering: column belongs to this thread?
+      const boolean drawcol = R_InStrip(rw_x);
+
       if (yl < top)
         yl = top;
 
@@ -299,9 +318,12 @@ static void R_RenderSegLoop (void)
           dc_yl = yl;     // single sided line
           dc_yh = yh;
           dc_texturemid = rw_midtexturemid;
-          dc_source = R_GetColumn(midtexture, texturecolumn);
-          dc_texheight = textureheight[midtexture]>>FRACBITS; // killough
-          colfunc ();
+          if (drawcol)
+            {
+              dc_source = R_GetColumn(midtexture, texturecolumn);
+              dc_texheight = textureheight[midtexture]>>FRACBITS; // killough
+              colfunc ();
+            }
           ceilingclip[rw_x] = viewheight;
           floorclip[rw_x] = -1;
         }
@@ -322,9 +344,12 @@ static void R_RenderSegLoop (void)
                   dc_yl = yl;
                   dc_yh = mid;
                   dc_texturemid = rw_toptexturemid;
-                  dc_source = R_GetColumn(toptexture,texturecolumn);
-                  dc_texheight = textureheight[toptexture]>>FRACBITS;//killough
-                  colfunc ();
+                  if (drawcol)
+                    {
+                      dc_source = R_GetColumn(toptexture,texturecolumn);
+                      dc_texheight = textureheight[toptexture]>>FRACBITS;//killough
+                      colfunc ();
+                    }
                   ceilingclip[rw_x] = mid;
                 }
               else
@@ -348,10 +373,13 @@ static void R_RenderSegLoop (void)
                   dc_yl = mid;
                   dc_yh = yh;
                   dc_texturemid = rw_bottomtexturemid;
-                  dc_source = R_GetColumn(bottomtexture,
-                                          texturecolumn);
-                  dc_texheight = textureheight[bottomtexture]>>FRACBITS; // killough
-                  colfunc ();
+                  if (drawcol)
+                    {
+                      dc_source = R_GetColumn(bottomtexture,
+                                              texturecolumn);
+                      dc_texheight = textureheight[bottomtexture]>>FRACBITS; // killough
+                      colfunc ();
+                    }
                   floorclip[rw_x] = mid;
                 }
               else
@@ -395,7 +423,10 @@ void R_StoreWallRange(const int start, const int stop)
   if (ds_p == drawsegs+maxdrawsegs)   // killough 1/98 -- fix 2s line HOM
     {
       unsigned newmax = maxdrawsegs ? maxdrawsegs*2 : 128; // killough
-      drawsegs = realloc(drawsegs,newmax*sizeof(*drawsegs));
+      // not from the zone, render threads grow their own drawsegs
+      drawsegs = (realloc)(drawsegs,newmax*sizeof(*drawsegs));
+      if (!drawsegs)
+        I_Error("R_StoreWallRange: out of memory for drawsegs");
       ds_p = drawsegs+maxdrawsegs;
       maxdrawsegs = newmax;
     }
@@ -409,7 +440,9 @@ void R_StoreWallRange(const int start, const int stop)
   linedef = curline->linedef;
 
   // mark the segment as visible for auto map
-  linedef->flags |= ML_MAPPED;
+  // (all strips see the same segs, leave it to the first one)
+  if (!r_stripx1)
+    linedef->flags |= ML_MAPPED;
 
   // [FG] update automap while playing
   if (automapactive && !automapoverlay)
@@ -525,7 +558,7 @@ void R_StoreWallRange(const int start, const int stop)
       // killough 4/7/98: make doorclosed external variable
 
       {
-        extern int doorclosed;    // killough 1/17/98, 2/8/98, 4/7/98
+        extern THREAD_LOCAL int doorclosed; // killough 1/17/98, 2/8/98, 4/7/98
         if (doorclosed || backsector->interpceilingheight<=frontsector->interpfloorheight)
           {
             ds_p->sprbottomclip = negonearray;
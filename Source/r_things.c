@@ -59,7 +59,7 @@ typedef struct {
 fixed_t pspritescale;
 fixed_t pspriteiscale;
 
-static lighttable_t **spritelights;        // killough 1/25/98 made static
+static THREAD_LOCAL lighttable_t **spritelights; // killough 1/25/98 made static
 
 // constant arrays
 //  used for psprite clipping and initializing clipping
@@ -252,8 +252,13 @@ void R_InitSpriteDefs(char **namelist)
 // GAME FUNCTIONS
 //
 
-static vissprite_t *vissprites, **vissprite_ptrs;  // killough
-static size_t num_vissprite, num_vissprite_alloc, num_vissprite_ptrs;
+static THREAD_LOCAL vissprite_t *vissprites, **vissprite_ptrs;  // killough
+static THREAD_LOCAL size_t num_vissprite, num_vissprite_alloc, num_vissprite_ptrs;
+
+// Sectors whose things have been added this frame. Kept per render
+// thread, instead of in sector_t::validcount, for split-screen rendering.
+static THREAD_LOCAL int *sectorvalid;
+static THREAD_LOCAL int num_sectorvalid;
 
 //
 // R_InitSprites
@@ -276,6 +281,16 @@ void R_InitSprites(char **namelist)
 void R_ClearSprites (void)
 {
   num_vissprite = 0;            // killough
+
+  if (num_sectorvalid < numsectors)
+    {
+      sectorvalid = (realloc)(sectorvalid, numsectors * sizeof(*sectorvalid));
+      if (!sectorvalid)
+        I_Error("R_ClearSprites: out of memory");
+      memset(sectorvalid + num_sectorvalid, 0,
+             (numsectors - num_sectorvalid) * sizeof(*sectorvalid));
+      num_sectorvalid = numsectors;
+    }
 }
 
 //
@@ -287,7 +302,10 @@ vissprite_t *R_NewVisSprite(void)
   if (num_vissprite >= num_vissprite_alloc)             // killough
     {
       num_vissprite_alloc = num_vissprite_alloc ? num_vissprite_alloc*2 : 128;
-      vissprites = realloc(vissprites,num_vissprite_alloc*sizeof(*vissprites));
+      // not from the zone, each render thread has its own vissprites
+      vissprites = (realloc)(vissprites,num_vissprite_alloc*sizeof(*vissprites));
+      if (!vissprites)
+        I_Error("R_NewVisSprite: out of memory");
     }
  return vissprites + num_vissprite++;
 }
@@ -299,10 +317,10 @@ vissprite_t *R_NewVisSprite(void)
 //  in posts/runs of opaque pixels.
 //
 
-int   *mfloorclip; // [FG] 32-bit integer math
-int   *mceilingclip; // [FG] 32-bit integer math
-fixed_t spryscale;
-int64_t sprtopscreen; // [FG] 64-bit integer math
+THREAD_LOCAL int   *mfloorclip; // [FG] 32-bit integer math
+THREAD_LOCAL int   *mceilingclip; // [FG] 32-bit integer math
+THREAD_LOCAL fixed_t spryscale;
+THREAD_LOCAL int64_t sprtopscreen; // [FG] 64-bit integer math
 
 void R_DrawMaskedColumn(column_t *column)
 {
@@ -362,7 +380,12 @@ void R_DrawVisSprite(vissprite_t *vis, int x1, int x2)
   column_t *column;
   int      texturecolumn;
   fixed_t  frac;
-  patch_t  *patch = W_CacheLumpNum (vis->patch+firstspritelump, PU_CACHE);
+  patch_t  *patch;
+  boolean  shadow;
+
+  R_LockCache();
+  patch = W_CacheLumpNum (vis->patch+firstspritelump, PU_CACHE);
+  R_UnlockCache();
 
   dc_colormap = vis->colormap;
 
@@ -396,11 +419,27 @@ void R_DrawVisSprite(vissprite_t *vis, int x1, int x2)
 
   dc_iscale = abs(vis->xiscale);
   dc_texturemid = vis->texturemid;
-  frac = vis->startfrac;
   spryscale = vis->scale;
   sprtopscreen = centeryfrac - FixedMul(dc_texturemid,spryscale);
 
-  for (dc_x=vis->x1 ; dc_x<=vis->x2 ; dc_x++, frac += vis->xiscale)
+  // Split-screen rendering: draw only this thread's columns. Shadows are
+  // walked across their full width, skipping the foreign columns, so that
+  // fuzzpos advances exactly as if the whole sprite had been drawn.
+  x1 = vis->x1;
+  x2 = vis->x2;
+  shadow = colfunc == R_DrawFuzzColumn;
+
+  if (!shadow)
+    {
+      if (x1 < r_stripx1)
+        x1 = r_stripx1;
+      if (x2 >= r_stripx2)
+        x2 = r_stripx2 - 1;
+    }
+
+  frac = vis->startfrac + vis->xiscale*(x1-vis->x1);
+
+  for (dc_x=x1 ; dc_x<=x2 ; dc_x++, frac += vis->xiscale)
     {
       texturecolumn = frac>>FRACBITS;
 
@@ -409,6 +448,9 @@ void R_DrawVisSprite(vissprite_t *vis, int x1, int x2)
         I_Error ("R_DrawSpriteRange: bad texturecolumn");
 #endif
 
+      if (shadow)
+        colfunc = R_InStrip(dc_x) ? R_DrawFuzzColumn : R_SkipFuzzColumn;
+
       column = (column_t *)((byte *) patch +
                             LONG(patch->columnofs[texturecolumn]));
       R_DrawMaskedColumn (column);
@@ -632,11 +674,11 @@ void R_AddSprites(sector_t* sec, int lightlevel)
   //  subsectors during BSP building.
   // Thus we check whether its already added.
 
-  if (sec->validcount == validcount)
+  if (sectorvalid[sec - sectors] == validcount)
     return;
 
   // Well, now it will be done.
-  sec->validcount = validcount;
+  sectorvalid[sec - sectors] = validcount;
 
   lightnum = (lightlevel >> LIGHTSEGSHIFT)+extralight;
 
@@ -849,9 +891,11 @@ void R_SortVisSprites (void)
 
       if (num_vissprite_ptrs < num_vissprite*2)
         {
-          free(vissprite_ptrs);  // better than realloc -- no preserving needed
-          vissprite_ptrs = malloc((num_vissprite_ptrs = num_vissprite_alloc*2)
-                                  * sizeof *vissprite_ptrs);
+          (free)(vissprite_ptrs);  // better than realloc -- no preserving needed
+          vissprite_ptrs = (malloc)((num_vissprite_ptrs = num_vissprite_alloc*2)
+                                    * sizeof *vissprite_ptrs);
+          if (!vissprite_ptrs)
+            I_Error("R_SortVisSprites: out of memory");
         }
 
       while (--i>=0)
@@ -880,6 +924,11 @@ void R_DrawSprite (vissprite_t* spr)
   fixed_t scale;
   fixed_t lowscale;
 
+  // Split-screen rendering: nothing to do outside of this thread's strip,
+  // except for shadows, which have to keep fuzzpos in step.
+  if (spr->colormap && (spr->x2 < r_stripx1 || spr->x1 >= r_stripx2))
+    return;
+
   for (x = spr->x1 ; x<=spr->x2 ; x++)
     clipbot[x] = cliptop[x] = -2;
 
@@ -41,10 +41,10 @@ extern int screenheightarray[MAX_SCREENWIDTH];   // change to MAX_*
 
 // Vars for R_DrawMaskedColumn
 
-extern int   *mfloorclip; // [FG] 32-bit integer math
-extern int   *mceilingclip; // [FG] 32-bit integer math
-extern fixed_t spryscale;
-extern int64_t sprtopscreen; // [FG] 64-bit integer math
+extern THREAD_LOCAL int   *mfloorclip; // [FG] 32-bit integer math
+extern THREAD_LOCAL int   *mceilingclip; // [FG] 32-bit integer math
+extern THREAD_LOCAL fixed_t spryscale;
+extern THREAD_LOCAL int64_t sprtopscreen; // [FG] 64-bit integer math
 extern fixed_t pspritescale;
 extern fixed_t pspriteiscale;
 
@@ -34,9 +34,16 @@
 #include "w_wad.h"
 #include "m_misc2.h" // [FG] M_BaseName()
 #include "d_main.h" // [FG] wadfiles
+#include "m_argv.h" // M_CheckParm()
+#include "i_thread.h"
 
 #ifdef _WIN32
 #include "../win32/win_fopen.h"
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h> // _get_osfhandle()
+#elif defined(HAVE_MMAP)
+#include <sys/mman.h>
 #endif
 
 //
@@ -48,6 +55,9 @@ lumpinfo_t *lumpinfo;
 int        numlumps;         // killough
 void       **lumpcache;      // killough
 
+// Serializes seeking and reading through the shared file handles.
+static i_mutex_t *read_mutex;
+
 static int W_FileLength(int handle)
 {
    struct stat fileinfo;
@@ -56,6 +66,91 @@ static int W_FileLength(int handle)
    return fileinfo.st_size;
 }
 
+//
+// Memory-mapped WAD files
+//
+// Lumps of mapped files are read straight from the mapping instead of
+// through lseek() and read(). W_CacheLumpNum() hands out pointers into
+// the mapping itself, so the lump data is not duplicated in the zone.
+// Files are mapped read-only: a lump which is changed in place would
+// stay changed for the rest of the session, where a zone copy would be
+// purged and read in again. Code which needs to change lump data must
+// work on a copy of its own, see W_CacheLumpNum() in w_wad.h.
+//
+
+typedef struct
+{
+  byte *base;
+  size_t size;
+} wadmap_t;
+
+static wadmap_t *wadmaps;
+static int numwadmaps;
+
+// Range spanning all mappings, so that Z_Free() and Z_ChangeTag() can
+// tell zone blocks from mapped lumps without looking through wadmaps.
+const byte *wadmaps_start = (const byte *) -1, *wadmaps_end;
+
+static byte *W_MapFile(int handle, size_t size)
+{
+  byte *base = NULL;
+
+  if (!size || M_CheckParm("-nommap"))
+    return NULL;
+
+#ifdef _WIN32
+  {
+    HANDLE file = (HANDLE) _get_osfhandle(handle);
+    HANDLE map;
+
+    if (file == INVALID_HANDLE_VALUE)
+      return NULL;
+
+    map = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (map == NULL)
+      return NULL;
+
+    base = MapViewOfFile(map, FILE_MAP_READ, 0, 0, size);
+    CloseHandle(map); // the view keeps the mapping alive
+  }
+#elif defined(HAVE_MMAP)
+  base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, handle, 0);
+  if (base == MAP_FAILED)
+    base = NULL;
+#endif
+
+  if (base)
+    {
+      wadmaps = realloc(wadmaps, (numwadmaps + 1) * sizeof(*wadmaps));
+      wadmaps[numwadmaps].base = base;
+      wadmaps[numwadmaps].size = size;
+      numwadmaps++;
+
+      if (base < wadmaps_start)
+        wadmaps_start = base;
+      if (base + size > wadmaps_end)
+        wadmaps_end = base + size;
+    }
+
+  return base;
+}
+
+// Tells whether a W_CacheLumpNum() pointer lies in a mapped file,
+// and thus must not be handed to the zone allocator. Only called for
+// pointers within wadmaps_start and wadmaps_end, see w_wad.h.
+
+boolean (W_IsMappedLump)(const void *ptr)
+{
+  int i;
+
+  for (i = 0; i < numwadmaps; i++)
+    if ((const byte *) ptr >= wadmaps[i].base &&
+        (const byte *) ptr < wadmaps[i].base + wadmaps[i].size)
+      return true;
+
+  return false;
+}
+
 void ExtractFileBase(const char *path, char *dest)
 {
   const char *src = path + strlen(path) - 1;
@@ -158,6 +253,8 @@ static void W_AddFile(const char *name) // killough 1/31/98: static, const
   filelump_t  *fileinfo, *fileinfo2free=NULL; //killough
   filelump_t  singleinfo;
   char        *filename = strcpy(malloc(strlen(name)+5), name);
+  byte        *mapped;
+  size_t      filesize;
 
   NormalizeSlashes(AddDefaultExtension(filename, ".wad"));  // killough 11/98
 
@@ -179,6 +276,9 @@ static void W_AddFile(const char *name) // killough 1/31/98: static, const
   printf(" adding %s\n",filename);   // killough 8/8/98
   startlump = numlumps;
 
+  filesize = W_FileLength(handle);
+  mapped = W_MapFile(handle, filesize);
+
   // killough:
   if (strlen(filename)<=4 || strcasecmp(filename+strlen(filename)-4, ".wad" ))
     {
@@ -226,6 +326,13 @@ static void W_AddFile(const char *name) // killough 1/31/98: static, const
         strncpy (lump_p->name, fileinfo->name, 8);
         // [FG] WAD file that contains the lump
         lump_p->wad_file = name;
+
+        // Only hand out int-aligned lumps that are entirely in the file
+        // directly, others get copied from the mapping into the zone.
+        lump_p->mapped = NULL;
+        if (mapped && lump_p->position >= 0 && lump_p->size > 0 &&
+            (size_t) lump_p->position + lump_p->size <= filesize)
+          lump_p->mapped = mapped + lump_p->position;
       }
 
     free(fileinfo2free);      // killough
@@ -454,6 +561,8 @@ void W_InitMultipleFiles(char *const *filenames)
   if (!lumpcache)
     I_Error ("Couldn't allocate lumpcache");
 
+  read_mutex = I_CreateMutex();
+
   // killough 1/31/98: initialize lump hash table
   W_InitLumpHash();
 }
@@ -469,6 +578,19 @@ int W_LumpLength (int lump)
   return lumpinfo[lump].size;
 }
 
+// Reads a lump that is neither predefined nor mapped.
+static int W_ReadFileLump(const lumpinfo_t *l, void *dest)
+{
+  int c;
+
+  I_LockMutex(read_mutex);
+  lseek(l->handle, l->position, SEEK_SET);
+  c = read(l->handle, dest, l->size);
+  I_UnlockMutex(read_mutex);
+
+  return c;
+}
+
 //
 // W_ReadLump
 // Loads the lump into the given buffer,
@@ -486,6 +608,8 @@ void W_ReadLump(int lump, void *dest)
 
   if (l->data)     // killough 1/31/98: predefined lump data
     memcpy(dest, l->data, l->size);
+  else if (l->mapped)
+    memcpy(dest, l->mapped, l->size);
   else
     {
       int c;
@@ -494,14 +618,30 @@ void W_ReadLump(int lump, void *dest)
       // killough 10/98: Add flashing disk indicator
 
       I_BeginRead(l->size);
-      lseek(l->handle, l->position, SEEK_SET);
-      c = read(l->handle, dest, l->size);
+      c = W_ReadFileLump(l, dest);
       if (c < l->size)
         I_Error("W_ReadLump: only read %i of %i on lump %i", c, l->size, lump);
       I_EndRead();
     }
 }
 
+// Like W_ReadLump(), but safe to call from any thread. Returns false
+// instead of bailing out if the lump could not be read completely.
+
+boolean W_ReadLumpSafe(int lump, void *dest)
+{
+  const lumpinfo_t *l = lumpinfo + lump;
+
+  if (l->data)
+    memcpy(dest, l->data, l->size);
+  else if (l->mapped)
+    memcpy(dest, l->mapped, l->size);
+  else
+    return W_ReadFileLump(l, dest) == l->size;
+
+  return true;
+}
+
 //
 // W_CacheLumpNum
 //
@@ -514,6 +654,10 @@ void *W_CacheLumpNum(int lump, int tag)
     I_Error ("W_CacheLumpNum: %i >= numlumps",lump);
 #endif
 
+  // mapped lumps need neither reading nor caching
+  if (lumpinfo[lump].mapped && !(lumpinfo[lump].position & (sizeof(int)-1)))
+    return (void *) lumpinfo[lump].mapped;
+
   if (!lumpcache[lump])      // read the lump in
     W_ReadLump(lump, Z_Malloc(W_LumpLength(lump), tag, &lumpcache[lump]));
   else
@@ -86,6 +86,9 @@ typedef struct
 
   // [FG] WAD file that contains the lump
   const char *wad_file;
+
+  // lump data inside a memory-mapped WAD file, or NULL
+  const byte *mapped;
 } lumpinfo_t;
 
 // killough 1/31/98: predefined lumps
@@ -106,8 +109,19 @@ int     (W_CheckNumForName)(const char* name, int);   // killough 4/17/98
 int     W_GetNumForName (const char* name);
 int     W_LumpLength (int lump);
 void    W_ReadLump (int lump, void *dest);
+boolean W_ReadLumpSafe (int lump, void *dest);
+// The returned lump may point into a WAD file mapped read-only. Never
+// write to it; W_ReadLump() into a buffer of your own instead.
 void*   W_CacheLumpNum (int lump, int tag);
 
+// Whether ptr lies in a mapped WAD file. Outside of the range spanning
+// all mappings the answer is known without a call.
+extern const byte *wadmaps_start, *wadmaps_end;
+#define W_IsMappedLump(ptr) ((const byte *) (ptr) >= wadmaps_start && \
+                             (const byte *) (ptr) < wadmaps_end && \
+                             (W_IsMappedLump)(ptr))
+boolean (W_IsMappedLump)(const void *ptr);
+
 #define W_CacheLumpName(name,tag) W_CacheLumpNum (W_GetNumForName(name),(tag))
 
 void NormalizeSlashes(char *);                    // killough 11/98
@@ -37,6 +37,7 @@
 #include "z_zone.h"
 #include "doomstat.h"
 #include "m_argv.h"
+#include "w_wad.h" // W_IsMappedLump()
 
 // Uncomment this to see real-time memory allocation
 // statistics, to and enable extra debugging features
@@ -77,6 +78,12 @@
 // Amount to subtract when retrying failed attempts to allocate initial pool
 #define RETRY_AMOUNT (256*1024)
 
+// Largest block size served from the slabs
+#define SLAB_MAX_SIZE 1024
+
+// Size of the pages which the slabs are cut from
+#define SLAB_PAGE_SIZE (64*1024)
+
 // signature for block header
 #define ZONEID  0x931d4a11
 
@@ -115,6 +122,18 @@ static memblock_t *zonebase;             // pointer to entire zone memory
 static size_t zonebase_size;             // zone memory allocated size
 static memblock_t *blockbytag[PU_MAX];
 
+// Values of memblock_t::vm
+enum {vm_zone, vm_heap, vm_slab};
+
+// While set, purgable blocks are kept alive, because other threads
+// may still be reading them (see R_RenderStrips).
+static boolean nopurge;
+
+void Z_SuspendPurge(boolean suspend)
+{
+  nopurge = suspend;
+}
+
 #ifdef INSTRUMENTED
 
 // statistics for evaluating performance
@@ -123,6 +142,9 @@ static size_t active_memory;
 static size_t purgable_memory;
 static size_t inactive_memory;
 static size_t virtual_memory;
+static size_t slab_memory;         // slab pages, in use or not
+static size_t slab_blocks;         // slab blocks in use
+static size_t slab_allocs;         // slab allocations since startup
 
 int printstats;                    // killough 8/23/98
 
@@ -132,7 +154,7 @@ void Z_PrintStats(void)            // Print allocation statistics
     {
       unsigned long total_memory = free_memory + active_memory +
 	purgable_memory + inactive_memory +
-	virtual_memory;
+	virtual_memory + slab_memory;
       double s = 100.0 / total_memory;
       
       dprintf("%-5lu\t%6.01f%%\tstatic\n"
@@ -140,6 +162,7 @@ void Z_PrintStats(void)            // Print allocation statistics
 	      "%-5lu\t%6.01f%%\tfree\n"
 	      "%-5lu\t%6.01f%%\tfragmentary\n"
 	      "%-5lu\t%6.01f%%\tvirtual\n"
+	      "%-5lu\t%6.01f%%\tslab (%lu blocks, %lu allocs)\n"
 	      "%-5lu\t\ttotal\n",
 	      active_memory,
 	      active_memory*s,
@@ -151,12 +174,78 @@ void Z_PrintStats(void)            // Print allocation statistics
 	      inactive_memory*s,
 	      virtual_memory,
 	      virtual_memory*s,
+	      (unsigned long) slab_memory,
+	      slab_memory*s,
+	      (unsigned long) slab_blocks,
+	      (unsigned long) slab_allocs,
 	      total_memory
 	      );
     }
 }
 #endif
 
+//
+// Slab allocator
+//
+// Small PU_LEVEL and PU_LEVSPEC blocks (mobjs, sector nodes, thinkers)
+// are taken from per-size-class free lists, so that their constant
+// churn neither fragments the zone nor makes Z_Malloc() walk it.
+// Slab blocks have a regular header with vm == vm_slab and, like the
+// virtual memory blocks, are kept in blockbytag[] for Z_FreeTags().
+// Freed blocks return to their free list, the pages are never released.
+//
+
+static memblock_t *slabfree[SLAB_MAX_SIZE / CHUNK_SIZE];
+
+static memblock_t *Z_SlabAlloc(size_t size)   // size is a multiple of CHUNK_SIZE
+{
+  memblock_t **freelist = &slabfree[size / CHUNK_SIZE - 1];
+  memblock_t *block = *freelist;
+
+  if (!block)      // cut a new page into blocks
+    {
+      const size_t stride = HEADER_SIZE + size;
+      char *page = (malloc)(SLAB_PAGE_SIZE), *p;
+
+      if (!page)
+        return NULL;
+
+      for (p = page; p + stride <= page + SLAB_PAGE_SIZE; p += stride)
+        {
+          block = (memblock_t *) p;
+          block->size = size;
+          block->vm = vm_slab;
+          block->next = *freelist;
+          *freelist = block;
+        }
+
+#ifdef INSTRUMENTED
+      slab_memory += SLAB_PAGE_SIZE;
+#endif
+    }
+
+  *freelist = block->next;
+
+#ifdef INSTRUMENTED
+  slab_blocks++;
+  slab_allocs++;
+#endif
+
+  return block;
+}
+
+static void Z_SlabFree(memblock_t *block)
+{
+  memblock_t **freelist = &slabfree[block->size / CHUNK_SIZE - 1];
+
+  block->next = *freelist;
+  *freelist = block;
+
+#ifdef INSTRUMENTED
+  slab_blocks--;
+#endif
+}
+
 #ifdef INSTRUMENTED
 
 // killough 4/26/98: Add history information
@@ -253,7 +342,7 @@ void Z_Init(void)
   zone->next = zone->prev = zone;          // Single node
   zone->size = size;                       // All memory in one block
   zone->tag = PU_FREE;                     // A free block
-  zone->vm  = 0;
+  zone->vm  = vm_zone;
 
 #ifdef ZONEIDCHECK
   zone->id  = 0;
@@ -295,6 +384,21 @@ void *(Z_Malloc)(size_t size, int tag, void **user, const char *file, int line)
       return user ? *user = NULL : NULL;           // malloc(0) returns NULL
    
    size = (size+CHUNK_SIZE-1) & ~(CHUNK_SIZE-1);  // round to chunk size
+
+   // Small level blocks come from the slabs
+   if(size <= SLAB_MAX_SIZE && (tag == PU_LEVEL || tag == PU_LEVSPEC) &&
+      (block = Z_SlabAlloc(size)))
+   {
+      if((block->next = blockbytag[tag]))
+         block->next->prev = (memblock_t *) &block->next;
+      blockbytag[tag] = block;
+      block->prev = (memblock_t *) &blockbytag[tag];
+
+#ifdef INSTRUMENTED
+      block->extra = size - size_orig;
+#endif
+      goto allocated;
+   }
    
    block = rover;
    
@@ -310,7 +414,7 @@ void *(Z_Malloc)(size_t size, int tag, void **user, const char *file, int line)
    do
    {
       // Free purgable blocks; replacement is roughly FIFO
-      if(block->tag >= PU_PURGELEVEL)
+      if(block->tag >= PU_PURGELEVEL && !nopurge)
       {
          start = block->prev;
          Z_Free((char *) block + HEADER_SIZE);
@@ -337,7 +441,7 @@ void *(Z_Malloc)(size_t size, int tag, void **user, const char *file, int line)
             block->size = size;
             newb->size = extra - HEADER_SIZE;
             newb->tag = PU_FREE;
-            newb->vm = 0;
+            newb->vm = vm_zone;
             
 #ifdef INSTRUMENTED
             inactive_memory += HEADER_SIZE;
@@ -389,7 +493,7 @@ allocated:
    
    while(!(block = (malloc)(size + HEADER_SIZE)))
    {
-      if(!blockbytag[PU_CACHE])
+      if(!blockbytag[PU_CACHE] || nopurge)
          I_Error("Z_Malloc: Failure trying to allocate %lu bytes"
                  "\nSource: %s:%d",(unsigned long) size, file, line);
       Z_FreeTags(PU_CACHE, PU_CACHE);
@@ -399,7 +503,7 @@ allocated:
       block->next->prev = (memblock_t *) &block->next;
    blockbytag[tag] = block;
    block->prev = (memblock_t *) &blockbytag[tag];
-   block->vm = 1;
+   block->vm = vm_heap;
    
    // haleyjd: cph's virtual memory error fix
 #ifdef INSTRUMENTED
@@ -428,7 +532,8 @@ void (Z_Free)(void *p, const char *file, int line)
    history_index[free_history] &= ZONE_HISTORY-1;
 #endif
    
-   if(p)
+   // lumps in memory-mapped WADs are not owned by the zone
+   if(p && !W_IsMappedLump(p))
    {
       memblock_t *other, *block = (memblock_t *)((char *) p - HEADER_SIZE);
       
@@ -460,10 +565,15 @@ void (Z_Free)(void *p, const char *file, int line)
          if((*(memblock_t **) block->prev = block->next))
             block->next->prev = block->prev;
 
+         if(block->vm == vm_slab)
+            Z_SlabFree(block);
+         else
+         {
 #ifdef INSTRUMENTED
-         virtual_memory -= block->size;
+            virtual_memory -= block->size;
 #endif
-         (free)(block);
+            (free)(block);
+         }
       }
       else
       {
@@ -572,14 +682,18 @@ void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line)
          block->id = 0;              // Nullify id so another free fails
 #endif
 
-#ifdef INSTRUMENTED
-         virtual_memory -= block->size;
-#endif
-
          if(block->user)            // Nullify user if one exists
             *block->user = NULL;
          
-         (free)(block);              // Free the block
+         if(block->vm == vm_slab)    // Back to its slab
+            Z_SlabFree(block);
+         else
+         {
+#ifdef INSTRUMENTED
+            virtual_memory -= block->size;
+#endif
+            (free)(block);           // Free the block
+         }
          
          block = next;               // Advance to next block
       }
@@ -590,6 +704,9 @@ void (Z_ChangeTag)(void *ptr, int tag, const char *file, int line)
 {
   memblock_t *block = (memblock_t *)((char *) ptr - HEADER_SIZE);
 
+  if (W_IsMappedLump(ptr)) // not owned by the zone, nothing to purge
+    return;
+
 #ifdef INSTRUMENTED
 #ifdef CHECKHEAP
   Z_CheckHeap();
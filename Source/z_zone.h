@@ -70,6 +70,7 @@ void *(Z_Realloc)(void *p, size_t n, int tag, void **user, const char *, int);
 char *(Z_Strdup)(const char *s, int tag, void **user, const char *, int);
 void (Z_CheckHeap)(const char *,int);   // killough 3/22/98: add file/line info
 void Z_DumpHistory(char *);
+void Z_SuspendPurge(boolean suspend);
 
 #define Z_Free(a)          (Z_Free)     (a,      __FILE__,__LINE__)
 #define Z_FreeTags(a,b)    (Z_FreeTags) (a,b,    __FILE__,__LINE__)
@@ -167,15 +167,15 @@ void OPL_SetSampleRate(unsigned int rate)
     opl_sample_rate = rate;
 }
 
-void OPL_WritePort(opl_port_t port, unsigned int value)
+void OPL_WritePort(int chip, opl_port_t port, unsigned int value)
 {
     if (driver != NULL)
     {
 #ifdef OPL_DEBUG_TRACE
-        printf("OPL_write: %i, %x\n", port, value);
+        printf("OPL_write: %i, %i, %x\n", chip, port, value);
         fflush(stdout);
 #endif
-        driver->write_port_func(port, value);
+        driver->write_port_func(chip, port, value);
     }
 }
 
@@ -219,15 +219,18 @@ unsigned int OPL_ReadStatus(void)
 
 void OPL_WriteRegister(int reg, int value)
 {
+    int chip = reg >> OPL_CHIP_SHIFT;
     int i;
 
+    reg &= (1 << OPL_CHIP_SHIFT) - 1;
+
     if (reg & 0x100)
     {
-        OPL_WritePort(OPL_REGISTER_PORT_OPL3, reg);
+        OPL_WritePort(chip, OPL_REGISTER_PORT_OPL3, reg);
     }
     else
     {
-        OPL_WritePort(OPL_REGISTER_PORT, reg);
+        OPL_WritePort(chip, OPL_REGISTER_PORT, reg);
     }
 
     // For timing, read the register port six times after writing the
@@ -249,7 +252,7 @@ void OPL_WriteRegister(int reg, int value)
         }
     }
 
-    OPL_WritePort(OPL_DATA_PORT, value);
+    OPL_WritePort(chip, OPL_DATA_PORT, value);
 
     // Read the register port 24 times after writing the value to
     // cause the appropriate delay
@@ -320,17 +323,18 @@ opl_init_result_t OPL_Detect(void)
     }
 }
 
-// Initialize registers on startup
+// Initialize registers of one chip on startup
 
-void OPL_InitRegisters(int opl3)
+static void InitChipRegisters(int opl3, int chip)
 {
+    const int base = chip << OPL_CHIP_SHIFT;
     int r;
 
     // Initialize level registers
 
     for (r=OPL_REGS_LEVEL; r <= OPL_REGS_LEVEL + OPL_NUM_OPERATORS; ++r)
     {
-        OPL_WriteRegister(r, 0x3f);
+        OPL_WriteRegister(base | r, 0x3f);
     }
 
     // Initialize other registers
@@ -340,34 +344,34 @@ void OPL_InitRegisters(int opl3)
 
     for (r=OPL_REGS_ATTACK; r <= OPL_REGS_WAVEFORM + OPL_NUM_OPERATORS; ++r)
     {
-        OPL_WriteRegister(r, 0x00);
+        OPL_WriteRegister(base | r, 0x00);
     }
 
     // More registers ...
 
     for (r=1; r < OPL_REGS_LEVEL; ++r)
     {
-        OPL_WriteRegister(r, 0x00);
+        OPL_WriteRegister(base | r, 0x00);
     }
 
     // Re-initialize the low registers:
 
     // Reset both timers and enable interrupts:
-    OPL_WriteRegister(OPL_REG_TIMER_CTRL,      0x60);
-    OPL_WriteRegister(OPL_REG_TIMER_CTRL,      0x80);
+    OPL_WriteRegister(base | OPL_REG_TIMER_CTRL,      0x60);
+    OPL_WriteRegister(base | OPL_REG_TIMER_CTRL,      0x80);
 
     // "Allow FM chips to control the waveform of each operator":
-    OPL_WriteRegister(OPL_REG_WAVEFORM_ENABLE, 0x20);
+    OPL_WriteRegister(base | OPL_REG_WAVEFORM_ENABLE, 0x20);
 
     if (opl3)
     {
-        OPL_WriteRegister(OPL_REG_NEW, 0x01);
+        OPL_WriteRegister(base | OPL_REG_NEW, 0x01);
 
         // Initialize level registers
 
         for (r=OPL_REGS_LEVEL; r <= OPL_REGS_LEVEL + OPL_NUM_OPERATORS; ++r)
         {
-            OPL_WriteRegister(r | 0x100, 0x3f);
+            OPL_WriteRegister(base | r | 0x100, 0x3f);
         }
 
         // Initialize other registers
@@ -377,23 +381,33 @@ void OPL_InitRegisters(int opl3)
 
         for (r=OPL_REGS_ATTACK; r <= OPL_REGS_WAVEFORM + OPL_NUM_OPERATORS; ++r)
         {
-            OPL_WriteRegister(r | 0x100, 0x00);
+            OPL_WriteRegister(base | r | 0x100, 0x00);
         }
 
         // More registers ...
 
         for (r=1; r < OPL_REGS_LEVEL; ++r)
         {
-            OPL_WriteRegister(r | 0x100, 0x00);
+            OPL_WriteRegister(base | r | 0x100, 0x00);
         }
     }
 
     // Keyboard split point on (?)
-    OPL_WriteRegister(OPL_REG_FM_MODE,         0x40);
+    OPL_WriteRegister(base | OPL_REG_FM_MODE,         0x40);
 
     if (opl3)
     {
-        OPL_WriteRegister(OPL_REG_NEW, 0x01);
+        OPL_WriteRegister(base | OPL_REG_NEW, 0x01);
+    }
+}
+
+void OPL_InitRegisters(int opl3, int num_chips)
+{
+    int chip;
+
+    for (chip = 0; chip < num_chips; ++chip)
+    {
+        InitChipRegisters(opl3, chip);
     }
 }
 
@@ -504,3 +518,15 @@ void OPL_AdjustCallbacks(float value)
     }
 }
 
+
+void OPL_GetUnderruns(unsigned int *count, unsigned int *frames)
+{
+    if (driver != NULL && driver->get_underruns_func != NULL)
+    {
+        driver->get_underruns_func(count, frames);
+    }
+    else
+    {
+        *count = *frames = 0;
+    }
+}
@@ -46,6 +46,12 @@ typedef enum
 #define OPL_NUM_OPERATORS   21
 #define OPL_NUM_VOICES      9
 
+// Several chips can be emulated. Bits 9 and up of a register number
+// passed to OPL_WriteRegister() select the chip.
+
+#define OPL_MAX_CHIPS       6
+#define OPL_CHIP_SHIFT      9
+
 #define OPL_REG_WAVEFORM_ENABLE   0x01
 #define OPL_REG_TIMER1            0x02
 #define OPL_REG_TIMER2            0x03
@@ -89,9 +95,9 @@ void OPL_Shutdown(void);
 
 void OPL_SetSampleRate(unsigned int rate);
 
-// Write to one of the OPL I/O ports:
+// Write to one of the OPL I/O ports of a chip:
 
-void OPL_WritePort(opl_port_t port, unsigned int value);
+void OPL_WritePort(int chip, opl_port_t port, unsigned int value);
 
 // Read from one of the OPL I/O ports:
 
@@ -114,9 +120,9 @@ void OPL_WriteRegister(int reg, int value);
 
 opl_init_result_t OPL_Detect(void);
 
-// Initialize all registers, performed on startup.
+// Initialize all registers of all chips, performed on startup.
 
-void OPL_InitRegisters(int opl3);
+void OPL_InitRegisters(int opl3, int num_chips);
 
 //
 // Timer callback functions.
@@ -153,5 +159,10 @@ void OPL_Delay(uint64_t us);
 
 void OPL_SetPaused(int paused);
 
+// Number of times, and of sample frames, that software emulation could
+// not deliver output in time.
+
+void OPL_GetUnderruns(unsigned int *count, unsigned int *frames);
+
 #endif
 
@@ -24,7 +24,8 @@
 typedef int (*opl_init_func)(unsigned int port_base);
 typedef void (*opl_shutdown_func)(void);
 typedef unsigned int (*opl_read_port_func)(opl_port_t port);
-typedef void (*opl_write_port_func)(opl_port_t port, unsigned int value);
+typedef void (*opl_write_port_func)(int chip, opl_port_t port,
+                                    unsigned int value);
 typedef void (*opl_set_callback_func)(uint64_t us,
                                       opl_callback_t callback,
                                       void *data);
@@ -33,6 +34,8 @@ typedef void (*opl_lock_func)(void);
 typedef void (*opl_unlock_func)(void);
 typedef void (*opl_set_paused_func)(int paused);
 typedef void (*opl_adjust_callbacks_func)(float value);
+typedef void (*opl_get_underruns_func)(unsigned int *count,
+                                       unsigned int *frames);
 
 typedef struct
 {
@@ -48,6 +51,7 @@ typedef struct
     opl_unlock_func unlock_func;
     opl_set_paused_func set_paused_func;
     opl_adjust_callbacks_func adjust_callbacks_func;
+    opl_get_underruns_func get_underruns_func;
 } opl_driver_t;
 
 // Sample rate to use when doing software emulation.
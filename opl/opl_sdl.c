@@ -69,14 +69,41 @@ static int opl_sdl_paused;
 
 static uint64_t pause_offset;
 
-// OPL software emulator structure.
+// OPL software emulator structures. Chips are only emulated once
+// they have been written to.
 
-static opl3_chip opl_chip;
+static opl3_chip opl_chips[OPL_MAX_CHIPS];
+static int num_opl_chips;
 static int opl_opl3mode;
 
-// Temporary mixing buffer used by the mixing callback.
+// Output is generated in blocks by a worker thread, into a ring buffer
+// which is consumed by the mixing callback. The read and write positions
+// are free-running frame counters, each only advanced by one side.
 
-static uint8_t *mix_buffer = NULL;
+#define OPL_BLOCK_FRAMES 512
+#define OPL_RING_FRAMES  8192     // power of two
+
+static int16_t *ring_buffer;
+static SDL_atomic_t ring_read, ring_write;
+
+// Frames the worker tries to keep ahead of the mixer, twice the size of
+// the last mixer request.
+
+static SDL_atomic_t ring_target;
+
+static SDL_Thread *opl_thread;
+static SDL_sem *opl_wake;
+static SDL_atomic_t opl_thread_quit;
+
+// Mixer requests which could not be filled completely, and the number of
+// frames which were missing.
+
+static SDL_atomic_t underruns, underrun_frames;
+
+// Temporary buffers used by the worker thread.
+
+static int16_t *mix_buffer = NULL;
+static int16_t *chip_buffer = NULL;
 
 // Register number that was written.
 
@@ -156,31 +183,50 @@ static void AdvanceTime(unsigned int nsamples)
 
 // Call the OPL emulator code to fill the specified buffer.
 
-static void FillBuffer(uint8_t *buffer, unsigned int nsamples)
+static void FillBuffer(int16_t *buffer, unsigned int nsamples)
 {
-    // This seems like a reasonable assumption.  mix_buffer is
-    // 1 second long, which should always be much longer than the
-    // SDL mix buffer.
-    assert(nsamples < mixing_freq);
-
-    // OPL output is generated into temporary buffer and then mixed
-    // (to avoid overflows etc.)
-    OPL3_GenerateStream(&opl_chip, (Bit16s *) mix_buffer, nsamples);
-    SDL_MixAudioFormat(buffer, mix_buffer, AUDIO_S16SYS, nsamples * 4,
-                       SDL_MIX_MAXVOLUME);
+    unsigned int i;
+    int chip;
+
+    // Output of all chips is summed up with saturation. Register writes
+    // done under OPL_Lock() must not happen in between.
+
+    SDL_LockMutex(callback_mutex);
+
+    OPL3_GenerateStream(&opl_chips[0], (Bit16s *) buffer, nsamples);
+
+    for (chip = 1; chip < num_opl_chips; ++chip)
+    {
+        OPL3_GenerateStream(&opl_chips[chip], (Bit16s *) chip_buffer, nsamples);
+
+        for (i = 0; i < nsamples * 2; ++i)
+        {
+            int sample = buffer[i] + chip_buffer[i];
+
+            if (sample > 32767)
+            {
+                sample = 32767;
+            }
+            else if (sample < -32768)
+            {
+                sample = -32768;
+            }
+
+            buffer[i] = sample;
+        }
+    }
+
+    SDL_UnlockMutex(callback_mutex);
 }
 
-// Callback function to fill a new sound buffer:
+// Generate a block of output, invoking callbacks at the right points.
 
-static void OPL_Mix_Callback(int chan, void *stream, int len, void *udata)
+static void GenerateBlock(int16_t *buffer, unsigned int buffer_samples)
 {
-    unsigned int filled, buffer_samples;
-    Uint8 *buffer = (Uint8*)stream;
+    unsigned int filled = 0;
 
     // Repeatedly call the OPL emulator update function until the buffer is
     // full.
-    filled = 0;
-    buffer_samples = len / 4;
 
     while (filled < buffer_samples)
     {
@@ -214,7 +260,7 @@ static void OPL_Mix_Callback(int chan, void *stream, int len, void *udata)
 
         // Add emulator output to buffer.
 
-        FillBuffer(buffer + filled * 4, nsamples);
+        FillBuffer(buffer + filled * 2, nsamples);
         filled += nsamples;
 
         // Invoke callbacks for this point in time.
@@ -223,19 +269,131 @@ static void OPL_Mix_Callback(int chan, void *stream, int len, void *udata)
     }
 }
 
+static int OPL_SDL_Thread(void *unused)
+{
+    while (!SDL_AtomicGet(&opl_thread_quit))
+    {
+        unsigned int read = SDL_AtomicGet(&ring_read);
+        unsigned int write = SDL_AtomicGet(&ring_write);
+        unsigned int start, first;
+
+        if (write - read + OPL_BLOCK_FRAMES > (unsigned int) SDL_AtomicGet(&ring_target))
+        {
+            // Far enough ahead, wait for the mixer to consume some.
+            SDL_SemWaitTimeout(opl_wake, 10);
+            continue;
+        }
+
+        GenerateBlock(mix_buffer, OPL_BLOCK_FRAMES);
+
+        // Copy into the ring, which may wrap around.
+
+        start = write & (OPL_RING_FRAMES - 1);
+        first = OPL_RING_FRAMES - start;
+        if (first > OPL_BLOCK_FRAMES)
+        {
+            first = OPL_BLOCK_FRAMES;
+        }
+
+        memcpy(ring_buffer + start * 2, mix_buffer, first * 4);
+        memcpy(ring_buffer, mix_buffer + first * 2,
+               (OPL_BLOCK_FRAMES - first) * 4);
+
+        SDL_AtomicSet(&ring_write, write + OPL_BLOCK_FRAMES);
+    }
+
+    return 0;
+}
+
+// Callback function to fill a new sound buffer:
+
+static void OPL_Mix_Callback(int chan, void *stream, int len, void *udata)
+{
+    Uint8 *buffer = (Uint8*)stream;
+    unsigned int buffer_samples = len / 4;
+    unsigned int read = SDL_AtomicGet(&ring_read);
+    unsigned int write = SDL_AtomicGet(&ring_write);
+    unsigned int avail = write - read;
+    unsigned int nsamples, start, first;
+    unsigned int target;
+
+    nsamples = avail < buffer_samples ? avail : buffer_samples;
+
+    start = read & (OPL_RING_FRAMES - 1);
+    first = OPL_RING_FRAMES - start;
+    if (first > nsamples)
+    {
+        first = nsamples;
+    }
+
+    // OPL output is mixed in (to avoid overflows etc.)
+    SDL_MixAudioFormat(buffer, (Uint8 *) (ring_buffer + start * 2),
+                       AUDIO_S16SYS, first * 4, SDL_MIX_MAXVOLUME);
+    SDL_MixAudioFormat(buffer + first * 4, (Uint8 *) ring_buffer,
+                       AUDIO_S16SYS, (nsamples - first) * 4,
+                       SDL_MIX_MAXVOLUME);
+
+    SDL_AtomicSet(&ring_read, read + nsamples);
+
+    if (nsamples < buffer_samples)
+    {
+        SDL_AtomicAdd(&underruns, 1);
+        SDL_AtomicAdd(&underrun_frames, buffer_samples - nsamples);
+    }
+
+    // Keep twice the request ahead.
+
+    target = buffer_samples * 2;
+    if (target < OPL_BLOCK_FRAMES * 2)
+    {
+        target = OPL_BLOCK_FRAMES * 2;
+    }
+    else if (target > OPL_RING_FRAMES)
+    {
+        target = OPL_RING_FRAMES;
+    }
+    SDL_AtomicSet(&ring_target, target);
+
+    SDL_SemPost(opl_wake);
+}
+
 static void OPL_SDL_Shutdown(void)
 {
     Mix_HookMusic(NULL, NULL);
+    Mix_UnregisterEffect(MIX_CHANNEL_POST, OPL_Mix_Callback);
+
+    if (opl_thread != NULL)
+    {
+        SDL_AtomicSet(&opl_thread_quit, 1);
+        SDL_SemPost(opl_wake);
+        SDL_WaitThread(opl_thread, NULL);
+        opl_thread = NULL;
+    }
+
+    if (opl_wake != NULL)
+    {
+        SDL_DestroySemaphore(opl_wake);
+        opl_wake = NULL;
+    }
 
     if (sdl_was_initialized)
     {
         Mix_CloseAudio();
         SDL_QuitSubSystem(SDL_INIT_AUDIO);
-        OPL_Queue_Destroy(callback_queue);
-        free(mix_buffer);
         sdl_was_initialized = 0;
     }
 
+    if (callback_queue != NULL)
+    {
+        OPL_Queue_Destroy(callback_queue);
+        callback_queue = NULL;
+    }
+
+    free(mix_buffer);
+    free(chip_buffer);
+    free(ring_buffer);
+    mix_buffer = chip_buffer = ring_buffer = NULL;
+
 /*
     if (opl_chip != NULL)
     {
@@ -283,6 +441,8 @@ static unsigned int GetSliceSize(void)
 
 static int OPL_SDL_Init(unsigned int port_base)
 {
+    int i;
+
     // Check if SDL_mixer has been opened already
     // If not, we must initialize it now
 
@@ -338,17 +498,43 @@ static int OPL_SDL_Init(unsigned int port_base)
         return 0;
     }
 
-    // Mix buffer: four bytes per sample (16 bits * 2 channels):
-    mix_buffer = malloc(mixing_freq * 4);
+    // Buffers: four bytes per sample (16 bits * 2 channels):
+    mix_buffer = malloc(OPL_BLOCK_FRAMES * 4);
+    chip_buffer = malloc(OPL_BLOCK_FRAMES * 4);
+    ring_buffer = malloc(OPL_RING_FRAMES * 4);
 
-    // Create the emulator structure:
+    // Create the emulator structures:
 
-    OPL3_Reset(&opl_chip, mixing_freq);
+    for (i = 0; i < OPL_MAX_CHIPS; ++i)
+    {
+        OPL3_Reset(&opl_chips[i], mixing_freq);
+    }
+    num_opl_chips = 1;
     opl_opl3mode = 0;
 
     callback_mutex = SDL_CreateMutex();
     callback_queue_mutex = SDL_CreateMutex();
 
+    // Start the worker thread which generates the output.
+
+    SDL_AtomicSet(&ring_read, 0);
+    SDL_AtomicSet(&ring_write, 0);
+    SDL_AtomicSet(&ring_target, OPL_BLOCK_FRAMES * 2);
+    SDL_AtomicSet(&underruns, 0);
+    SDL_AtomicSet(&underrun_frames, 0);
+    SDL_AtomicSet(&opl_thread_quit, 0);
+
+    opl_wake = SDL_CreateSemaphore(0);
+    opl_thread = SDL_CreateThread(OPL_SDL_Thread, "opl", NULL);
+
+    if (opl_thread == NULL)
+    {
+        fprintf(stderr, "Error creating OPL thread: %s\n", SDL_GetError());
+
+        OPL_SDL_Shutdown();
+        return 0;
+    }
+
     // Set postmix that adds the OPL music. This is deliberately done
     // as a postmix and not using Mix_HookMusic() as the latter disables
     // normal SDL_mixer music mixing.
@@ -396,8 +582,21 @@ static void OPLTimer_CalculateEndTime(opl_timer_t *timer)
     }
 }
 
-static void WriteRegister(unsigned int reg_num, unsigned int value)
+static void WriteRegister(int chip, unsigned int reg_num, unsigned int value)
 {
+    // Timers are only emulated for the first chip.
+
+    if (chip > 0)
+    {
+        if (chip >= num_opl_chips)
+        {
+            num_opl_chips = chip + 1;
+        }
+
+        OPL3_WriteRegBuffered(&opl_chips[chip], reg_num, value);
+        return;
+    }
+
     switch (reg_num)
     {
         case OPL_REG_TIMER1:
@@ -437,12 +636,12 @@ static void WriteRegister(unsigned int reg_num, unsigned int value)
             opl_opl3mode = value & 0x01;
 
         default:
-            OPL3_WriteRegBuffered(&opl_chip, reg_num, value);
+            OPL3_WriteRegBuffered(&opl_chips[0], reg_num, value);
             break;
     }
 }
 
-static void OPL_SDL_PortWrite(opl_port_t port, unsigned int value)
+static void OPL_SDL_PortWrite(int chip, opl_port_t port, unsigned int value)
 {
     if (port == OPL_REGISTER_PORT)
     {
@@ -454,7 +653,7 @@ static void OPL_SDL_PortWrite(opl_port_t port, unsigned int value)
     }
     else if (port == OPL_DATA_PORT)
     {
-        WriteRegister(register_num, value);
+        WriteRegister(chip, register_num, value);
     }
 }
 
@@ -496,6 +695,12 @@ static void OPL_SDL_AdjustCallbacks(float factor)
     SDL_UnlockMutex(callback_queue_mutex);
 }
 
+static void OPL_SDL_GetUnderruns(unsigned int *count, unsigned int *frames)
+{
+    *count = SDL_AtomicGet(&underruns);
+    *frames = SDL_AtomicGet(&underrun_frames);
+}
+
 opl_driver_t opl_sdl_driver =
 {
     "SDL",
@@ -509,5 +714,6 @@ opl_driver_t opl_sdl_driver =
     OPL_SDL_Unlock,
     OPL_SDL_SetPaused,
     OPL_SDL_AdjustCallbacks,
+    OPL_SDL_GetUnderruns,
 };
 